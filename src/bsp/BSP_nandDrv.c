@@ -55,6 +55,7 @@
 // Private member declarations.
 //*****************************************************************************
 static bool bInit = false;
+static BSP_NAND_STATS_T xNandStats;
 
 //AT_NONCACHEABLE_SECTION_INIT(uint8_t nand_readBuf[NAND_PAGE_SIZE_PHYSICAL]) = {0U};
 //AT_NONCACHEABLE_SECTION_INIT(uint8_t nand_writeBuf[NAND_PAGE_SIZE_PHYSICAL]) = {0U};
@@ -68,6 +69,7 @@ static bool bInit = false;
 //*****************************************************************************
 static void _NAND_InitPins(void);
 static status_t _NAND_InitSEMC(void);
+static status_t _NAND_LoadPage(uint32_t pageAddress);
 
 //*****************************************************************************
 // Public function implementations
@@ -488,7 +490,7 @@ void BSP_NAND_ReadID(uint8_t *buf)
 }
 
 
-void BSP_NAND_ReadPageDataOOB(uint32_t pageAddress, uint8_t *buf)
+static status_t _NAND_LoadPage(uint32_t pageAddress)
 {
     uint32_t slaveAddress;
     uint32_t dummyData = 0;
@@ -506,8 +508,8 @@ void BSP_NAND_ReadPageDataOOB(uint32_t pageAddress, uint8_t *buf)
     slaveAddress = CONFIG_SYS_NAND_BASE + (pageAddress * CONFIG_SYS_NAND_PAGE_SIZE);
     status = SEMC_SendIPCommand(NAND_SEMC, kSEMC_MemType_NAND, slaveAddress, commandCode, 0, &dummyData);
     if(status != kStatus_Success) {
-        debug("fsl_nand, NAND_ReadPageDataOOB, SEMC_SendIPCommand Failed!\n");
-        return;
+        debug("fsl_nand, NAND_LoadPage, SEMC_SendIPCommand Failed!\n");
+        return status;
     }
     commandCode = SEMC_BuildNandIPCommand(
                     0x30U,
@@ -515,16 +517,84 @@ void BSP_NAND_ReadPageDataOOB(uint32_t pageAddress, uint8_t *buf)
                     kSEMC_NANDCM_CommandHold);
     status = SEMC_SendIPCommand(NAND_SEMC, kSEMC_MemType_NAND, slaveAddress, commandCode, 0, &dummyData);
     if(status != kStatus_Success) {
-        debug("fsl_nand, NAND_ReadPageDataOOB, SEMC_SendIPCommand Failed!\n");
-        return;
+        debug("fsl_nand, NAND_LoadPage, SEMC_SendIPCommand Failed!\n");
+        return status;
     }
+    xNandStats.pageLoads++;
 
     while(BSP_NAND_Ready() != true);
+    return status;
+}
+
+
+void BSP_NAND_ReadPageDataOOB(uint32_t pageAddress, uint8_t *buf)
+{
+    uint32_t slaveAddress;
+    status_t status = kStatus_Success;
+
+    if(_NAND_LoadPage(pageAddress) != kStatus_Success) {
+        return;
+    }
+
+    slaveAddress = CONFIG_SYS_NAND_BASE + (pageAddress * CONFIG_SYS_NAND_PAGE_SIZE);
     status = SEMC_IPCommandNandRead(NAND_SEMC, slaveAddress, buf, CONFIG_SYS_NAND_PAGE_SIZE + CONFIG_SYS_NAND_OOBSIZE);
     if(status != kStatus_Success) {
         debug("fsl_nand, NAND_ReadPageDataOOB, SEMC_SendIPCommand Failed!\n");
         return;
     }
+    xNandStats.readXfers++;
+    xNandStats.readBytes += CONFIG_SYS_NAND_PAGE_SIZE + CONFIG_SYS_NAND_OOBSIZE;
+}
+
+
+void BSP_NAND_LoadPage(uint32_t pageAddress)
+{
+    (void)_NAND_LoadPage(pageAddress);
+}
+
+
+void BSP_NAND_ReadPageColumn(uint32_t pageAddress, uint32_t column, uint8_t *buf, uint32_t len)
+{
+    uint32_t slaveAddress;
+    uint32_t dummyData = 0;
+    uint16_t commandCode;
+    status_t status = kStatus_Success;
+
+    if((column >= CONFIG_SYS_NAND_PAGE_SIZE) ||
+       ((column + len) > (CONFIG_SYS_NAND_PAGE_SIZE + CONFIG_SYS_NAND_OOBSIZE)) ||
+       (buf == (uint8_t *)0)) {
+        debug("fsl_nand, NAND_ReadPageColumn, invalid argument col:%d, len:%d, buf:%X\n", column, len, buf);
+        return;
+    }
+
+    /* Move the data output to column (RANDOM DATA OUTPUT) */
+    commandCode = SEMC_BuildNandIPCommand(
+                    0x05U,
+                    kSEMC_NANDAM_ColumnCA0CA1,
+                    kSEMC_NANDCM_CommandAddressHold);
+    slaveAddress = CONFIG_SYS_NAND_BASE + (pageAddress * CONFIG_SYS_NAND_PAGE_SIZE) + column;
+    status = SEMC_SendIPCommand(NAND_SEMC, kSEMC_MemType_NAND, slaveAddress, commandCode, 0, &dummyData);
+    if(status != kStatus_Success) {
+        debug("fsl_nand, NAND_ReadPageColumn, SEMC_SendIPCommand Failed!\n");
+        return;
+    }
+    commandCode = SEMC_BuildNandIPCommand(
+                    0xE0U,
+                    kSEMC_NANDAM_ColumnRow,
+                    kSEMC_NANDCM_CommandHold);
+    status = SEMC_SendIPCommand(NAND_SEMC, kSEMC_MemType_NAND, slaveAddress, commandCode, 0, &dummyData);
+    if(status != kStatus_Success) {
+        debug("fsl_nand, NAND_ReadPageColumn, SEMC_SendIPCommand Failed!\n");
+        return;
+    }
+
+    status = SEMC_IPCommandNandRead(NAND_SEMC, slaveAddress, buf, len);
+    if(status != kStatus_Success) {
+        debug("fsl_nand, NAND_ReadPageColumn, SEMC_SendIPCommand Failed!\n");
+        return;
+    }
+    xNandStats.readXfers++;
+    xNandStats.readBytes += len;
 }
 
 
@@ -557,6 +627,9 @@ void BSP_NAND_Erase(uint8_t command, int32_t page_addr)
         debug("fsl_nand, NAND_Erase, SEMC_SendIPCommand Failed! (commandCode:%04X)\n", commandCode);
         return;
     }
+    if(command == NAND_CMD_ERASE_2ND) {
+        xNandStats.erases++;
+    }
     while(BSP_NAND_Ready() != true);
 }
 
@@ -587,6 +660,7 @@ void BSP_NAND_ProgramPage(int32_t page_addr, int32_t column, uint32_t len, uint8
     }
 
     SEMC_IPCommandNandWrite(NAND_SEMC, slaveAddress, buf, len);
+    xNandStats.progBytes += len;
 
     commandCode = SEMC_BuildNandIPCommand(
                         0x10,
@@ -603,4 +677,21 @@ void BSP_NAND_ProgramPage(int32_t page_addr, int32_t column, uint32_t len, uint8
 }
 
 
+void BSP_NAND_GetStats(BSP_NAND_STATS_T *stats)
+{
+    if(stats == (BSP_NAND_STATS_T *)0) {
+        return;
+    }
+    taskENTER_CRITICAL();
+    *stats = xNandStats;
+    taskEXIT_CRITICAL();
+}
+
+
+void BSP_NAND_ResetStats(void)
+{
+    taskENTER_CRITICAL();
+    memset(&xNandStats, 0, sizeof(xNandStats));
+    taskEXIT_CRITICAL();
+}
 
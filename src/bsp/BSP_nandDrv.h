@@ -43,6 +43,15 @@ typedef enum {
     N_BSP_NAND_DRV_RET
 } BSP_NAND_RET_T;
 
+//! \struct BSP_NAND_STATS_T
+typedef struct {
+    uint32_t pageLoads;     //!< READ PAGE (00h-30h) operations
+    uint32_t readXfers;     //!< Data transfers out of the page register
+    uint32_t readBytes;     //!< Bytes transferred out of the page register
+    uint32_t progBytes;     //!< Bytes transferred into the page register
+    uint32_t erases;        //!< BLOCK ERASE operations
+} BSP_NAND_STATS_T;
+
 //*****************************************************************************
 // Public function prototypes.
 //*****************************************************************************
@@ -121,6 +130,37 @@ extern void BSP_NAND_ReadID(uint8_t *buf);
 //*****************************************************************************
 extern void BSP_NAND_ReadPageDataOOB(uint32_t pageAddress, uint8_t *buf);
 
+//*****************************************************************************
+//!
+//! \brief Load a page into the page register without transferring it
+//!
+//! Parts of the page are then transferred with BSP_NAND_ReadPageColumn().
+//!
+//! \param  pageAddress     Page address
+//!
+//! \return \c void
+//!
+//*****************************************************************************
+extern void BSP_NAND_LoadPage(uint32_t pageAddress);
+
+//*****************************************************************************
+//!
+//! \brief Transfer part of the page loaded by BSP_NAND_LoadPage()
+//!
+//! Issues a RANDOM DATA OUTPUT (05h-E0h) at column and reads len bytes. The
+//! SEMC column address is 11 bits wide, so column must lie in the main area;
+//! a transfer running past its end continues into the OOB.
+//!
+//! \param  pageAddress     Page address, as passed to BSP_NAND_LoadPage()
+//! \param  column          Column address, below CONFIG_SYS_NAND_PAGE_SIZE
+//! \param  buf             Read buffer, 4-byte aligned
+//! \param  len             Number of bytes to read
+//!
+//! \return \c void
+//!
+//*****************************************************************************
+extern void BSP_NAND_ReadPageColumn(uint32_t pageAddress, uint32_t column, uint8_t *buf, uint32_t len);
+
 
 //*****************************************************************************
 //!
@@ -148,6 +188,28 @@ extern void BSP_NAND_Erase(uint8_t command, int32_t page_addr);
 //*****************************************************************************
 extern void BSP_NAND_ProgramPage(int32_t page_addr, int32_t column, uint32_t len, uint8_t *buf);
 
+//*****************************************************************************
+//!
+//! \brief Get the SEMC transfer counters
+//!
+//! \param  stats           Filled in with a copy of the counters
+//!
+//! \return \c void
+//!
+//*****************************************************************************
+extern void BSP_NAND_GetStats(BSP_NAND_STATS_T *stats);
+
+//*****************************************************************************
+//!
+//! \brief Clear the SEMC transfer counters
+//!
+//! \param  None
+//!
+//! \return \c void
+//!
+//*****************************************************************************
+extern void BSP_NAND_ResetStats(void);
+
 #if defined(__cplusplus)
 }
 #endif /* __cplusplus*/
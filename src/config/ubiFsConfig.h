@@ -44,20 +44,101 @@
 #define CONFIG_SYS_NAND_PLANE_COUNT                 (1)
 #define CONFIG_SYS_NAND_SIZE                        (CONFIG_SYS_NAND_BLOCK_SIZE * CONFIG_SYS_NAND_BLOCK_COUNT * CONFIG_SYS_NAND_PLANE_COUNT)
 #define CONFIG_SYS_NAND_SIZE_KB                     (CONFIG_SYS_NAND_SIZE >> 10)
+/* transfer only the ECC steps of a page that are read, plus its OOB (remove to disable) */
+#define CONFIG_MXRT105X_NAND_PARTIAL_READ
+/* keep the bad block table in the last blocks instead of scanning every block's OOB at boot */
+#define CONFIG_SYS_NAND_USE_FLASH_BBT
 
 #define CONFIG_MTD_PARTITIONS
 #define CONFIG_MTD_DEVICE
 #define MTDIDS_DEFAULT                              "nand0=gpmi-nand"
+/* bbt: last NAND_BBT_SCAN_MAXBLOCKS (4) blocks, flash BBT and mirror (older boards: see subsect_ubi_zpl_bbt) */
 #define MTDPARTS_DEFAULT                            "mtdparts=gpmi-nand:" \
                                                     "512k(bcb),"          \
                                                     "2m(u-boot1)ro,"      \
                                                     "2m(u-boot2)ro,"      \
-                                                    "-(rootfs)"
+                                                    "123m(rootfs),"       \
+                                                    "-(bbt)ro"
 #define PARTITION_DEFAULT                           "nand0,3"
 #define PARTITION_NAME_DEFAULT                      "rootfs"
 #define VOLUME_NAME_DEFAULT                         "ubi0:fs"
 
 #define CONFIG_MTD_UBI_WL_THRESHOLD                 (256)
+/* attach from the on-flash fastmap instead of scanning every PEB (remove to disable) */
+#define CONFIG_MTD_UBI_FASTMAP
+/* 1: write a fastmap on images that were attached by scanning */
+#define CONFIG_MTD_UBI_FASTMAP_AUTOCONVERT          (1)
+/* erase freed PEBs in gatekeeper idle time, keeping at least this many erased (remove for inline erasure) */
+#define CONFIG_MTD_UBI_ERASED_RESERVE               (8)
+/* scrub a used PEB once a background read corrects this many bitflips in it (remove to disable) */
+#define CONFIG_MTD_UBI_SCRUB_BITFLIPS               (1)
+
+/* read consecutive data nodes of a file with one LEB read (needs one LEB of heap) */
+#define CONFIG_UBIFS_BULK_READ
+
+/* UBIFS page cache of decompressed 4 KiB data blocks (0 disables it) */
+#define CONFIG_UBIFS_PCACHE_PAGES                   (32)
+/* 1: hold writes in the cache until sync/eviction/age, 0: write-through */
+#define CONFIG_UBIFS_PCACHE_WRITEBACK               (0)
+/* max. time written data may stay in the cache only */
+#define CONFIG_UBIFS_PCACHE_DIRTY_AGE_MS            (5000)
+/* locations of recently read data nodes kept to skip TNC lookups (remove to disable) */
+#define CONFIG_UBIFS_XCACHE_ENTRIES                 (256)
+/* garbage collect dirty LEBs in gatekeeper idle time until this many are empty (remove to disable) */
+#define CONFIG_UBIFS_BG_GC_LEBS                     (16)
+/* pick GC victims by cost-benefit, (1 - u) * age / (1 + u), instead of by dirty space (define to enable) */
+/* #define CONFIG_UBIFS_GC_COST_BENEFIT */
+/* write data of inodes marked hot to a journal head of its own, added to the superblock on first use (define to enable) */
+/* #define CONFIG_UBIFS_HOT_JHEAD */
+
+/* kmalloc() classes served from fixed pools, {object size, count}, ascending (remove to disable) */
+/* 320: znodes of fanout 8, 4160: data node reads, 8256: journal data node writes */
+#define CONFIG_KMALLOC_POOLS                        { {64, 64}, {128, 64}, {320, 256}, \
+                                                      {512, 32}, {4160, 4}, {8256, 2} }
+/* objects per slab of the kmem_cache_create() caches */
+#define CONFIG_KMEM_CACHE_SLAB_OBJS                 (32)
+/* charge every kmalloc() to its subsystem, costs 8 bytes per block (remove to disable) */
+#define CONFIG_KMEM_ACCOUNTING
+/* report subsystems holding more heap after UBIFS unmount than before mount */
+#define CONFIG_KMEM_LEAK_REPORT
+
+/* UBI ZPL gatekeeper: merging of queued writes to the same file */
+/* max. number of queued requests merged into one write (1 disables merging) */
+#define CONFIG_UBI_ZPL_MERGE_MAX_REQS               (8)
+/* max. size of a merged write in bytes */
+#define CONFIG_UBI_ZPL_MERGE_MAX_BYTES              (16384)
+/* how long to wait for the next adjacent write before flushing */
+#define CONFIG_UBI_ZPL_MERGE_WINDOW_MS              (2)
+/* max. delay added to the first write of a merge */
+#define CONFIG_UBI_ZPL_MERGE_MAX_LATENCY_MS         (10)
+
+/* UBI ZPL gatekeeper: read-ahead for sequential file reads */
+/* number of files tracked at once, each owns a buffer of CONFIG_UBI_ZPL_RA_MAX_BYTES */
+#define CONFIG_UBI_ZPL_RA_STREAMS                   (2)
+/* first prefetch size once a sequential reader is detected */
+#define CONFIG_UBI_ZPL_RA_MIN_BYTES                 (8192)
+/* largest prefetch size, the window doubles up to this on every fill */
+#define CONFIG_UBI_ZPL_RA_MAX_BYTES                 (65536)
+/* longest file name tracked, longer names are read without read-ahead */
+#define CONFIG_UBI_ZPL_RA_NAME_LEN                  (64)
+
+/* UBI ZPL gatekeeper: background scrubber, only runs while the queue is empty */
+/* pages read per scrub step */
+#define CONFIG_UBI_ZPL_SCRUB_PAGES                  (4)
+/* minimum time between two scrub steps */
+#define CONFIG_UBI_ZPL_SCRUB_INTERVAL_MS            (100)
+/* pause after each walk over the whole partition */
+#define CONFIG_UBI_ZPL_SCRUB_PASS_PAUSE_MS          (3600000)
+
+/* UBI ZPL key/value environment, a log of CRC protected records in a UBI volume of its own (remove to disable) */
+#define CONFIG_UBI_ZPL_ENV_VOLUME                   "env"
+/* bytes of the volume's first LEB used for the log, kept in RAM, a multiple of the NAND page size */
+#define CONFIG_UBI_ZPL_ENV_LOG_BYTES                (16384)
+/* max. number of keys, the index has twice as many slots */
+#define CONFIG_UBI_ZPL_ENV_MAX_KEYS                 (64)
+/* longest key and longest value in bytes */
+#define CONFIG_UBI_ZPL_ENV_KEY_LEN                  (32)
+#define CONFIG_UBI_ZPL_ENV_VAL_LEN                  (256)
 
 #define CONFIG_SYS_LOAD_ADDR                        (0x20200000)
 
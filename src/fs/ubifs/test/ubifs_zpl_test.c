@@ -16,12 +16,27 @@
 // File dependencies.
 //*****************************************************************************
 #include "stdlib.h"
+#include "limits.h"
 #include "zplCompat.h"
 #include "FreeRTOS.h"
 #include "task.h"
 #include "queue.h"
 #include "semphr.h"
 #include "../ubifs_zpl.h"
+#if (ENABLE_FASTMAP_TEST == 1)
+#include "stdio.h"
+#include "ubi_uboot.h"
+#include "ubifs_uboot.h"
+#endif /* #if (ENABLE_FASTMAP_TEST == 1) */
+#if (ENABLE_BBT_TEST == 1)
+#include "nand.h"
+#include "jffs2/load_kernel.h"
+#include "BSP_nandDrv.h"
+#endif /* #if (ENABLE_BBT_TEST == 1) */
+#if (ENABLE_GC_POLICY_TEST == 1)
+#include "stdio.h"
+#include "ubifs_uboot.h"
+#endif /* #if (ENABLE_GC_POLICY_TEST == 1) */
 
 //*****************************************************************************
 // Private definitions.
@@ -45,8 +60,6 @@ static StaticSemaphore_t semBuffEnvOpDone;
 static StaticTask_t xTaskFsTest;
 static StackType_t xTaskStackFsTest[configTASK_STACK_FS_TEST];
 static TaskHandle_t xTaskHandleFsTest = NULL;
-static SemaphoreHandle_t semHdlFsOpDone = NULL;
-static StaticSemaphore_t semBuffFsOpDone;
 #endif /* #if (ENABLE_FS_TEST == 1) */
 
 //*****************************************************************************
@@ -79,7 +92,7 @@ static StaticSemaphore_t semBuffFsOpDone;
 //*****************************************************************************
 
 #if(ENABLE_ENV_TEST == 1)
-static void _EnvTest_cb(bool sts)
+static void _EnvTest_cb(int sts)
 {
     xSemaphoreGive(semHdlEnvOpDone);
 }
@@ -91,6 +104,101 @@ const char * const appFileKey = "appfile";
 const char * const bootFileOne = "/firmware/EnvTestBinaryOne.uImage";
 const char * const bootFileTwo = "/firmware/EnvTestBinaryTwo.uImage";
 
+#ifndef CONFIG_UBI_ZPL_ENV_VOLUME
+#error "ENABLE_ENV_TEST needs CONFIG_UBI_ZPL_ENV_VOLUME"
+#endif
+#define ENV_TEST_KEYS       (8)
+#define ENV_TEST_VAL_LEN    (64)
+/* sets between saves of the fill */
+#define ENV_TEST_SAVE_EVERY (32)
+
+/* value of a key in a round, different in every round */
+static void _EnvTest_Value(uint32_t key, uint32_t round, char * buf)
+{
+    int len;
+
+    memset(buf, 'a' + key, ENV_TEST_VAL_LEN);
+    len = snprintf(buf, ENV_TEST_VAL_LEN, "%u:%u:", key, round);
+    buf[len] = 'a' + key;
+    buf[ENV_TEST_VAL_LEN] = '\0';
+}
+
+static bool _EnvTest_Compact(void)
+{
+    char expect[ENV_TEST_VAL_LEN + 1];
+    uint32_t written = 0;
+    uint32_t round = 0;
+    uint32_t sets = 0;
+    uint32_t key;
+    int err;
+
+    /* Twice the log in records, so it has to be packed on the way */
+    while(written <= (2 * CONFIG_UBI_ZPL_ENV_LOG_BYTES)) {
+        round++;
+        for(key = 0; key < ENV_TEST_KEYS; key++) {
+            snprintf(varname, ENV_TEST_BUF_SZ, "envtest%u", key);
+            _EnvTest_Value(key, round, valString);
+            err = UBI_ZPL_EnvSetSync(varname, strlen(varname), valString, ENV_TEST_VAL_LEN);
+            if(err) {
+                ubifs_zpl_test_debug("EnvTest: set %s FAILED (Err:%d)", varname, err);
+                return false;
+            }
+            written += strlen(varname) + ENV_TEST_VAL_LEN;
+            if((++sets % ENV_TEST_SAVE_EVERY) == 0) {
+                err = UBI_ZPL_EnvSaveSync();
+                if(err) {
+                    ubifs_zpl_test_debug("EnvTest: save FAILED (Err:%d)", err);
+                    return false;
+                }
+            }
+        }
+    }
+
+    /* Delete the first key and save */
+    snprintf(varname, ENV_TEST_BUF_SZ, "envtest%u", 0);
+    err = UBI_ZPL_EnvSetSync(varname, strlen(varname), NULL, 0);
+    if(!err) {
+        err = UBI_ZPL_EnvSaveSync();
+    }
+    if(err) {
+        ubifs_zpl_test_debug("EnvTest: delete FAILED (Err:%d)", err);
+        return false;
+    }
+
+    /* A value not saved must be gone after the log is read back from flash */
+    snprintf(varname, ENV_TEST_BUF_SZ, "envtest%u", 1);
+    _EnvTest_Value(1, 0, valString);
+    err = UBI_ZPL_EnvSetSync(varname, strlen(varname), valString, ENV_TEST_VAL_LEN);
+    if(!err) {
+        err = UBI_ZPL_EnvLoadSync();
+    }
+    if(err) {
+        ubifs_zpl_test_debug("EnvTest: reload FAILED (Err:%d)", err);
+        return false;
+    }
+
+    for(key = 0; key < ENV_TEST_KEYS; key++) {
+        snprintf(varname, ENV_TEST_BUF_SZ, "envtest%u", key);
+        err = UBI_ZPL_EnvGetSync(varname, strlen(varname), valString, ENV_TEST_BUF_SZ);
+        if(key == 0) {
+            if(err != -ENOENT) {
+                ubifs_zpl_test_debug("EnvTest: deleted %s FAILED (Err:%d)", varname, err);
+                return false;
+            }
+            continue;
+        }
+        _EnvTest_Value(key, round, expect);
+        if(err || (strcmp(valString, expect) != 0)) {
+            ubifs_zpl_test_debug("EnvTest: %s FAILED (Err:%d)", varname, err);
+            return false;
+        }
+    }
+
+    ubifs_zpl_test_debug("EnvTest: %u bytes of records in a %u byte log",
+                         written, CONFIG_UBI_ZPL_ENV_LOG_BYTES);
+    return true;
+}
+
 static void _EnvTest_Task(void *pxParam)
 {
     semHdlEnvOpDone = xSemaphoreCreateBinaryStatic(&semBuffEnvOpDone);
@@ -116,6 +224,8 @@ static void _EnvTest_Task(void *pxParam)
     xSemaphoreTake(semHdlEnvOpDone, portMAX_DELAY);
     ubifs_zpl_test_debug("Save Done");
 
+    ubifs_zpl_test_debug("EnvTest: %s", _EnvTest_Compact() ? "PASSED" : "FAILED");
+
     vTaskSuspend(NULL);
 }
 
@@ -136,21 +246,36 @@ void UBI_ZPL_EnvTestInit(void)
 static char * const testFile = "/fsTest_dir/fsTest.bin";
 static char * const dirname = "/fsTest_dir";
 #define MAX_FILE_SZ     65536
+#define FS_TEST_CHUNK_SZ    1024
+#define FS_TEST_HEAP_STATS_EVERY    (16)    /* iterations between heap stats tables */
 static char testDataOne[MAX_FILE_SZ];
 static char testDataTwo[MAX_FILE_SZ];
 static char * const iterationFile = "/iterationCount";
+static char * const streamFile = "/fsTest_dir/fsStream.bin";
+static char * const streamPartFile = "/fsTest_dir/fsStream.bin.part";
+static char * const renameFile = "/fsTest_dir/fsRename.bin";
 
-static void _FsTest_cb(bool sts)
+static void _FsTest_Check(int err)
 {
-    if(sts) {
-        xSemaphoreGive(semHdlFsOpDone);
-    } else {
-        ubifs_zpl_test_debug("FsTest: error on requested operation");
+    if(err) {
+        ubifs_zpl_test_debug("FsTest: error on requested operation (Err:%d)", err);
         vTaskSuspend(xTaskHandleFsTest);
         ubifs_zpl_test_debug("FsTest: xTaskHandleFsTest task suspended");
     }
 }
 
+/* Streaming read consumer, checks each piece against testDataOne */
+static int _FsTest_Compare(const void * buf, int len, void * priv)
+{
+    uint32_t * pos = (uint32_t *)priv;
+
+    if(memcmp(&testDataOne[*pos], buf, len) != 0) {
+        return -EIO;
+    }
+    *pos += len;
+    return 0;
+}
+
 static void _FsTest_Task(void *pxParam)
 {
     uint32_t actread;
@@ -160,34 +285,44 @@ static void _FsTest_Task(void *pxParam)
     uint32_t fileOffset;
     uint32_t idx;
     uint32_t fileSz;
-    int exist = 0;
+    uint32_t prevCount;
+    int bExist;
+    int busyErr;
+    uint32_t streamPos;
+    UBI_ZPL_BATCH_ENTRY_T bootOps[3];
+    UBI_ZPL_RA_STATS_T raStats;
 
-    semHdlFsOpDone = xSemaphoreCreateBinaryStatic(&semBuffFsOpDone);
     iterationCount = 0;
     srand(xTaskGetTickCount());
 
     while(1) {
         vTaskDelay(5000);
-        /* Check file exist */
-        UBI_ZPL_FileExist(iterationFile, &exist, _FsTest_cb);
-        xSemaphoreTake(semHdlFsOpDone, portMAX_DELAY);
-        if(exist) {
-            /* Get Test Iteration Count */
-            ubifs_zpl_test_debug("FsTest: Free Heap = %d, Min Free = %d", xPortGetFreeHeapSize(), xPortGetMinimumEverFreeHeapSize());
-            UBI_ZPL_FileRead(iterationFile, (void*)&iterationCount, 0, 4, &actread, _FsTest_cb);
-            xSemaphoreTake(semHdlFsOpDone, portMAX_DELAY);
+        /* Check files and get Test Iteration Count in one round trip */
+        memset(bootOps, 0, sizeof(bootOps));
+        bootOps[0].op = UBI_ZPL_BATCH_FILE_EXIST;
+        bootOps[0].name = iterationFile;
+        bootOps[1].op = UBI_ZPL_BATCH_FILE_READ;
+        bootOps[1].name = iterationFile;
+        bootOps[1].buf = (void *)&prevCount;
+        bootOps[1].size = 4;
+        bootOps[2].op = UBI_ZPL_BATCH_FILE_EXIST;
+        bootOps[2].name = dirname;
+        ubifs_zpl_test_debug("FsTest: Free Heap = %d, Min Free = %d", xPortGetFreeHeapSize(), xPortGetMinimumEverFreeHeapSize());
+        (void)UBI_ZPL_BatchSync(bootOps, 3);
+        _FsTest_Check(bootOps[0].err);
+        _FsTest_Check(bootOps[2].err);
+        if(bootOps[0].actual) {
+            _FsTest_Check(bootOps[1].err);
+            iterationCount = prevCount;
             ubifs_zpl_test_debug("FsTest: Iteration Count = %d", iterationCount);
             iterationCount++;
         }
 
         /* Create Folder */
-        UBI_ZPL_FileExist(dirname, &exist, _FsTest_cb);
-        xSemaphoreTake(semHdlFsOpDone, portMAX_DELAY);
-        if(!exist) {
+        if(!bootOps[2].actual) {
             ubifs_zpl_test_debug("FsTest: Free Heap = %d, Min Free = %d", xPortGetFreeHeapSize(), xPortGetMinimumEverFreeHeapSize());
             ubifs_zpl_test_debug("FsTest: Creating Test Directory, %s", dirname);
-            UBI_ZPL_MkDir(dirname, _FsTest_cb);
-            xSemaphoreTake(semHdlFsOpDone, portMAX_DELAY);
+            _FsTest_Check(UBI_ZPL_MkDirSync(dirname));
             ubifs_zpl_test_debug("FsTest: Done");
         }
 
@@ -200,24 +335,33 @@ static void _FsTest_Task(void *pxParam)
         }
 
         /* Write to file */
-        fileOffset = (rand() % 4096) * 4096;
+        fileOffset = rand() % (4096 * 4096);
         ubifs_zpl_test_debug("FsTest: Free Heap = %d, Min Free = %d", xPortGetFreeHeapSize(), xPortGetMinimumEverFreeHeapSize());
         ubifs_zpl_test_debug("FsTest: Writing random data to file at random offset (len: %d, offset: %d)", fileLen, fileOffset);
-        UBI_ZPL_FileWrite(testFile, (void *)testDataOne, fileOffset, fileLen, &actwritten, _FsTest_cb);
-        xSemaphoreTake(semHdlFsOpDone, portMAX_DELAY);
+        _FsTest_Check(UBI_ZPL_FileWriteSync(testFile, (void *)testDataOne, fileOffset, fileLen, &actwritten));
         ubifs_zpl_test_debug("FsTest: Done (%d bytes written)", actwritten);
 
         /* Check file size */
         ubifs_zpl_test_debug("FsTest: Free Heap = %d, Min Free = %d", xPortGetFreeHeapSize(), xPortGetMinimumEverFreeHeapSize());
-        UBI_ZPL_FileGetSize(testFile, &fileSz, _FsTest_cb);
-        xSemaphoreTake(semHdlFsOpDone, portMAX_DELAY);
+        _FsTest_Check(UBI_ZPL_FileGetSizeSync(testFile, &fileSz));
         ubifs_zpl_test_debug("FsTest: Size of %s: %d bytes", testFile, fileSz);
 
+        /* Append the same data and check it lands at the end of file */
+        ubifs_zpl_test_debug("FsTest: Free Heap = %d, Min Free = %d", xPortGetFreeHeapSize(), xPortGetMinimumEverFreeHeapSize());
+        ubifs_zpl_test_debug("FsTest: Appending %d bytes to %s", fileLen, testFile);
+        _FsTest_Check(UBI_ZPL_FileAppendSync(testFile, (void *)testDataOne, fileLen, &actwritten));
+        _FsTest_Check(UBI_ZPL_FileReadSync(testFile, (void *)testDataTwo, fileSz, fileLen, &actread));
+        _FsTest_Check(UBI_ZPL_FileGetSizeSync(testFile, &fileSz));
+        if((fileSz == fileOffset + 2 * fileLen) && (memcmp(testDataOne, testDataTwo, fileLen) == 0)) {
+            ubifs_zpl_test_debug("FsTest: Append OK!");
+        } else {
+            ubifs_zpl_test_debug("FsTest: ERROR on Append (size: %d)", fileSz);
+        }
+
         /* Read file and compare */
         ubifs_zpl_test_debug("FsTest: Free Heap = %d, Min Free = %d", xPortGetFreeHeapSize(), xPortGetMinimumEverFreeHeapSize());
         ubifs_zpl_test_debug("FsTest: Reading from %s", testFile);
-        UBI_ZPL_FileRead(testFile, (void *)testDataTwo, fileOffset, fileLen, &actread, _FsTest_cb);
-        xSemaphoreTake(semHdlFsOpDone, portMAX_DELAY);
+        _FsTest_Check(UBI_ZPL_FileReadSync(testFile, (void *)testDataTwo, fileOffset, fileLen, &actread));
         ubifs_zpl_test_debug("FsTest: Verifying file contents");
         if(memcmp(testDataOne, testDataTwo, fileLen) == 0) {
             ubifs_zpl_test_debug("FsTest: Verification OK!");
@@ -225,25 +369,106 @@ static void _FsTest_Task(void *pxParam)
             ubifs_zpl_test_debug("FsTest: ERROR on Verification");
         }
 
+        /* Read again in small sequential chunks, served mostly by read-ahead */
+        ubifs_zpl_test_debug("FsTest: Reading %s in %d byte chunks", testFile, FS_TEST_CHUNK_SZ);
+        memset(testDataTwo, 0, fileLen);
+        for(idx = 0; idx < fileLen; idx += actread) {
+            _FsTest_Check(UBI_ZPL_FileReadSync(testFile, (void *)&testDataTwo[idx], fileOffset + idx,
+                    ((fileLen - idx) < FS_TEST_CHUNK_SZ) ? (fileLen - idx) : FS_TEST_CHUNK_SZ, &actread));
+            if(actread == 0) {
+                break;
+            }
+        }
+        UBI_ZPL_GetReadAheadStats(&raStats);
+        if(memcmp(testDataOne, testDataTwo, fileLen) == 0) {
+            ubifs_zpl_test_debug("FsTest: Chunked read OK! (read-ahead hits: %d, misses: %d, prefetches: %d)",
+                    raStats.hits, raStats.misses, raStats.prefetches);
+        } else {
+            ubifs_zpl_test_debug("FsTest: ERROR on chunked read");
+        }
+
+        /* Punch out the first copy of the data, then cut off the appended one */
+        ubifs_zpl_test_debug("FsTest: Punching %d bytes at offset %d, truncating to %d", fileLen, fileOffset, fileOffset + fileLen);
+        _FsTest_Check(UBI_ZPL_FilePunchHoleSync(testFile, fileOffset, fileLen));
+        _FsTest_Check(UBI_ZPL_FileReadSync(testFile, (void *)testDataTwo, fileOffset, fileLen, &actread));
+        for(idx = 0; (idx < fileLen) && (testDataTwo[idx] == 0); idx++) {
+        }
+        _FsTest_Check(UBI_ZPL_FileReadSync(testFile, (void *)testDataTwo, fileOffset + fileLen, fileLen, &actread));
+        if(memcmp(testDataOne, testDataTwo, fileLen) != 0) {
+            idx = 0;
+        }
+        _FsTest_Check(UBI_ZPL_FileTruncateSync(testFile, fileOffset + fileLen));
+        _FsTest_Check(UBI_ZPL_FileGetSizeSync(testFile, &fileSz));
+        if((idx == fileLen) && (fileSz == fileOffset + fileLen)) {
+            ubifs_zpl_test_debug("FsTest: Punch hole and truncate OK!");
+        } else {
+            ubifs_zpl_test_debug("FsTest: ERROR on punch hole or truncate (size: %d)", fileSz);
+        }
+
+        /* Stream the data in random sized chunks, then abort a second stream */
+        ubifs_zpl_test_debug("FsTest: Streaming %d bytes to %s", fileLen, streamFile);
+        _FsTest_Check(UBI_ZPL_FileStreamBeginSync(streamFile));
+        for(idx = 0; idx < fileLen; idx += actwritten) {
+            actwritten = (rand() % (2 * FS_TEST_CHUNK_SZ)) + 1;
+            if(actwritten > fileLen - idx) {
+                actwritten = fileLen - idx;
+            }
+            _FsTest_Check(UBI_ZPL_FileStreamWriteSync(streamFile, (void *)&testDataOne[idx], actwritten));
+        }
+        _FsTest_Check(UBI_ZPL_FileStreamFinishSync(streamFile));
+        streamPos = 0;
+        _FsTest_Check(UBI_ZPL_FileReadStreamSync(streamFile, 0, 0, _FsTest_Compare, &streamPos, &actread));
+        _FsTest_Check(UBI_ZPL_FileGetSizeSync(streamFile, &fileSz));
+        /* The aborted stream must leave the finished file as it was */
+        _FsTest_Check(UBI_ZPL_FileStreamBeginSync(streamFile));
+        _FsTest_Check(UBI_ZPL_FileStreamWriteSync(streamFile, (void *)testDataOne, fileLen / 2));
+        busyErr = UBI_ZPL_RmFileSync(streamPartFile);
+        _FsTest_Check(UBI_ZPL_FileStreamAbortSync(streamFile));
+        _FsTest_Check(UBI_ZPL_FileExistSync(streamPartFile, &bExist));
+        streamPos = 0;
+        _FsTest_Check(UBI_ZPL_FileReadStreamSync(streamFile, 0, 0, _FsTest_Compare, &streamPos, &actread));
+        if((fileSz == fileLen) && (actread == fileLen) && !bExist && (busyErr == -EBUSY)) {
+            ubifs_zpl_test_debug("FsTest: Stream OK!");
+        } else {
+            ubifs_zpl_test_debug("FsTest: ERROR on Stream (size: %d)", fileSz);
+        }
+
+        /* Replace the test file the way a config file is updated */
+        ubifs_zpl_test_debug("FsTest: Renaming %s over %s", renameFile, testFile);
+        _FsTest_Check(UBI_ZPL_FileWriteSync(renameFile, (void *)testDataOne, 0, fileLen, &actwritten));
+        _FsTest_Check(UBI_ZPL_FileRenameSync(renameFile, testFile));
+        _FsTest_Check(UBI_ZPL_FileExistSync(renameFile, &bExist));
+        _FsTest_Check(UBI_ZPL_FileGetSizeSync(testFile, &fileSz));
+        _FsTest_Check(UBI_ZPL_FileReadSync(testFile, (void *)testDataTwo, 0, fileLen, &actread));
+        if((fileSz == fileLen) && !bExist && (memcmp(testDataOne, testDataTwo, fileLen) == 0)) {
+            ubifs_zpl_test_debug("FsTest: Rename OK!");
+        } else {
+            ubifs_zpl_test_debug("FsTest: ERROR on Rename (size: %d)", fileSz);
+        }
+
         /* Delete File */
         ubifs_zpl_test_debug("FsTest: Free Heap = %d, Min Free = %d", xPortGetFreeHeapSize(), xPortGetMinimumEverFreeHeapSize());
         ubifs_zpl_test_debug("FsTest: Deleting file %s", testFile);
-        UBI_ZPL_RmFile(testFile, _FsTest_cb);
-        xSemaphoreTake(semHdlFsOpDone, portMAX_DELAY);
+        _FsTest_Check(UBI_ZPL_RmFileSync(testFile));
         ubifs_zpl_test_debug("FsTest: Done");
 
         /* Delete Folder */
         ubifs_zpl_test_debug("FsTest: Free Heap = %d, Min Free = %d", xPortGetFreeHeapSize(), xPortGetMinimumEverFreeHeapSize());
         ubifs_zpl_test_debug("FsTest: Deleting Test Directory, %s", dirname);
-        UBI_ZPL_RmDir(dirname, _FsTest_cb);
-        xSemaphoreTake(semHdlFsOpDone, portMAX_DELAY);
+        _FsTest_Check(UBI_ZPL_RmDirSync(dirname));
         ubifs_zpl_test_debug("FsTest: Done");
 
         /* Store Iteration Count */
         ubifs_zpl_test_debug("FsTest: Free Heap = %d, Min Free = %d", xPortGetFreeHeapSize(), xPortGetMinimumEverFreeHeapSize());
-        UBI_ZPL_FileWrite(iterationFile, (void*)&iterationCount, 0, 4, &actwritten, _FsTest_cb);
-        xSemaphoreTake(semHdlFsOpDone, portMAX_DELAY);
+        _FsTest_Check(UBI_ZPL_FileWriteSync(iterationFile, (void*)&iterationCount, 0, 4, &actwritten));
+        /* The count must survive a reset even with a write-back cache */
+        _FsTest_Check(UBI_ZPL_FileSyncSync(iterationFile));
         ubifs_zpl_test_debug("FsTest: written updated iteration count");
+
+        /* Show which subsystem holds the heap, to spot drift over a soak run */
+        if((iterationCount % FS_TEST_HEAP_STATS_EVERY) == 0) {
+            UBI_ZPL_PrintHeapStats();
+        }
     }
     vTaskSuspend(NULL);
 }
@@ -261,4 +486,301 @@ void UBI_ZPL_FsTestInit(void)
 }
 #endif /* #if (ENABLE_FS_TEST == 1) */
 
+#if (ENABLE_FASTMAP_TEST == 1)
+#ifndef CONFIG_MTD_UBI_FASTMAP
+#error "ENABLE_FASTMAP_TEST needs CONFIG_MTD_UBI_FASTMAP"
+#endif
+/* upper bound of header writes a fastmap update is cut after */
+#define FASTMAP_TEST_MAX_WRITES     (64)
+
+static bool _FastmapTest_Reattach(const char * what)
+{
+    unsigned int ms = 0;
+    int byFm = 0;
+    int err;
+
+    err = ubi_part(PARTITION_NAME_DEFAULT, NULL);
+    if(err) {
+        ubifs_zpl_test_debug("FastmapTest: %s: attach FAILED (Err:%d)", what, err);
+        return false;
+    }
+    (void)ubi_attach_stats(&ms, &byFm);
+    ubifs_zpl_test_debug("FastmapTest: %s: attached by %s in %u ms",
+            what, byFm ? "fastmap" : "scanning", ms);
+
+    /* The volume must still hold a mountable UBIFS */
+    err = uboot_ubifs_mount(VOLUME_NAME_DEFAULT);
+    if(err) {
+        ubifs_zpl_test_debug("FastmapTest: %s: UBIFS mount FAILED (Err:%d)", what, err);
+        return false;
+    }
+    uboot_ubifs_umount();
+    return true;
+}
+
+//*****************************************************************************
+//!
+//! \brief Cut power at every point of a fastmap update and re-attach.
+//!
+//! Runs in the gatekeeper task once UBIFS is initialized and before it is
+//! mounted. For n = 1, 2, ... a fastmap update is cut after n header writes
+//! and the partition is re-attached, until an update completes before the
+//! cut. The attach after a clean detach shows the fastmap attach time, the
+//! ones after a cut show the fallback to scanning.
+//!
+//*****************************************************************************
+void UBI_ZPL_FastmapTest(void)
+{
+    unsigned int ms = 0;
+    int byFm = 0;
+    unsigned int writes;
+    int cut;
+    char what[32];
+
+    (void)ubi_attach_stats(&ms, &byFm);
+    ubifs_zpl_test_debug("FastmapTest: boot: attached by %s in %u ms",
+            byFm ? "fastmap" : "scanning", ms);
+
+    /* A clean detach writes a fastmap for the next attach to use */
+    if(!_FastmapTest_Reattach("clean detach")) {
+        vTaskSuspend(NULL);
+    }
+
+    for(writes = 1; writes <= FASTMAP_TEST_MAX_WRITES; writes++) {
+        cut = ubi_fastmap_power_cut(writes);
+        if(cut < 0) {
+            ubifs_zpl_test_debug("FastmapTest: fastmap update failed (Err:%d)", cut);
+            vTaskSuspend(NULL);
+        }
+        snprintf(what, sizeof(what), "cut after %u writes", writes);
+        if(!_FastmapTest_Reattach(cut ? what : "update completed")) {
+            vTaskSuspend(NULL);
+        }
+        if(!cut) {
+            break;
+        }
+    }
+    ubifs_zpl_test_debug("FastmapTest: PASSED");
+}
+#endif /* #if (ENABLE_FASTMAP_TEST == 1) */
+
+#if (ENABLE_BBT_TEST == 1)
+#ifndef CONFIG_SYS_NAND_USE_FLASH_BBT
+#error "ENABLE_BBT_TEST needs CONFIG_SYS_NAND_USE_FLASH_BBT"
+#endif
+
+static bool _BbtTest_InBbtArea(struct mtd_info * mtd, int page)
+{
+    struct nand_chip * chip = mtd_to_nand(mtd);
+    loff_t ofs = (loff_t)page << chip->page_shift;
+
+    return (page >= 0) &&
+           (ofs >= (mtd->size - (NAND_BBT_SCAN_MAXBLOCKS * mtd->erasesize))) &&
+           (mtd_block_isbad(mtd, ofs) != 0);
+}
+
+//*****************************************************************************
+//!
+//! \brief Check the flash bad block table and its RAM copy.
+//!
+//! Runs in the gatekeeper task once the MTD partitions exist. The UBI
+//! partition must end before the last NAND_BBT_SCAN_MAXBLOCKS, the main and
+//! mirror tables must sit in different blocks of those and show up as
+//! reserved, and looking up every block must not touch the NAND.
+//!
+//*****************************************************************************
+void UBI_ZPL_BbtTest(void)
+{
+    struct mtd_info * mtd = get_nand_dev_by_index(0);
+    struct nand_chip * chip;
+    struct mtd_device * dev;
+    struct part_info * part;
+    u8 pnum;
+    BSP_NAND_STATS_T nandStats;
+    TickType_t start;
+    TickType_t elapsed;
+    uint32_t block;
+    uint32_t nBlocks;
+    uint32_t nBad = 0;
+    int mainPage;
+    int mirrorPage;
+
+    if(mtd == NULL) {
+        ubifs_zpl_test_debug("BbtTest: FAILED, no NAND device");
+        return;
+    }
+    chip = mtd_to_nand(mtd);
+
+    if(find_dev_and_part(PARTITION_NAME_DEFAULT, &dev, &pnum, &part) != 0) {
+        ubifs_zpl_test_debug("BbtTest: FAILED, no %s partition", PARTITION_NAME_DEFAULT);
+        return;
+    }
+    if((part->offset + part->size) > (mtd->size - (NAND_BBT_SCAN_MAXBLOCKS * mtd->erasesize))) {
+        ubifs_zpl_test_debug("BbtTest: FAILED, %s ends at 0x%llx, inside the BBT blocks",
+                PARTITION_NAME_DEFAULT, (unsigned long long)(part->offset + part->size));
+        return;
+    }
+
+    /* The first lookup reads the table, or scans and writes it on a new chip */
+    (void)mtd_block_isbad(mtd, 0);
+    if((chip->bbt == NULL) || (chip->bbt_td == NULL) || (chip->bbt_md == NULL)) {
+        ubifs_zpl_test_debug("BbtTest: FAILED, no flash BBT");
+        return;
+    }
+    mainPage = chip->bbt_td->pages[0];
+    mirrorPage = chip->bbt_md->pages[0];
+    if(!_BbtTest_InBbtArea(mtd, mainPage) || !_BbtTest_InBbtArea(mtd, mirrorPage) ||
+       ((mainPage >> (chip->bbt_erase_shift - chip->page_shift)) ==
+        (mirrorPage >> (chip->bbt_erase_shift - chip->page_shift)))) {
+        ubifs_zpl_test_debug("BbtTest: FAILED, BBT at page %d, mirror at page %d", mainPage, mirrorPage);
+        return;
+    }
+
+    nBlocks = (uint32_t)(mtd->size >> chip->bbt_erase_shift);
+    BSP_NAND_ResetStats();
+    start = xTaskGetTickCount();
+    for(block = 0; block < nBlocks; block++) {
+        if(mtd_block_isbad(mtd, (loff_t)block << chip->bbt_erase_shift)) {
+            nBad++;
+        }
+    }
+    elapsed = xTaskGetTickCount() - start;
+    BSP_NAND_GetStats(&nandStats);
+    if(nandStats.pageLoads != 0) {
+        ubifs_zpl_test_debug("BbtTest: FAILED, %u page loads for lookups", nandStats.pageLoads);
+        return;
+    }
+
+    ubifs_zpl_test_debug("BbtTest: BBT at page %d, mirror at page %d, %u of %u blocks bad or reserved, lookups took %u ticks",
+            mainPage, mirrorPage, nBad, nBlocks, elapsed);
+    ubifs_zpl_test_debug("BbtTest: PASSED");
+}
+#endif /* #if (ENABLE_BBT_TEST == 1) */
+
+#if (ENABLE_GC_POLICY_TEST == 1)
+#ifndef CONFIG_UBIFS_GC_COST_BENEFIT
+#error "ENABLE_GC_POLICY_TEST needs CONFIG_UBIFS_GC_COST_BENEFIT"
+#endif
+#define GC_TEST_DIR                 "/gcTest"
+#define GC_TEST_HOT_DIR             GC_TEST_DIR "/hot"
+#define GC_TEST_COLD_SZ             (65536)
+#define GC_TEST_COLD_MAX            (1024)
+#define GC_TEST_HOT_FILES           (8)
+#define GC_TEST_HOT_SZ              (16384)
+#define GC_TEST_HOT_BYTES           (8 * 1024 * 1024)
+
+static uint8_t gcTestBuf[GC_TEST_COLD_SZ];
+
+/* Returns the bytes moved by GC, or ULLONG_MAX if the run failed */
+static unsigned long long _GcTest_Run(int costBenefit, int hot, const char * name)
+{
+    char path[32];
+    loff_t actual;
+    unsigned long long written = 0;
+    unsigned long long moved;
+    uint32_t nCold;
+    uint32_t i;
+    int err;
+
+    ubifs_gc_set_cost_benefit(costBenefit);
+    err = ubifs_mkdir(GC_TEST_DIR);
+    if(!err) {
+        err = ubifs_mkdir(GC_TEST_HOT_DIR);
+    }
+#ifdef CONFIG_UBIFS_HOT_JHEAD
+    if(!err && hot) {
+        err = ubifs_set_hot(GC_TEST_HOT_DIR, 1);
+    }
+#endif /* CONFIG_UBIFS_HOT_JHEAD */
+    if(err) {
+        ubifs_zpl_test_debug("GcPolicyTest: %s: mkdir FAILED (Err:%d)", name, err);
+        return ULLONG_MAX;
+    }
+
+    /* Cold data fills the volume, every eighth file is dropped again */
+    for(nCold = 0; nCold < GC_TEST_COLD_MAX; nCold++) {
+        snprintf(path, sizeof(path), GC_TEST_DIR "/c%u", nCold);
+        memset(gcTestBuf, (int)nCold, GC_TEST_COLD_SZ);
+        if(ubifs_write(path, gcTestBuf, 0, GC_TEST_COLD_SZ, &actual) || ubifs_sync()) {
+            (void)ubifs_unlink(path);
+            break;
+        }
+    }
+    for(i = 0; i < nCold; i += 8) {
+        snprintf(path, sizeof(path), GC_TEST_DIR "/c%u", i);
+        (void)ubifs_unlink(path);
+    }
+    (void)ubifs_sync();
+
+    /* Hot files are overwritten round-robin, GC has to make their space */
+    moved = ubifs_gc_moved_bytes();
+    while(written < GC_TEST_HOT_BYTES) {
+        for(i = 0; i < GC_TEST_HOT_FILES; i++) {
+            snprintf(path, sizeof(path), GC_TEST_HOT_DIR "/h%u", i);
+            memset(gcTestBuf, (int)(written >> 10), GC_TEST_HOT_SZ);
+            err = ubifs_write(path, gcTestBuf, 0, GC_TEST_HOT_SZ, &actual);
+            if(err) {
+                ubifs_zpl_test_debug("GcPolicyTest: %s: write FAILED (Err:%d)", name, err);
+                break;
+            }
+            written += GC_TEST_HOT_SZ;
+        }
+        if(err || ubifs_sync()) {
+            break;
+        }
+    }
+    moved = ubifs_gc_moved_bytes() - moved;
+    ubifs_zpl_test_debug("GcPolicyTest: %s: %u cold files, %llu KiB written, %llu KiB moved by GC (%llu%%)",
+            name, nCold, written >> 10, moved >> 10, written ? (moved * 100) / written : 0);
+    if(written < GC_TEST_HOT_BYTES) {
+        moved = ULLONG_MAX;
+    }
+
+    for(i = 0; i < nCold; i++) {
+        snprintf(path, sizeof(path), GC_TEST_DIR "/c%u", i);
+        (void)ubifs_unlink(path);
+    }
+    for(i = 0; i < GC_TEST_HOT_FILES; i++) {
+        snprintf(path, sizeof(path), GC_TEST_HOT_DIR "/h%u", i);
+        (void)ubifs_unlink(path);
+    }
+    (void)ubifs_rmdir(GC_TEST_HOT_DIR);
+    (void)ubifs_rmdir(GC_TEST_DIR);
+    (void)ubifs_sync();
+
+    return moved;
+}
+
+//*****************************************************************************
+//!
+//! \brief Compare the bytes moved by greedy and cost-benefit GC.
+//!
+//! Runs in the gatekeeper task once UBIFS is mounted. The same hot/cold
+//! workload runs under each victim selection policy, and with the hot files
+//! on a journal head of their own, and the bytes GC copied are reported
+//! against the bytes written. The test fails if a run could not write the
+//! whole workload, or moved more than the run before.
+//!
+//*****************************************************************************
+void UBI_ZPL_GcPolicyTest(void)
+{
+    unsigned long long greedy;
+    unsigned long long costBenefit;
+    bool pass;
+
+    greedy = _GcTest_Run(0, 0, "greedy");
+    costBenefit = _GcTest_Run(1, 0, "cost-benefit");
+    pass = (greedy != ULLONG_MAX) && (costBenefit <= greedy);
+#ifdef CONFIG_UBIFS_HOT_JHEAD
+    pass = (_GcTest_Run(1, 1, "cost-benefit, hot head") <= costBenefit) && pass;
+#endif /* CONFIG_UBIFS_HOT_JHEAD */
+    ubifs_gc_set_cost_benefit(1);
+    if(pass) {
+        ubifs_zpl_test_debug("GcPolicyTest: PASSED");
+    } else {
+        ubifs_zpl_test_debug("GcPolicyTest: FAILED");
+    }
+}
+#endif /* #if (ENABLE_GC_POLICY_TEST == 1) */
+
 #endif /* #if (ENABLE_UBIFS_ZPL_TEST == 1) */
@@ -21,6 +21,9 @@
 //*****************************************************************************
 #define ENABLE_ENV_TEST                 (0)
 #define ENABLE_FS_TEST                  (1)
+#define ENABLE_FASTMAP_TEST             (0)
+#define ENABLE_BBT_TEST                 (1)
+#define ENABLE_GC_POLICY_TEST           (0)
 
 
 //*****************************************************************************
@@ -38,6 +41,18 @@ void UBI_ZPL_EnvTestInit(void);
 void UBI_ZPL_FsTestInit(void);
 #endif /* #if (ENABLE_FS_TEST == 1) */
 
+#if (ENABLE_FASTMAP_TEST == 1)
+void UBI_ZPL_FastmapTest(void);
+#endif /* #if (ENABLE_FASTMAP_TEST == 1) */
+
+#if (ENABLE_BBT_TEST == 1)
+void UBI_ZPL_BbtTest(void);
+#endif /* #if (ENABLE_BBT_TEST == 1) */
+
+#if (ENABLE_GC_POLICY_TEST == 1)
+void UBI_ZPL_GcPolicyTest(void);
+#endif /* #if (ENABLE_GC_POLICY_TEST == 1) */
+
 #if defined(__cplusplus)
 }
 #endif /* __cplusplus*/
@@ -22,8 +22,10 @@
 #include "semphr.h"
 #include "ubiFsConfig.h"
 #include "ubi_uboot.h"
+#include "ubifs_uboot.h"
 #include "jffs2/load_kernel.h"
 #include "BSP_uart.h"
+#include "BSP_nandDrv.h"
 #include "test/ubifs_zpl_test.h"
 
 //*****************************************************************************
@@ -43,6 +45,24 @@ typedef enum {
     UBI_ZPL_FILE_REMOVE,
     UBI_ZPL_DIR_MAKE,
     UBI_ZPL_DIR_REMOVE,
+    UBI_ZPL_BATCH,
+    UBI_ZPL_FILE_APPEND,
+    UBI_ZPL_FLUSH,
+    UBI_ZPL_FILE_SYNC,
+    UBI_ZPL_WEAR_STATS,
+    UBI_ZPL_SET_HOT,
+    UBI_ZPL_STREAM_BEGIN,
+    UBI_ZPL_STREAM_WRITE,
+    UBI_ZPL_STREAM_FINISH,
+    UBI_ZPL_STREAM_ABORT,
+    UBI_ZPL_FILE_READ_STREAM,
+    UBI_ZPL_FILE_TRUNCATE,
+    UBI_ZPL_FILE_PUNCH_HOLE,
+    UBI_ZPL_FILE_RENAME,
+    UBI_ZPL_ENV_GET,
+    UBI_ZPL_ENV_SET,
+    UBI_ZPL_ENV_SAVE,
+    UBI_ZPL_ENV_LOAD,
 } ubi_zpl_ops_t;
 
 typedef struct {
@@ -53,8 +73,46 @@ typedef struct {
     uint32_t param4;
     uint32_t param5;
     ubi_zpl_cb_fcn cb;
+    TaskHandle_t notify;    /* Caller to notify on completion (synchronous requests) */
+    int * result;           /* Where the gatekeeper stores the errno for the caller */
 } ubi_zpl_req_t;
 
+typedef struct {
+    ubi_zpl_consume_fcn consume;
+    void * priv;
+} ubi_zpl_consumer_t;
+
+typedef struct {
+    char name[CONFIG_UBI_ZPL_RA_NAME_LEN];  /* Tracked file, empty if unused */
+    uint32_t nextOff;       /* Offset following the last read served */
+    uint32_t bufOff;        /* File offset of buf[0] */
+    uint32_t bufLen;        /* Number of valid bytes in buf */
+    uint32_t window;        /* Size of the next prefetch */
+    uint32_t lastUse;       /* For replacing the least recently used stream */
+    bool eof;               /* buf reaches the end of the file */
+    bool pending;           /* Prefetch to run once the queue is idle */
+    uint8_t buf[CONFIG_UBI_ZPL_RA_MAX_BYTES];
+} ubi_zpl_ra_t;
+
+#define UBI_ZPL_RA_NO_OFFSET            (0xFFFFFFFFu)
+
+#ifdef CONFIG_UBI_ZPL_ENV_VOLUME
+/* Environment record, followed by the key, the value and padding to 4 bytes */
+typedef struct {
+    uint32_t magic;         /* UBI_ZPL_ENV_MAGIC */
+    uint32_t crc;           /* CRC32 of klen, vlen, the key and the value */
+    uint16_t klen;          /* Key length */
+    uint16_t vlen;          /* Value length, 0 records the deletion of the key */
+} ubi_zpl_env_rec_t;
+
+#define UBI_ZPL_ENV_MAGIC               (0x564E455Au)
+#define UBI_ZPL_ENV_ERASED              (0xFFFFFFFFu)
+#define UBI_ZPL_ENV_UBI_NUM             (0)
+#define UBI_ZPL_ENV_SLOTS               (2 * CONFIG_UBI_ZPL_ENV_MAX_KEYS)
+#define UBI_ZPL_ENV_FREE                (0xFFFFFFFFu)   /* Index slot not in use */
+#define UBI_ZPL_ENV_GONE                (0xFFFFFFFEu)   /* Slot of a deleted key, while compacting */
+#define UBI_ZPL_ENV_REC_SZ(klen, vlen)  ALIGN((uint32_t)sizeof(ubi_zpl_env_rec_t) + (klen) + (vlen), 4)
+#endif /* CONFIG_UBI_ZPL_ENV_VOLUME */
 #define UBI_Q_LEN                       (10)
 #define UBI_Q_ITEM_SZ                   (sizeof(ubi_zpl_req_t))
 #define OP_THRES                        (512)
@@ -79,6 +137,42 @@ static bool bUbiFsInited = false;
 static bool bUbiFsMounted = false;
 static bool bInitDone = false;
 
+/* Write merging */
+static ubi_zpl_req_t xMergeReq[CONFIG_UBI_ZPL_MERGE_MAX_REQS];
+static uint8_t ucMergeBuf[CONFIG_UBI_ZPL_MERGE_MAX_BYTES];
+
+/* Read-ahead */
+static ubi_zpl_ra_t xReadAhead[CONFIG_UBI_ZPL_RA_STREAMS];
+static uint32_t ulReadAheadUse = 0;
+static UBI_ZPL_RA_STATS_T xReadAheadStats;
+
+/* NAND traffic of the boot-time UBI attach */
+static BSP_NAND_STATS_T xAttachNandStats;
+
+#ifdef CONFIG_MTD_UBI_SCRUB_BITFLIPS
+/* Background scrubber */
+static TickType_t xScrubLastTick = 0;
+static uint32_t ulScrubWaitMs = CONFIG_UBI_ZPL_SCRUB_INTERVAL_MS;
+static uint32_t ulScrubPasses = 0;
+#endif
+
+#ifdef CONFIG_UBIFS_BG_GC_LEBS
+/* Background GC, set by every request as it may have left dirty space */
+static bool bGcPending = false;
+#endif
+
+#ifdef CONFIG_UBI_ZPL_ENV_VOLUME
+/* Key/value environment: the log as on flash, and its records by key */
+static struct ubi_volume_desc * pxEnvVol = NULL;
+static uint8_t ucEnvLog[CONFIG_UBI_ZPL_ENV_LOG_BYTES] __attribute__((aligned(4)));
+static uint32_t ulEnvIndex[UBI_ZPL_ENV_SLOTS];  /* Log offset of the latest record of a key */
+static uint32_t ulEnvKeys = 0;          /* Index slots in use */
+static uint32_t ulEnvSaved = 0;         /* ucEnvLog up to here is on flash */
+static uint32_t ulEnvEnd = 0;           /* Where the next record goes */
+static uint32_t ulEnvMinIo = 0;         /* UBI write unit */
+static bool bEnvRewrite = false;        /* Flash copy must be replaced as a whole */
+#endif
+
 char logData[MAX_LOG_LEN+1];
 
 //*****************************************************************************
@@ -96,6 +190,41 @@ extern int mtd_pagetest_init(void);
 // Private function prototypes.
 //*****************************************************************************
 static void _Ubi_Task(void *pxParam);
+static int _Ubi_Mount(void);
+static bool _Ubi_UbiOnly(ubi_zpl_ops_t op);
+static int _Ubi_Execute(ubi_zpl_req_t * req);
+static int _Ubi_ExecuteBatch(UBI_ZPL_BATCH_ENTRY_T * ops, uint32_t nOps);
+static bool _Ubi_BatchValid(const UBI_ZPL_BATCH_ENTRY_T * ops, uint32_t nOps);
+static int _Ubi_WearStats(UBI_ZPL_WEAR_STATS_T * stats);
+static uint32_t _Ubi_WriteMerged(const ubi_zpl_req_t * first);
+static void _Ubi_Complete(const ubi_zpl_req_t * req, int err);
+static int _Ubi_Read(const char * name, void * buf, uint32_t offset, uint32_t size, uint32_t * actread);
+static ubi_zpl_ra_t * _Ubi_RaFind(const char * name, bool create);
+static void _Ubi_RaInvalidate(const char * name);
+static bool _Ubi_RaPending(void);
+static bool _Ubi_RaFill(void);
+#ifdef CONFIG_UBIFS_BG_GC_LEBS
+static int _Ubi_GcYield(void);
+static bool _Ubi_Gc(void);
+#endif
+#ifdef CONFIG_MTD_UBI_SCRUB_BITFLIPS
+static TickType_t _Ubi_ScrubTicks(void);
+static bool _Ubi_Scrub(void);
+#endif
+#ifdef CONFIG_UBI_ZPL_ENV_VOLUME
+static int _Ubi_EnvAttach(void);
+static ubi_zpl_env_rec_t * _Ubi_EnvRecord(uint32_t * offs, uint32_t end);
+static uint32_t _Ubi_EnvSlot(const char * key, uint32_t klen);
+static void _Ubi_EnvPack(void);
+static int _Ubi_EnvCompact(void);
+static int _Ubi_EnvGet(const char * key, uint32_t klen, char * buf, uint32_t bufsz);
+static int _Ubi_EnvSet(const char * key, uint32_t klen, const char * val, uint32_t vlen);
+static int _Ubi_EnvSave(void);
+static int _Ubi_EnvLoad(void);
+#endif
+static TickType_t _Ubi_IdleTicks(void);
+static UBI_ZPL_RET_T _Ubi_Submit(ubi_zpl_req_t * req);
+static int _Ubi_SubmitSync(ubi_zpl_req_t * req);
 
 //*****************************************************************************
 // Public function implementations
@@ -145,10 +274,8 @@ UBI_ZPL_RET_T UBI_ZPL_Init(void)
 static void _Ubi_Task(void *pxParam)
 {
     ubi_zpl_req_t ubiZplReq;
-    int sts = 0;
     int err = 0;
     int opCnt = 0;
-    loff_t temp64;
 
     bUbiPartMounted = false;
     bUbiFsInited = false;
@@ -172,9 +299,22 @@ static void _Ubi_Task(void *pxParam)
 #if(ENABLE_MTD_PAGE_TEST == 1)
     mtd_pagetest_init();
 #endif
+
+#if((ENABLE_UBIFS_ZPL_TEST == 1) && (ENABLE_BBT_TEST == 1))
+    UBI_ZPL_BbtTest();
+#endif /* #if((ENABLE_UBIFS_ZPL_TEST == 1) && (ENABLE_BBT_TEST == 1)) */
     /* Initialize the default UBI partition */
     ubifs_zpl_debug("Info: Initializing UBI partition...");
+    BSP_NAND_ResetStats();
     err = ubi_part(PARTITION_NAME_DEFAULT, NULL);
+    BSP_NAND_GetStats(&xAttachNandStats);
+#ifdef CONFIG_MXRT105X_NAND_PARTIAL_READ
+    ubifs_zpl_debug("Info: UBI attach (partial page reads): %u page loads, %u bytes in %u transfers",
+            xAttachNandStats.pageLoads, xAttachNandStats.readBytes, xAttachNandStats.readXfers);
+#else
+    ubifs_zpl_debug("Info: UBI attach (whole page reads): %u page loads, %u bytes in %u transfers",
+            xAttachNandStats.pageLoads, xAttachNandStats.readBytes, xAttachNandStats.readXfers);
+#endif /* CONFIG_MXRT105X_NAND_PARTIAL_READ */
     if(!err) {
         bUbiPartMounted = true;
     } else {
@@ -183,6 +323,14 @@ static void _Ubi_Task(void *pxParam)
         vTaskSuspend(NULL);
     }
 
+#ifdef CONFIG_UBI_ZPL_ENV_VOLUME
+    /* The environment does without UBIFS, it has a volume of its own */
+    err = _Ubi_EnvAttach();
+    if(err) {
+        ubifs_zpl_debug("Error: environment attach failed(Err:%d)", err);
+    }
+#endif
+
     /* Initialize UBIFS */
     ubifs_zpl_debug("Info: Initializing UBIFS...");
     err = ubifs_init();
@@ -194,6 +342,12 @@ static void _Ubi_Task(void *pxParam)
         vTaskSuspend(NULL);
     }
 
+#if((ENABLE_UBIFS_ZPL_TEST == 1) && (ENABLE_FASTMAP_TEST == 1))
+    if(bUbiFsInited) {
+        UBI_ZPL_FastmapTest();
+    }
+#endif /* #if((ENABLE_UBIFS_ZPL_TEST == 1) && (ENABLE_FASTMAP_TEST == 1)) */
+
     if(bUbiFsInited) {
         ubifs_zpl_debug("Info: Mounting UBIFS...");
         err = uboot_ubifs_mount(VOLUME_NAME_DEFAULT);
@@ -208,231 +362,81 @@ static void _Ubi_Task(void *pxParam)
 
     bInitDone = bUbiPartMounted && bUbiFsInited && bUbiFsMounted;
 
+#if((ENABLE_UBIFS_ZPL_TEST == 1) && (ENABLE_GC_POLICY_TEST == 1))
+    if(bUbiFsMounted) {
+        UBI_ZPL_GcPolicyTest();
+    }
+#endif /* #if((ENABLE_UBIFS_ZPL_TEST == 1) && (ENABLE_GC_POLICY_TEST == 1)) */
+
+#if((ENABLE_UBIFS_ZPL_TEST == 1) && (ENABLE_ENV_TEST == 1))
+    UBI_ZPL_EnvTestInit();
+#endif /* #if((ENABLE_UBIFS_ZPL_TEST == 1) && (ENABLE_ENV_TEST == 1)) */
+
 #if((ENABLE_UBIFS_ZPL_TEST == 1) && (ENABLE_FS_TEST == 1))
     UBI_ZPL_FsTestInit();
 #endif /* #if((ENABLE_UBIFS_ZPL_TEST == 1) && (ENABLE_FS_TEST == 1)) */
 
     while(1) {
-        if(xQueueReceive(xQueueHandleUbi, &ubiZplReq, portMAX_DELAY)) {
-            switch(ubiZplReq.op) {
-            case UBI_ZPL_FILE_EXIST: {
-                if(bUbiFsMounted == false) {
-                    err = uboot_ubifs_mount(VOLUME_NAME_DEFAULT);
-                    if(!err) {
-                        bUbiFsMounted = true;
-                    } else {
-                        ubifs_zpl_debug("Error: UBIFS mount failed(Err:%d)", err);
-                        bUbiFsMounted = false;
-                    }
-                }
-                if((bUbiFsMounted != 0) && (ubiZplReq.param1 != NULL) &&
-                   (ubiZplReq.param2 != NULL)){
-                    opCnt++;
-                    /* File system operation */
-                    *((int *)ubiZplReq.param2) = ubifs_exists((char *)ubiZplReq.param1);
-                    sts = true;
-                } else {
-                    sts = false;
-                }
-                if(ubiZplReq.cb != NULL) {
-                    ubiZplReq.cb(sts);
-                }
-                break;
-            }
-            case UBI_ZPL_FILE_WRITE: {
-                if(bUbiFsMounted == false) {
-                    err = uboot_ubifs_mount(VOLUME_NAME_DEFAULT);
-                    if(!err) {
-                        bUbiFsMounted = true;
-                    } else {
-                        ubifs_zpl_debug("Error: UBIFS mount failed(Err:%d)", err);
-                        bUbiFsMounted = false;
-                    }
-                }
-                if(bUbiFsMounted) {
-                    opCnt++;
-                    /* File system operation */
-                    err = ubifs_write((char *)ubiZplReq.param1,     // filename
-                                    (void *)ubiZplReq.param2,       // buf
-                                    (loff_t)(ubiZplReq.param4),     // offset
-                                    (loff_t)(ubiZplReq.param5),     // size
-                                    (loff_t *)(&temp64)             // actual written bytes
-                                    );
-                    if(!err) {
-                        sts = true;
-                        *((uint32_t *)(ubiZplReq.param3)) = (uint32_t)temp64;
-                    } else {
-                        ubifs_zpl_debug("Error: ubifs_write() fail (Err:%d)", err);
-                        sts = false;
-                    }
-                } else {
-                    sts = false;
-                }
-                if(ubiZplReq.cb != NULL) {
-                    ubiZplReq.cb(sts);
-                }
-                break;
-            }
-            case UBI_ZPL_FILE_READ: {
-                if(bUbiFsMounted == false) {
-                    err = uboot_ubifs_mount(VOLUME_NAME_DEFAULT);
-                    if(!err) {
-                        bUbiFsMounted = true;
-                    } else {
-                        ubifs_zpl_debug("Error: UBIFS mount failed(Err:%d)", err);
-                        bUbiFsMounted = false;
-                    }
-                }
-                if(bUbiFsMounted) {
-                    opCnt++;
-                    /* File system operation */
-                    err = ubifs_read((char *)ubiZplReq.param1,     // filename
-                                   (void *)ubiZplReq.param2,       // buf
-                                   (loff_t)(ubiZplReq.param4),     // offset
-                                   (loff_t)(ubiZplReq.param5),     // size
-                                   (loff_t *)(&temp64)             // actual bytes read
-                                   );
-                    if(!err) {
-                        sts = true;
-                        *((uint32_t *)(ubiZplReq.param3)) = (uint32_t)temp64;
-                    } else {
-                        ubifs_zpl_debug("Error: ubifs_read() fail(Err:%d)", err);
-                        sts = false;
-                    }
-                } else {
-                    sts = false;
-                }
-                if(ubiZplReq.cb != NULL) {
-                    ubiZplReq.cb(sts);
-                }
-                break;
-            }
-            case UBI_ZPL_FILE_GET_SIZE: {
-                if(bUbiFsMounted == false) {
-                    err = uboot_ubifs_mount(VOLUME_NAME_DEFAULT);
-                    if(!err) {
-                        bUbiFsMounted = true;
-                    } else {
-                        ubifs_zpl_debug("Error: UBIFS mount failed(Err:%d)", err);
-                        bUbiFsMounted = false;
-                    }
-                }
-                if(bUbiFsMounted) {
-                    opCnt++;
-                    /* File system operation */
-                    err = ubifs_size((char *)ubiZplReq.param1,    // filename
-                                   (loff_t *)(&temp64)            // size
-                                   );
-                    if(!err) {
-                        sts = true;
-                        *((uint32_t *)(ubiZplReq.param2)) = (uint32_t)temp64;
-                    } else {
-                        ubifs_zpl_debug("Error: ubifs_size() fail(Err:%d)", err);
-                        sts = false;
-                    }
-                } else {
-                    sts = false;
-                }
-                if(ubiZplReq.cb != NULL) {
-                    ubiZplReq.cb(sts);
-                }
-                break;
-            }
-            case UBI_ZPL_FILE_REMOVE: {
-                if(bUbiFsMounted == false) {
-                    err = uboot_ubifs_mount(VOLUME_NAME_DEFAULT);
-                    if(!err) {
-                        bUbiFsMounted = true;
-                    } else {
-                        ubifs_zpl_debug("Error: UBIFS mount failed(Err:%d)", err);
-                        bUbiFsMounted = false;
-                    }
-                }
-                if(bUbiFsMounted) {
-                    opCnt++;
-                    /* File system operation */
-                    err = ubifs_unlink((char *)ubiZplReq.param1);
-                    if(!err) {
-                        sts = true;
-                    } else {
-                        ubifs_zpl_debug("Error: ubifs_unlink() fail (Err:%d)", err);
-                        sts = false;
-                    }
-                } else {
-                    sts = false;
-                }
-                if(ubiZplReq.cb != NULL) {
-                    ubiZplReq.cb(sts);
-                }
-                break;
-            }
-            case UBI_ZPL_DIR_MAKE: {
-                if(bUbiFsMounted == false) {
-                    err = uboot_ubifs_mount(VOLUME_NAME_DEFAULT);
-                    if(!err) {
-                        bUbiFsMounted = true;
-                    } else {
-                        ubifs_zpl_debug("Error: UBIFS mount failed(Err:%d)", err);
-                        bUbiFsMounted = false;
-                    }
-                }
-                if(bUbiFsMounted) {
-                    opCnt++;
-                    /* File system operation */
-                    err = ubifs_mkdir((char *)ubiZplReq.param1);
-                    if(!err) {
-                        sts = true;
-                    } else {
-                        ubifs_zpl_debug("Error: ubifs_mkdir() fail(Err:%d)", err);
-                        sts = false;
-                    }
-                } else {
-                    sts = false;
-                }
-                if(ubiZplReq.cb != NULL) {
-                    ubiZplReq.cb(sts);
-                }
-                break;
-            }
-            case UBI_ZPL_DIR_REMOVE: {
-                if(bUbiFsMounted == false) {
-                    err = uboot_ubifs_mount(VOLUME_NAME_DEFAULT);
-                    if(!err) {
-                        bUbiFsMounted = true;
-                    } else {
-                        ubifs_zpl_debug("Error: UBIFS mount failed(Err:%d)", err);
-                        bUbiFsMounted = false;
-                    }
-                }
-                if(bUbiFsMounted) {
-                    opCnt++;
-                    /* File system operation */
-                    err = ubifs_rmdir((char *)ubiZplReq.param1);
-                    if(!err) {
-                        sts = true;
-                    } else {
-                        ubifs_zpl_debug("Error: ubifs_rmdir() fail(Err:%d)", err);
-                        sts = false;
-                    }
+        if(xQueueReceive(xQueueHandleUbi, &ubiZplReq, _Ubi_IdleTicks())) {
+            if(_Ubi_UbiOnly(ubiZplReq.op)) {
+                /* UBIFS plays no part, it is neither mounted nor counted */
+                err = _Ubi_Execute(&ubiZplReq);
+                _Ubi_Complete(&ubiZplReq, err);
+            } else {
+#ifdef CONFIG_UBIFS_BG_GC_LEBS
+                bGcPending = true;
+#endif
+                err = _Ubi_Mount();
+                if(err) {
+                    _Ubi_Complete(&ubiZplReq, err);
+                } else if((ubiZplReq.op == UBI_ZPL_FILE_WRITE) ||
+                          (ubiZplReq.op == UBI_ZPL_FILE_APPEND)) {
+                    opCnt += _Ubi_WriteMerged(&ubiZplReq);
                 } else {
-                    sts = false;
+                    opCnt += (ubiZplReq.op == UBI_ZPL_BATCH) ? ubiZplReq.param4 : 1;
+                    err = _Ubi_Execute(&ubiZplReq);
+                    _Ubi_Complete(&ubiZplReq, err);
                 }
-                if(ubiZplReq.cb != NULL) {
-                    ubiZplReq.cb(sts);
-                }
-                break;
             }
-            default: {
-                break;
+#ifdef CONFIG_MTD_UBI_ERASED_RESERVE
+        } else if(!_Ubi_RaPending() && (ubi_background_work(0) > 0)) {
+            /* Nothing queued, erased a freed PEB */
+#endif
+#ifdef CONFIG_UBIFS_BG_GC_LEBS
+        } else if(!_Ubi_RaPending() && _Ubi_Gc()) {
+            /* Nothing queued, garbage collected (part of) a dirty LEB */
+#endif
+#ifdef CONFIG_MTD_UBI_SCRUB_BITFLIPS
+        } else if(!_Ubi_RaPending() && _Ubi_Scrub()) {
+            /* Nothing queued, read a few pages for bitflips */
+#endif
+        } else {
+            /* Nothing queued, prefetch for a sequential reader */
+            if(_Ubi_RaFill()) {
+                opCnt++;
             }
+        }
+
+#ifdef CONFIG_MTD_UBI_ERASED_RESERVE
+        /* Keep the erased PEB reserve up even while requests keep coming */
+        if(bUbiPartMounted) {
+            (void)ubi_background_work(1);
+        }
+#endif
+
+        /* Write back cached data that has been dirty for too long */
+        if(bUbiFsMounted && (ubifs_next_writeback() == 0)) {
+            err = ubifs_sync_expired();
+            if(err) {
+                ubifs_zpl_debug("Error: ubifs_sync_expired() fail(Err:%d)", err);
             }
+        }
 
-            if(opCnt > OP_THRES) {
-                opCnt = 0;
-                if(bUbiFsMounted) {
-                    uboot_ubifs_umount();
-                    bUbiFsMounted = false;
-                }
+        if(opCnt > OP_THRES) {
+            opCnt = 0;
+            if(bUbiFsMounted) {
+                uboot_ubifs_umount();
+                bUbiFsMounted = false;
             }
         }
     }
@@ -440,149 +444,2468 @@ static void _Ubi_Task(void *pxParam)
     vTaskDelete(NULL);
 }
 
-UBI_ZPL_RET_T UBI_ZPL_FileWrite(char * filename, void *buf, uint32_t offset, uint32_t size, uint32_t *actwritten, ubi_zpl_cb_fcn cb)
+//*****************************************************************************
+//!
+//! \brief Mount the default volume if it was unmounted by the gatekeeper.
+//!
+//! \return \c 0 if mounted, negative errno otherwise
+//!
+//*****************************************************************************
+static int _Ubi_Mount(void)
 {
-    UBI_ZPL_RET_T retval = UBI_ZPL_NOERROR;
-    ubi_zpl_req_t req;
+    int err;
 
-    if(bInitDone != true) {
-        return UBI_ZPL_NOT_INITED;
+    if(bUbiFsMounted) {
+        return 0;
     }
 
-    if((filename == NULL) || (buf == NULL) || (actwritten == NULL)) {
-        retval = UBI_ZPL_INVALID_ARG;
+    err = uboot_ubifs_mount(VOLUME_NAME_DEFAULT);
+    if(!err) {
+        bUbiFsMounted = true;
     } else {
-        req.op = UBI_ZPL_FILE_WRITE;
-        req.param1 = (void *)filename;
-        req.param2 = buf;
-        req.param4 = offset;
-        req.param5 = size;
-        req.param3 = (void *)actwritten;
-        req.cb = cb;
+        ubifs_zpl_debug("Error: UBIFS mount failed(Err:%d)", err);
+        bUbiFsMounted = false;
+    }
+
+    return err;
+}
+
+//*****************************************************************************
+//!
+//! \brief Tell a request that needs UBI only, not UBIFS.
+//!
+//! The environment is a UBI volume of its own, and the wear statistics come
+//! from the UBI wear-leveling table. These requests are run without mounting
+//! UBIFS and do not count towards its periodic remount.
+//!
+//! \param  op      request operation
+//!
+//! \return \c true if the request does not need UBIFS
+//!
+//*****************************************************************************
+static bool _Ubi_UbiOnly(ubi_zpl_ops_t op)
+{
+    return (op == UBI_ZPL_ENV_GET) || (op == UBI_ZPL_ENV_SET) ||
+           (op == UBI_ZPL_ENV_SAVE) || (op == UBI_ZPL_ENV_LOAD) ||
+           (op == UBI_ZPL_WEAR_STATS);
+}
+
+//*****************************************************************************
+//!
+//! \brief Run one request on the file system.
+//!
+//! Executed only in the context of the gatekeeper task, with the volume
+//! mounted, except for the requests _Ubi_UbiOnly() tells.
+//!
+//! \param  req     request taken from the transaction queue
+//!
+//! \return \c 0 on success, negative errno otherwise
+//!
+//*****************************************************************************
+static int _Ubi_Execute(ubi_zpl_req_t * req)
+{
+    int err = 0;
+    loff_t temp64;
+    ubi_zpl_consumer_t * consumer;
 
-        /* Send Request to Queue without Blocking*/
-        if(pdTRUE != xQueueSend(xQueueHandleUbi, &req, (TickType_t)0)) {
-            retval = UBI_ZPL_QUEUE_FULL;
+    switch(req->op) {
+    case UBI_ZPL_FILE_EXIST: {
+        if((req->param1 == NULL) || (req->param2 == NULL)) {
+            err = -EINVAL;
+            break;
+        }
+        /* File system operation */
+        *((int *)req->param2) = ubifs_exists((char *)req->param1);
+        break;
+    }
+    case UBI_ZPL_FILE_WRITE: {
+        _Ubi_RaInvalidate((char *)req->param1);
+        /* File system operation */
+        err = ubifs_write((char *)req->param1,      // filename
+                        (void *)req->param2,        // buf
+                        (loff_t)(req->param4),      // offset
+                        (loff_t)(req->param5),      // size
+                        (loff_t *)(&temp64)         // actual written bytes
+                        );
+        if(!err) {
+            *((uint32_t *)(req->param3)) = (uint32_t)temp64;
+        } else {
+            ubifs_zpl_debug("Error: ubifs_write() fail (Err:%d)", err);
+        }
+        break;
+    }
+    case UBI_ZPL_FILE_APPEND: {
+        _Ubi_RaInvalidate((char *)req->param1);
+        /* File system operation */
+        err = ubifs_append((char *)req->param1,     // filename
+                        (void *)req->param2,        // buf
+                        (loff_t)(req->param5),      // size
+                        (loff_t *)(&temp64)         // actual written bytes
+                        );
+        if(!err) {
+            *((uint32_t *)(req->param3)) = (uint32_t)temp64;
+        } else {
+            ubifs_zpl_debug("Error: ubifs_append() fail (Err:%d)", err);
+        }
+        break;
+    }
+    case UBI_ZPL_FILE_READ: {
+        /* File system operation, through the read-ahead buffers */
+        err = _Ubi_Read((char *)req->param1,        // filename
+                       (void *)req->param2,         // buf
+                       req->param4,                 // offset
+                       req->param5,                 // size
+                       (uint32_t *)(req->param3)    // actual bytes read
+                       );
+        if(err) {
+            ubifs_zpl_debug("Error: ubifs_read() fail(Err:%d)", err);
+        }
+        break;
+    }
+    case UBI_ZPL_FILE_READ_STREAM: {
+        /* File system operation, straight to the consumer */
+        consumer = (ubi_zpl_consumer_t *)req->param2;
+        err = ubifs_read_stream((char *)req->param1, // filename
+                        (loff_t)(req->param4),      // offset
+                        (loff_t)(req->param5),      // size
+                        consumer->consume,          // called with each piece
+                        consumer->priv,
+                        (loff_t *)(&temp64)         // actual bytes read
+                        );
+        *((uint32_t *)(req->param3)) = (uint32_t)temp64;
+        if(err) {
+            ubifs_zpl_debug("Error: ubifs_read_stream() fail(Err:%d)", err);
+        }
+        break;
+    }
+    case UBI_ZPL_FILE_GET_SIZE: {
+        /* File system operation */
+        err = ubifs_size((char *)req->param1,      // filename
+                       (loff_t *)(&temp64)          // size
+                       );
+        if(!err) {
+            *((uint32_t *)(req->param2)) = (uint32_t)temp64;
+        } else {
+            ubifs_zpl_debug("Error: ubifs_size() fail(Err:%d)", err);
+        }
+        break;
+    }
+    case UBI_ZPL_FILE_REMOVE: {
+        _Ubi_RaInvalidate((char *)req->param1);
+        /* File system operation */
+        err = ubifs_unlink((char *)req->param1);
+        if(err) {
+            ubifs_zpl_debug("Error: ubifs_unlink() fail (Err:%d)", err);
+        }
+        break;
+    }
+    case UBI_ZPL_FILE_TRUNCATE: {
+        _Ubi_RaInvalidate((char *)req->param1);
+        /* File system operation */
+        err = ubifs_truncate((char *)req->param1,   // filename
+                        (loff_t)(req->param5)       // new size
+                        );
+        if(err) {
+            ubifs_zpl_debug("Error: ubifs_truncate() fail (Err:%d)", err);
+        }
+        break;
+    }
+    case UBI_ZPL_FILE_PUNCH_HOLE: {
+        _Ubi_RaInvalidate((char *)req->param1);
+        /* File system operation */
+        err = ubifs_punch_hole((char *)req->param1, // filename
+                        (loff_t)(req->param4),      // offset
+                        (loff_t)(req->param5)       // size
+                        );
+        if(err) {
+            ubifs_zpl_debug("Error: ubifs_punch_hole() fail (Err:%d)", err);
+        }
+        break;
+    }
+    case UBI_ZPL_FILE_RENAME: {
+        _Ubi_RaInvalidate((char *)req->param1);
+        _Ubi_RaInvalidate((char *)req->param2);
+        /* File system operation */
+        err = ubifs_rename((char *)req->param1,     // old name
+                        (char *)req->param2         // new name
+                        );
+        if(err) {
+            ubifs_zpl_debug("Error: ubifs_rename() fail (Err:%d)", err);
+        }
+        break;
+    }
+    case UBI_ZPL_DIR_MAKE: {
+        /* File system operation */
+        err = ubifs_mkdir((char *)req->param1);
+        if(err) {
+            ubifs_zpl_debug("Error: ubifs_mkdir() fail(Err:%d)", err);
+        }
+        break;
+    }
+    case UBI_ZPL_DIR_REMOVE: {
+        /* File system operation */
+        err = ubifs_rmdir((char *)req->param1);
+        if(err) {
+            ubifs_zpl_debug("Error: ubifs_rmdir() fail(Err:%d)", err);
+        }
+        break;
+    }
+    case UBI_ZPL_BATCH: {
+        err = _Ubi_ExecuteBatch((UBI_ZPL_BATCH_ENTRY_T *)req->param1,
+                                req->param4);
+        break;
+    }
+    case UBI_ZPL_FLUSH: {
+        /* File system operation */
+        err = ubifs_sync();
+        if(err) {
+            ubifs_zpl_debug("Error: ubifs_sync() fail(Err:%d)", err);
+        }
+        break;
+    }
+    case UBI_ZPL_FILE_SYNC: {
+        /* File system operation */
+        err = ubifs_fsync((char *)req->param1);
+        if(err) {
+            ubifs_zpl_debug("Error: ubifs_fsync() fail(Err:%d)", err);
+        }
+        break;
+    }
+    case UBI_ZPL_WEAR_STATS: {
+        err = _Ubi_WearStats((UBI_ZPL_WEAR_STATS_T *)req->param1);
+        break;
+    }
+    case UBI_ZPL_STREAM_BEGIN: {
+        _Ubi_RaInvalidate((char *)req->param1);
+        /* File system operation */
+        err = ubifs_stream_begin((char *)req->param1);
+        if(err) {
+            ubifs_zpl_debug("Error: ubifs_stream_begin() fail(Err:%d)", err);
+        }
+        break;
+    }
+    case UBI_ZPL_STREAM_WRITE: {
+        /* File system operation */
+        err = ubifs_stream_write((char *)req->param1,   // filename
+                        (void *)req->param2,            // buf
+                        (loff_t)(req->param5)           // size
+                        );
+        if(err) {
+            ubifs_zpl_debug("Error: ubifs_stream_write() fail(Err:%d)", err);
+        }
+        break;
+    }
+    case UBI_ZPL_STREAM_FINISH: {
+        _Ubi_RaInvalidate((char *)req->param1);
+        /* File system operation */
+        err = ubifs_stream_finish((char *)req->param1);
+        if(err) {
+            ubifs_zpl_debug("Error: ubifs_stream_finish() fail(Err:%d)", err);
+        }
+        break;
+    }
+    case UBI_ZPL_STREAM_ABORT: {
+        _Ubi_RaInvalidate((char *)req->param1);
+        /* File system operation */
+        err = ubifs_stream_abort((char *)req->param1);
+        if(err) {
+            ubifs_zpl_debug("Error: ubifs_stream_abort() fail(Err:%d)", err);
+        }
+        break;
+    }
+    case UBI_ZPL_SET_HOT: {
+#ifdef CONFIG_UBIFS_HOT_JHEAD
+        /* File system operation */
+        err = ubifs_set_hot((char *)req->param1, (int)req->param4);
+        if(err) {
+            ubifs_zpl_debug("Error: ubifs_set_hot() fail(Err:%d)", err);
+        }
+#else
+        err = -EOPNOTSUPP;
+#endif /* CONFIG_UBIFS_HOT_JHEAD */
+        break;
+    }
+    case UBI_ZPL_ENV_GET: {
+#ifdef CONFIG_UBI_ZPL_ENV_VOLUME
+        /* Served from RAM, a missing key is not worth a message */
+        err = _Ubi_EnvGet((char *)req->param1,     // key
+                        req->param4,                // key length
+                        (char *)req->param2,        // value buffer
+                        req->param5                 // buffer size
+                        );
+#else
+        err = -EOPNOTSUPP;
+#endif /* CONFIG_UBI_ZPL_ENV_VOLUME */
+        break;
+    }
+    case UBI_ZPL_ENV_SET: {
+#ifdef CONFIG_UBI_ZPL_ENV_VOLUME
+        err = _Ubi_EnvSet((char *)req->param1,     // key
+                        req->param4,                // key length
+                        (char *)req->param2,        // value
+                        req->param5                 // value length
+                        );
+        if(err) {
+            ubifs_zpl_debug("Error: environment set fail(Err:%d)", err);
+        }
+#else
+        err = -EOPNOTSUPP;
+#endif /* CONFIG_UBI_ZPL_ENV_VOLUME */
+        break;
+    }
+    case UBI_ZPL_ENV_SAVE: {
+#ifdef CONFIG_UBI_ZPL_ENV_VOLUME
+        err = _Ubi_EnvSave();
+        if(err) {
+            ubifs_zpl_debug("Error: environment save fail(Err:%d)", err);
+        }
+#else
+        err = -EOPNOTSUPP;
+#endif /* CONFIG_UBI_ZPL_ENV_VOLUME */
+        break;
+    }
+    case UBI_ZPL_ENV_LOAD: {
+#ifdef CONFIG_UBI_ZPL_ENV_VOLUME
+        err = _Ubi_EnvLoad();
+        if(err) {
+            ubifs_zpl_debug("Error: environment load fail(Err:%d)", err);
         }
+#else
+        err = -EOPNOTSUPP;
+#endif /* CONFIG_UBI_ZPL_ENV_VOLUME */
+        break;
+    }
+    default: {
+        err = -EINVAL;
+        break;
+    }
     }
 
-    return(retval);
+    return err;
 }
 
-UBI_ZPL_RET_T UBI_ZPL_FileRead(char * filename, void *buf, uint32_t offset, uint32_t size, uint32_t *actread, ubi_zpl_cb_fcn cb)
+//*****************************************************************************
+//!
+//! \brief Collect the erase counter spread and wear-leveling counters.
+//!
+//! Runs in the gatekeeper, as it walks the UBI wear-leveling table that the
+//! gatekeeper's background work changes. UBIFS is not mounted for it.
+//!
+//! \param  stats   filled in with the statistics
+//!
+//! \return \c 0 on success, negative errno otherwise
+//!
+//*****************************************************************************
+static int _Ubi_WearStats(UBI_ZPL_WEAR_STATS_T * stats)
 {
-    UBI_ZPL_RET_T retval = UBI_ZPL_NOERROR;
-    ubi_zpl_req_t req;
+    struct ubi_wear_stats st;
+    unsigned int hist[UBI_ZPL_EC_HIST_BUCKETS];
+    uint32_t idx;
+    int err;
 
-    if(bInitDone != true) {
-        return UBI_ZPL_NOT_INITED;
+    err = ubi_wear_stats(&st, hist, UBI_ZPL_EC_HIST_BUCKETS);
+    if(err) {
+        ubifs_zpl_debug("Error: ubi_wear_stats() fail(Err:%d)", err);
+        return err;
     }
 
-    if((filename == NULL) || (buf == NULL) || (actread == NULL)) {
-        retval = UBI_ZPL_INVALID_ARG;
-    } else {
-        req.op = UBI_ZPL_FILE_READ;
-        req.param1 = (void *)filename;
-        req.param2 = buf;
-        req.param4 = offset;
-        req.param5 = size;
-        req.param3 = (void *)actread;
-        req.cb = cb;
-
-        /* Send Request to Queue without Blocking*/
-        if(pdTRUE != xQueueSend(xQueueHandleUbi, &req, (TickType_t)0)) {
-            retval = UBI_ZPL_QUEUE_FULL;
-        }
+    stats->minEc = st.min_ec;
+    stats->meanEc = st.mean_ec;
+    stats->maxEc = st.max_ec;
+    stats->bucketEc = st.bucket_ec;
+    for(idx = 0; idx < UBI_ZPL_EC_HIST_BUCKETS; idx++) {
+        stats->ecHist[idx] = hist[idx];
     }
+    stats->wlMoves = st.moves;
+    stats->scrubMoves = st.scrubs;
+    stats->wlBytes = st.copied_bytes;
+    stats->wlWorkMs = st.work_ms;
 
-    return(retval);
+    return 0;
 }
 
-
-UBI_ZPL_RET_T UBI_ZPL_FileGetSize(const char * filename, uint32_t *size, ubi_zpl_cb_fcn cb)
+//*****************************************************************************
+//!
+//! \brief Run every operation of a batch under a single volume open.
+//!
+//! \param  ops     array of operations, results are written back in place
+//! \param  nOps    number of entries in ops
+//!
+//! \return \c 0 if all operations succeeded, otherwise the errno of the
+//!         first one that failed
+//!
+//*****************************************************************************
+static int _Ubi_ExecuteBatch(UBI_ZPL_BATCH_ENTRY_T * ops, uint32_t nOps)
 {
-    UBI_ZPL_RET_T retval = UBI_ZPL_NOERROR;
-    ubi_zpl_req_t req = {0};
+    static const ubi_zpl_ops_t batchOpMap[N_UBI_ZPL_BATCH_OP] = {
+        UBI_ZPL_FILE_EXIST,
+        UBI_ZPL_FILE_WRITE,
+        UBI_ZPL_FILE_READ,
+        UBI_ZPL_FILE_GET_SIZE,
+        UBI_ZPL_FILE_REMOVE,
+        UBI_ZPL_DIR_MAKE,
+        UBI_ZPL_DIR_REMOVE,
+        UBI_ZPL_FILE_APPEND,
+    };
+    ubi_zpl_req_t req;
+    uint32_t idx;
+    int exist;
+    int err;
+    int retval = 0;
 
-    if(bInitDone != true) {
-        return UBI_ZPL_NOT_INITED;
+    err = ubifs_hold_volume();
+    if(err) {
+        ubifs_zpl_debug("Error: ubifs_hold_volume() fail(Err:%d)", err);
+        return err;
     }
 
-    if(filename == NULL) {
-        retval = UBI_ZPL_INVALID_ARG;
-    } else {
-        req.op = UBI_ZPL_FILE_GET_SIZE;
-        req.param1 = (void *)filename;
-        req.param2 = (void *)size;
-        req.cb = cb;
-
-        /* Send Request to Queue without Blocking*/
-        if(pdTRUE != xQueueSend(xQueueHandleUbi, &req, (TickType_t)0)) {
-            retval = UBI_ZPL_QUEUE_FULL;
+    for(idx = 0; idx < nOps; idx++) {
+        memset(&req, 0, sizeof(req));
+        ops[idx].actual = 0;
+        if(ops[idx].op >= N_UBI_ZPL_BATCH_OP) {
+            ops[idx].err = -EINVAL;
+        } else if(ops[idx].op == UBI_ZPL_BATCH_FILE_EXIST) {
+            req.op = UBI_ZPL_FILE_EXIST;
+            req.param1 = (void *)ops[idx].name;
+            req.param2 = (void *)&exist;
+            ops[idx].err = _Ubi_Execute(&req);
+            ops[idx].actual = (ops[idx].err == 0) ? (uint32_t)exist : 0;
+        } else {
+            req.op = batchOpMap[ops[idx].op];
+            req.param1 = (void *)ops[idx].name;
+            req.param2 = ops[idx].buf;
+            req.param3 = (void *)&ops[idx].actual;
+            req.param4 = ops[idx].offset;
+            req.param5 = ops[idx].size;
+            if(req.op == UBI_ZPL_FILE_GET_SIZE) {
+                req.param2 = (void *)&ops[idx].actual;
+            }
+            ops[idx].err = _Ubi_Execute(&req);
+        }
+        if((retval == 0) && (ops[idx].err != 0)) {
+            retval = ops[idx].err;
         }
     }
 
-    return(retval);
+    ubifs_release_volume();
+
+    return retval;
 }
 
-UBI_ZPL_RET_T UBI_ZPL_FileExist(
-        const char * filename,
-        int * bExist,
-        ubi_zpl_cb_fcn cb)
+//*****************************************************************************
+//!
+//! \brief Check the entries of a batch as the single operation APIs do.
+//!
+//! \param  ops     array of operations
+//! \param  nOps    number of entries in ops
+//!
+//! \return \c true if every entry has a known operation, a name, and a
+//!         buffer where the operation needs one
+//!
+//*****************************************************************************
+static bool _Ubi_BatchValid(const UBI_ZPL_BATCH_ENTRY_T * ops, uint32_t nOps)
 {
-    UBI_ZPL_RET_T retval = UBI_ZPL_NOERROR;
-    ubi_zpl_req_t req = {0};
+    uint32_t idx;
 
-    if(bInitDone != true) {
-        return UBI_ZPL_NOT_INITED;
+    if((ops == NULL) || (nOps == 0)) {
+        return false;
     }
 
-    if((filename == NULL) || (bExist == NULL)) {
-        retval = UBI_ZPL_INVALID_ARG;
-    } else {
-        req.op = UBI_ZPL_FILE_EXIST;
-        req.param1 = (void *)filename;
-        req.param2 = (void *)bExist;
-        req.cb = cb;
-
-        /* Send Request to Queue without Blocking*/
-        if(pdTRUE != xQueueSend(xQueueHandleUbi, &req, (TickType_t)0)) {
-            retval = UBI_ZPL_QUEUE_FULL;
+    for(idx = 0; idx < nOps; idx++) {
+        if((ops[idx].op >= N_UBI_ZPL_BATCH_OP) || (ops[idx].name == NULL)) {
+            return false;
+        }
+        if(((ops[idx].op == UBI_ZPL_BATCH_FILE_WRITE) ||
+            (ops[idx].op == UBI_ZPL_BATCH_FILE_READ) ||
+            (ops[idx].op == UBI_ZPL_BATCH_FILE_APPEND)) && (ops[idx].buf == NULL)) {
+            return false;
         }
     }
 
-    return(retval);
+    return true;
 }
 
-UBI_ZPL_RET_T UBI_ZPL_RmFile(
+//*****************************************************************************
+//!
+//! \brief Execute a write or append, merged with the ones queued behind it.
+//!
+//! Writes to the same file whose ranges touch or overlap the range collected
+//! so far are taken off the head of the queue and copied into one buffer in
+//! arrival order, so later data wins where ranges overlap. Appends to the
+//! same file are simply concatenated, giving one inode update for the run.
+//! Only the head of the queue is ever taken, so any other request (e.g. a
+//! read of the same file) ends the merge and keeps its place in the order.
+//! The queue is first peeked without blocking, so a lone write never waits.
+//! Only once a mergeable request was found does the gatekeeper wait, at most
+//! CONFIG_UBI_ZPL_MERGE_WINDOW_MS for each further request and
+//! CONFIG_UBI_ZPL_MERGE_MAX_LATENCY_MS in total.
+//!
+//! \param  first   write or append request taken from the queue
+//!
+//! \return \c number of requests completed
+//!
+//*****************************************************************************
+static uint32_t _Ubi_WriteMerged(const ubi_zpl_req_t * first)
+{
+    ubi_zpl_req_t next;
+    ubi_zpl_req_t merged;
+    TickType_t start;
+    TickType_t elapsed;
+    TickType_t wait;
+    bool append = (first->op == UBI_ZPL_FILE_APPEND);
+    uint32_t lo;
+    uint32_t hi;
+    uint32_t nReq = 1;
+    uint32_t actwritten;
+    uint32_t idx;
+    int err;
+
+    xMergeReq[0] = *first;
+    if(append) {
+        /* Appends are laid out back to back from the start of the buffer */
+        xMergeReq[0].param4 = 0;
+    }
+    lo = xMergeReq[0].param4;
+    hi = lo + first->param5;
+    start = xTaskGetTickCount();
+
+    while((nReq < CONFIG_UBI_ZPL_MERGE_MAX_REQS) &&
+          (first->param5 <= CONFIG_UBI_ZPL_MERGE_MAX_BYTES)) {
+        elapsed = xTaskGetTickCount() - start;
+        if(elapsed >= pdMS_TO_TICKS(CONFIG_UBI_ZPL_MERGE_MAX_LATENCY_MS)) {
+            break;
+        }
+        wait = pdMS_TO_TICKS(CONFIG_UBI_ZPL_MERGE_MAX_LATENCY_MS) - elapsed;
+        if(wait > pdMS_TO_TICKS(CONFIG_UBI_ZPL_MERGE_WINDOW_MS)) {
+            wait = pdMS_TO_TICKS(CONFIG_UBI_ZPL_MERGE_WINDOW_MS);
+        }
+        if(nReq == 1) {
+            /* Nothing to merge with yet, do not delay the first write */
+            wait = 0;
+        }
+        if(pdTRUE != xQueuePeek(xQueueHandleUbi, &next, wait)) {
+            break;
+        }
+        if((next.op != first->op) ||
+           (strcmp((char *)next.param1, (char *)first->param1) != 0)) {
+            break;
+        }
+        if(append) {
+            if((hi + next.param5) > CONFIG_UBI_ZPL_MERGE_MAX_BYTES) {
+                break;
+            }
+            next.param4 = hi;
+        } else if((next.param4 > hi) || ((next.param4 + next.param5) < lo) ||
+                  ((max_t(uint32_t, hi, next.param4 + next.param5) -
+                    min_t(uint32_t, lo, next.param4)) > CONFIG_UBI_ZPL_MERGE_MAX_BYTES)) {
+            break;
+        }
+        (void)xQueueReceive(xQueueHandleUbi, &xMergeReq[nReq], (TickType_t)0);
+        xMergeReq[nReq].param4 = next.param4;
+        lo = min_t(uint32_t, lo, next.param4);
+        hi = max_t(uint32_t, hi, next.param4 + next.param5);
+        nReq++;
+    }
+
+    if(nReq == 1) {
+        err = _Ubi_Execute(&xMergeReq[0]);
+        _Ubi_Complete(&xMergeReq[0], err);
+        return 1;
+    }
+
+    for(idx = 0; idx < nReq; idx++) {
+        memcpy(&ucMergeBuf[xMergeReq[idx].param4 - lo],
+               xMergeReq[idx].param2, xMergeReq[idx].param5);
+    }
+
+    merged = xMergeReq[0];
+    merged.param2 = (void *)ucMergeBuf;
+    merged.param3 = (void *)&actwritten;
+    merged.param4 = lo;
+    merged.param5 = hi - lo;
+    err = _Ubi_Execute(&merged);
+
+    for(idx = 0; idx < nReq; idx++) {
+        if(!err) {
+            *((uint32_t *)(xMergeReq[idx].param3)) = xMergeReq[idx].param5;
+        }
+        _Ubi_Complete(&xMergeReq[idx], err);
+    }
+
+    return nReq;
+}
+
+//*****************************************************************************
+//!
+//! \brief Report the result of a request back to its originator.
+//!
+//! Synchronous callers get the errno and a direct-to-task notification,
+//! asynchronous callers get their callback invoked with a pass/fail status.
+//!
+//! \param  req     completed request
+//! \param  err     0 or negative errno returned by _Ubi_Execute()
+//!
+//! \return \c void
+//!
+//*****************************************************************************
+static void _Ubi_Complete(const ubi_zpl_req_t * req, int err)
+{
+    if(req->notify != NULL) {
+        *(req->result) = err;
+        xTaskNotifyGive(req->notify);
+    } else if(req->cb != NULL) {
+        req->cb(err == 0);
+    }
+}
+
+//*****************************************************************************
+//!
+//! \brief Read from a file, using the read-ahead buffer of the file.
+//!
+//! A read that is entirely inside the buffered range is copied from there,
+//! anything else goes to flash. A read that starts where the previous read of
+//! the same file ended marks the file as read sequentially, and a prefetch is
+//! scheduled once less than half a window is left ahead of the reader. Any
+//! other read shrinks the window back to CONFIG_UBI_ZPL_RA_MIN_BYTES.
+//!
+//! \param  name    file name
+//! \param  buf     destination buffer
+//! \param  offset  file offset
+//! \param  size    number of bytes to read, 0 reads up to the end of file
+//! \param  actread number of bytes read, set on success only
+//!
+//! \return \c 0 on success, negative errno otherwise
+//!
+//*****************************************************************************
+static int _Ubi_Read(const char * name, void * buf, uint32_t offset, uint32_t size, uint32_t * actread)
+{
+    ubi_zpl_ra_t * ra;
+    uint32_t bufEnd;
+    uint32_t ahead;
+    loff_t temp64;
+    int err = 0;
+
+    ra = (size != 0) ? _Ubi_RaFind(name, true) : NULL;
+    if(ra == NULL) {
+        xReadAheadStats.misses++;
+        err = ubifs_read((char *)name, buf, (loff_t)offset, (loff_t)size, &temp64);
+        if(!err) {
+            *actread = (uint32_t)temp64;
+        }
+        return err;
+    }
+
+    ra->lastUse = ++ulReadAheadUse;
+    bufEnd = ra->bufOff + ra->bufLen;
+    if((ra->bufLen != 0) && (offset >= ra->bufOff) && (offset <= bufEnd) &&
+       (((offset + size) <= bufEnd) || ra->eof)) {
+        xReadAheadStats.hits++;
+        temp64 = min_t(uint32_t, size, bufEnd - offset);
+        memcpy(buf, &ra->buf[offset - ra->bufOff], (size_t)temp64);
+    } else {
+        xReadAheadStats.misses++;
+        err = ubifs_read(ra->name, buf, (loff_t)offset, (loff_t)size, &temp64);
+    }
+    if(err) {
+        return err;
+    }
+    *actread = (uint32_t)temp64;
+
+    if(offset != ra->nextOff) {
+        ra->window = CONFIG_UBI_ZPL_RA_MIN_BYTES;
+        ra->pending = false;
+    } else {
+        ahead = ((ra->nextOff + (uint32_t)temp64) < bufEnd) ?
+                (bufEnd - ra->nextOff - (uint32_t)temp64) : 0;
+        ra->pending = !ra->eof && (ahead < (ra->window / 2));
+    }
+    ra->nextOff = offset + (uint32_t)temp64;
+
+    return 0;
+}
+
+//*****************************************************************************
+//!
+//! \brief Look up the read-ahead stream of a file.
+//!
+//! \param  name    file name
+//! \param  create  take over the least recently used stream if not found
+//!
+//! \return \c stream, or NULL if not tracked
+//!
+//*****************************************************************************
+static ubi_zpl_ra_t * _Ubi_RaFind(const char * name, bool create)
+{
+    ubi_zpl_ra_t * lru = &xReadAhead[0];
+    uint32_t idx;
+
+    for(idx = 0; idx < CONFIG_UBI_ZPL_RA_STREAMS; idx++) {
+        if(strcmp(xReadAhead[idx].name, name) == 0) {
+            return &xReadAhead[idx];
+        }
+        if(xReadAhead[idx].lastUse < lru->lastUse) {
+            lru = &xReadAhead[idx];
+        }
+    }
+
+    if(!create || (strlen(name) >= CONFIG_UBI_ZPL_RA_NAME_LEN)) {
+        return NULL;
+    }
+
+    strcpy(lru->name, name);
+    lru->nextOff = UBI_ZPL_RA_NO_OFFSET;
+    lru->bufOff = 0;
+    lru->bufLen = 0;
+    lru->window = CONFIG_UBI_ZPL_RA_MIN_BYTES;
+    lru->eof = false;
+    lru->pending = false;
+
+    return lru;
+}
+
+//*****************************************************************************
+//!
+//! \brief Drop the read-ahead data of a file that is about to change.
+//!
+//! \param  name    file name
+//!
+//! \return \c void
+//!
+//*****************************************************************************
+static void _Ubi_RaInvalidate(const char * name)
+{
+    ubi_zpl_ra_t * ra = _Ubi_RaFind(name, false);
+
+    if(ra != NULL) {
+        ra->bufLen = 0;
+        ra->eof = false;
+        ra->pending = false;
+    }
+}
+
+//*****************************************************************************
+//!
+//! \brief Check whether a prefetch is waiting for the gatekeeper to go idle.
+//!
+//! \return \c true if at least one stream has a prefetch pending
+//!
+//*****************************************************************************
+static bool _Ubi_RaPending(void)
+{
+    uint32_t idx;
+
+    for(idx = 0; idx < CONFIG_UBI_ZPL_RA_STREAMS; idx++) {
+        if(xReadAhead[idx].pending) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//*****************************************************************************
+//!
+//! \brief Run one pending prefetch.
+//!
+//! The bytes still ahead of the reader are moved to the start of the buffer
+//! and the rest of the window is read from flash behind them. The window then
+//! doubles, up to CONFIG_UBI_ZPL_RA_MAX_BYTES.
+//!
+//! \return \c true if it read from the volume, false if there was nothing to
+//!         read or the volume could not be mounted
+//!
+//*****************************************************************************
+static bool _Ubi_RaFill(void)
+{
+    ubi_zpl_ra_t * ra = NULL;
+    uint32_t keep = 0;
+    uint32_t idx;
+    loff_t temp64;
+    bool bRead = false;
+    int err;
+
+    for(idx = 0; idx < CONFIG_UBI_ZPL_RA_STREAMS; idx++) {
+        if(xReadAhead[idx].pending &&
+           ((ra == NULL) || (xReadAhead[idx].lastUse > ra->lastUse))) {
+            ra = &xReadAhead[idx];
+        }
+    }
+    if(ra == NULL) {
+        return false;
+    }
+    ra->pending = false;
+
+    if((ra->nextOff >= ra->bufOff) && (ra->nextOff < (ra->bufOff + ra->bufLen))) {
+        keep = ra->bufOff + ra->bufLen - ra->nextOff;
+        memmove(ra->buf, &ra->buf[ra->nextOff - ra->bufOff], keep);
+    }
+    ra->bufOff = ra->nextOff;
+    ra->bufLen = keep;
+    if(keep >= ra->window) {
+        return false;
+    }
+
+    err = _Ubi_Mount();
+    if(!err) {
+        err = ubifs_read(ra->name, &ra->buf[keep], (loff_t)(ra->bufOff + keep),
+                         (loff_t)(ra->window - keep), &temp64);
+        bRead = true;
+    }
+    if(err) {
+        ubifs_zpl_debug("Error: read-ahead of %s fail(Err:%d)", ra->name, err);
+        ra->bufLen = 0;
+        ra->eof = false;
+        return bRead;
+    }
+
+    ra->bufLen += (uint32_t)temp64;
+    ra->eof = ((uint32_t)temp64 < (ra->window - keep));
+    xReadAheadStats.prefetches++;
+    xReadAheadStats.prefetchBytes += (uint32_t)temp64;
+    ra->window = min_t(uint32_t, ra->window * 2, CONFIG_UBI_ZPL_RA_MAX_BYTES);
+    return true;
+}
+
+//*****************************************************************************
+//!
+//! \brief How long the gatekeeper may block waiting for a request.
+//!
+//! Zero while a read-ahead, a UBI erasure or garbage collection is pending,
+//! otherwise until the page cache has data to write back or the next scrub
+//! step is due, or forever if neither is.
+//!
+//! \return \c ticks to wait
+//!
+//*****************************************************************************
+static TickType_t _Ubi_IdleTicks(void)
+{
+    long ms;
+
+    if(_Ubi_RaPending()) {
+        return (TickType_t)0;
+    }
+#ifdef CONFIG_MTD_UBI_ERASED_RESERVE
+    if(bUbiPartMounted && ubi_background_pending()) {
+        return (TickType_t)0;
+    }
+#endif
+#ifdef CONFIG_UBIFS_BG_GC_LEBS
+    if(bUbiFsMounted && bGcPending) {
+        return (TickType_t)0;
+    }
+#endif
+
+    ms = bUbiFsMounted ? ubifs_next_writeback() : -1;
+#ifdef CONFIG_MTD_UBI_SCRUB_BITFLIPS
+    if(bUbiPartMounted) {
+        TickType_t ticks = _Ubi_ScrubTicks();
+
+        if((ms < 0) || (ticks < pdMS_TO_TICKS(ms))) {
+            return ticks;
+        }
+    }
+#endif
+    if(ms < 0) {
+        return portMAX_DELAY;
+    }
+
+    return pdMS_TO_TICKS(ms);
+}
+
+#ifdef CONFIG_UBIFS_BG_GC_LEBS
+//*****************************************************************************
+//!
+//! \brief Tell the background GC to stop because a request is waiting.
+//!
+//! \return \c non-zero if the request queue is not empty
+//!
+//*****************************************************************************
+static int _Ubi_GcYield(void)
+{
+    return (uxQueueMessagesWaiting(xQueueHandleUbi) != 0);
+}
+
+//*****************************************************************************
+//!
+//! \brief Garbage collect one dirty LEB while the queue is empty.
+//!
+//! GC stops before the next node move as soon as a request is queued, and
+//! goes on where it left off once the gatekeeper is idle again. It stops for
+//! good when CONFIG_UBIFS_BG_GC_LEBS LEBs are empty or no LEB is worth
+//! collecting, until the next request.
+//!
+//! \return \c true if GC did some work
+//!
+//*****************************************************************************
+static bool _Ubi_Gc(void)
+{
+    int ret;
+
+    if(!bUbiFsMounted || !bGcPending) {
+        return false;
+    }
+
+    ret = ubifs_bg_gc(_Ubi_GcYield);
+    if(ret == -EINTR) {
+        return true;
+    }
+    if(ret < 0) {
+        ubifs_zpl_debug("Error: ubifs_bg_gc() fail(Err:%d)", ret);
+    }
+    if(ret <= 0) {
+        bGcPending = false;
+    }
+
+    return (ret > 0);
+}
+#endif /* CONFIG_UBIFS_BG_GC_LEBS */
+
+#ifdef CONFIG_MTD_UBI_SCRUB_BITFLIPS
+//*****************************************************************************
+//!
+//! \brief How long until the next scrub step is due.
+//!
+//! \return \c ticks to wait, zero if due
+//!
+//*****************************************************************************
+static TickType_t _Ubi_ScrubTicks(void)
+{
+    TickType_t interval = pdMS_TO_TICKS(ulScrubWaitMs);
+    TickType_t elapsed = xTaskGetTickCount() - xScrubLastTick;
+
+    return (elapsed >= interval) ? (TickType_t)0 : (interval - elapsed);
+}
+
+//*****************************************************************************
+//!
+//! \brief Read the next few pages of the UBI scrub walk if a step is due.
+//!
+//! At most CONFIG_UBI_ZPL_SCRUB_PAGES pages are read every
+//! CONFIG_UBI_ZPL_SCRUB_INTERVAL_MS, and only while the request queue is
+//! empty, so the scrubber never holds up a request for more than one step.
+//! The step that completes a walk over the partition is followed by a pause
+//! of CONFIG_UBI_ZPL_SCRUB_PASS_PAUSE_MS instead.
+//!
+//! \return \c true if pages were read
+//!
+//*****************************************************************************
+static bool _Ubi_Scrub(void)
+{
+    unsigned int pages, bitflips, moves, passes;
+    int ret;
+
+    if(!bUbiPartMounted || (_Ubi_ScrubTicks() != 0)) {
+        return false;
+    }
+    xScrubLastTick = xTaskGetTickCount();
+
+    ret = ubi_scrub_step(CONFIG_UBI_ZPL_SCRUB_PAGES);
+    if(ret < 0) {
+        ubifs_zpl_debug("Error: ubi_scrub_step() fail(Err:%d)", ret);
+    }
+
+    ulScrubWaitMs = CONFIG_UBI_ZPL_SCRUB_INTERVAL_MS;
+    if((ubi_scrub_stats(&pages, &bitflips, &moves, &passes) == 0) &&
+       (passes != ulScrubPasses)) {
+        ulScrubPasses = passes;
+        ulScrubWaitMs = CONFIG_UBI_ZPL_SCRUB_PASS_PAUSE_MS;
+    }
+
+    return (ret > 0);
+}
+#endif /* CONFIG_MTD_UBI_SCRUB_BITFLIPS */
+
+#ifdef CONFIG_UBI_ZPL_ENV_VOLUME
+//*****************************************************************************
+//!
+//! \brief Open the environment volume and index its log.
+//!
+//! The volume is made, one LEB large, if the image has none. A record torn by
+//! a power failure during a save, and anything after it, is dropped by
+//! rewriting the log. A log holding more than CONFIG_UBI_ZPL_ENV_MAX_KEYS
+//! keys, e.g. written by a firmware with a higher limit, is left as it is and
+//! the environment stays closed.
+//!
+//! \return \c 0 on success, -ENOSPC for too many keys, negative errno
+//!         otherwise
+//!
+//*****************************************************************************
+static int _Ubi_EnvAttach(void)
+{
+    struct ubi_volume_desc * desc;
+    struct ubi_volume_info vi;
+    struct ubi_device_info di;
+    struct ubi_mkvol_req mkvol;
+    struct ubi_device * ubi;
+    ubi_zpl_env_rec_t * rec;
+    uint32_t offs;
+    uint32_t idx;
+    uint32_t dropped;
+    int err;
+
+    desc = ubi_open_volume_nm(UBI_ZPL_ENV_UBI_NUM, CONFIG_UBI_ZPL_ENV_VOLUME, UBI_READWRITE);
+    if(PTR_ERR(desc) == -ENODEV) {
+        ubi = ubi_get_device(UBI_ZPL_ENV_UBI_NUM);
+        if(ubi == NULL) {
+            return -ENODEV;
+        }
+        ubifs_zpl_debug("Info: Creating UBI volume %s...", CONFIG_UBI_ZPL_ENV_VOLUME);
+        memset(&mkvol, 0, sizeof(mkvol));
+        mkvol.vol_id = UBI_VOL_NUM_AUTO;
+        mkvol.alignment = 1;
+        mkvol.bytes = ubi->leb_size;
+        mkvol.vol_type = UBI_DYNAMIC_VOLUME;
+        mkvol.name_len = strlen(CONFIG_UBI_ZPL_ENV_VOLUME);
+        strcpy(mkvol.name, CONFIG_UBI_ZPL_ENV_VOLUME);
+        err = ubi_create_volume(ubi, &mkvol);
+        ubi_put_device(ubi);
+        if(err) {
+            return err;
+        }
+        desc = ubi_open_volume_nm(UBI_ZPL_ENV_UBI_NUM, CONFIG_UBI_ZPL_ENV_VOLUME, UBI_READWRITE);
+    }
+    if(IS_ERR(desc)) {
+        return PTR_ERR(desc);
+    }
+
+    ubi_get_volume_info(desc, &vi);
+    err = ubi_get_device_info(vi.ubi_num, &di);
+    if(!err && ((CONFIG_UBI_ZPL_ENV_LOG_BYTES > vi.usable_leb_size) ||
+                (CONFIG_UBI_ZPL_ENV_LOG_BYTES % di.min_io_size))) {
+        err = -EINVAL;
+    }
+    if(!err) {
+        /* Reads back erased if the LEB is not mapped */
+        err = ubi_leb_read(desc, 0, (char *)ucEnvLog, 0, CONFIG_UBI_ZPL_ENV_LOG_BYTES, 0);
+    }
+    if(err) {
+        ubi_close_volume(desc);
+        return err;
+    }
+    ulEnvMinIo = di.min_io_size;
+
+    memset(ulEnvIndex, 0xFF, sizeof(ulEnvIndex));
+    ulEnvKeys = 0;
+    dropped = 0;
+    offs = 0;
+    while((rec = _Ubi_EnvRecord(&offs, CONFIG_UBI_ZPL_ENV_LOG_BYTES)) != NULL) {
+        idx = _Ubi_EnvSlot((char *)(rec + 1), rec->klen);
+        if(ulEnvIndex[idx] != UBI_ZPL_ENV_FREE) {
+            ulEnvIndex[idx] = offs;
+        } else if(ulEnvKeys < CONFIG_UBI_ZPL_ENV_MAX_KEYS) {
+            ulEnvIndex[idx] = offs;
+            ulEnvKeys++;
+        } else {
+            /* Keep going, the records that follow are still valid */
+            dropped++;
+        }
+        offs += UBI_ZPL_ENV_REC_SZ(rec->klen, rec->vlen);
+    }
+    if(dropped) {
+        /* Never compact or append to a log holding keys not in the index */
+        ubifs_zpl_debug("Error: environment holds more than %u keys, %u records not indexed",
+                CONFIG_UBI_ZPL_ENV_MAX_KEYS, dropped);
+        ubi_close_volume(desc);
+        return -ENOSPC;
+    }
+    pxEnvVol = desc;
+    ulEnvSaved = ALIGN(offs, ulEnvMinIo);
+    ulEnvEnd = ulEnvSaved;
+
+    /* Nothing may follow the last good record but erased flash */
+    for(; offs < CONFIG_UBI_ZPL_ENV_LOG_BYTES; offs++) {
+        if(ucEnvLog[offs] != 0xFF) {
+            ubifs_zpl_debug("Info: Dropping environment records from offset %u", offs);
+            err = _Ubi_EnvCompact();
+            if(err) {
+                ubifs_zpl_debug("Error: environment rewrite fail(Err:%d)", err);
+            }
+            break;
+        }
+    }
+
+    ubifs_zpl_debug("Info: Environment holds %u keys in %u bytes", ulEnvKeys, ulEnvEnd);
+    return 0;
+}
+
+//*****************************************************************************
+//!
+//! \brief Get the environment record at an offset of the log.
+//!
+//! A save pads the last write unit with erased bytes, these are skipped.
+//!
+//! \param  offs    log offset, moved past any padding
+//! \param  end     log offset not to read beyond
+//!
+//! \return \c the record, NULL at the end of the log or at a bad record
+//!
+//*****************************************************************************
+static ubi_zpl_env_rec_t * _Ubi_EnvRecord(uint32_t * offs, uint32_t end)
+{
+    ubi_zpl_env_rec_t * rec;
+
+    while(true) {
+        if((*offs + sizeof(ubi_zpl_env_rec_t)) > end) {
+            return NULL;
+        }
+        rec = (ubi_zpl_env_rec_t *)&ucEnvLog[*offs];
+        if(rec->magic != UBI_ZPL_ENV_ERASED) {
+            break;
+        }
+        if((*offs % ulEnvMinIo) == 0) {
+            /* An erased write unit, nothing was saved after it */
+            return NULL;
+        }
+        *offs = ALIGN(*offs, ulEnvMinIo);
+    }
+
+    if((rec->magic != UBI_ZPL_ENV_MAGIC) ||
+       (rec->klen == 0) || (rec->klen > CONFIG_UBI_ZPL_ENV_KEY_LEN) ||
+       (rec->vlen > CONFIG_UBI_ZPL_ENV_VAL_LEN) ||
+       ((*offs + UBI_ZPL_ENV_REC_SZ(rec->klen, rec->vlen)) > end) ||
+       (rec->crc != crc32(UBI_CRC32_INIT, &rec->klen, 4 + rec->klen + rec->vlen))) {
+        return NULL;
+    }
+
+    return rec;
+}
+
+//*****************************************************************************
+//!
+//! \brief Find the index slot of a key.
+//!
+//! Open addressing with linear probing, the index is at most half full.
+//!
+//! \param  key     key, not terminated
+//! \param  klen    key length
+//!
+//! \return \c the slot holding the key, else the free slot it would go to
+//!
+//*****************************************************************************
+static uint32_t _Ubi_EnvSlot(const char * key, uint32_t klen)
+{
+    const ubi_zpl_env_rec_t * rec;
+    uint32_t hash = 2166136261u;
+    uint32_t idx;
+
+    /* FNV-1a */
+    for(idx = 0; idx < klen; idx++) {
+        hash = (hash ^ (uint8_t)key[idx]) * 16777619u;
+    }
+
+    for(idx = hash % UBI_ZPL_ENV_SLOTS; ulEnvIndex[idx] != UBI_ZPL_ENV_FREE;
+        idx = (idx + 1) % UBI_ZPL_ENV_SLOTS) {
+        if(ulEnvIndex[idx] == UBI_ZPL_ENV_GONE) {
+            continue;
+        }
+        rec = (const ubi_zpl_env_rec_t *)&ucEnvLog[ulEnvIndex[idx]];
+        if((rec->klen == klen) && (memcmp(rec + 1, key, klen) == 0)) {
+            break;
+        }
+    }
+
+    return idx;
+}
+
+//*****************************************************************************
+//!
+//! \brief Drop outdated records from the log in RAM.
+//!
+//! The latest record of every key that is set is moved down in log order, so
+//! no record is overwritten before it has been moved. The log on flash no
+//! longer matches the one in RAM, the next save rewrites it.
+//!
+//! \return \c void
+//!
+//*****************************************************************************
+static void _Ubi_EnvPack(void)
+{
+    ubi_zpl_env_rec_t * rec;
+    uint32_t src;
+    uint32_t dst;
+    uint32_t len;
+    uint32_t idx;
+
+    /* Deleted keys keep their slot until the index is rebuilt */
+    for(idx = 0; idx < UBI_ZPL_ENV_SLOTS; idx++) {
+        if((ulEnvIndex[idx] != UBI_ZPL_ENV_FREE) &&
+           (((ubi_zpl_env_rec_t *)&ucEnvLog[ulEnvIndex[idx]])->vlen == 0)) {
+            ulEnvIndex[idx] = UBI_ZPL_ENV_GONE;
+        }
+    }
+
+    src = 0;
+    dst = 0;
+    while((rec = _Ubi_EnvRecord(&src, ulEnvEnd)) != NULL) {
+        len = UBI_ZPL_ENV_REC_SZ(rec->klen, rec->vlen);
+        idx = _Ubi_EnvSlot((char *)(rec + 1), rec->klen);
+        if(ulEnvIndex[idx] == src) {
+            memmove(&ucEnvLog[dst], rec, len);
+            ulEnvIndex[idx] = dst;
+            dst += len;
+        }
+        src += len;
+    }
+    memset(&ucEnvLog[dst], 0xFF, CONFIG_UBI_ZPL_ENV_LOG_BYTES - dst);
+
+    memset(ulEnvIndex, 0xFF, sizeof(ulEnvIndex));
+    ulEnvKeys = 0;
+    for(src = 0; src < dst; src += UBI_ZPL_ENV_REC_SZ(rec->klen, rec->vlen)) {
+        rec = (ubi_zpl_env_rec_t *)&ucEnvLog[src];
+        ulEnvIndex[_Ubi_EnvSlot((char *)(rec + 1), rec->klen)] = src;
+        ulEnvKeys++;
+    }
+
+    ulEnvSaved = 0;
+    ulEnvEnd = dst;
+    bEnvRewrite = true;
+}
+
+//*****************************************************************************
+//!
+//! \brief Drop outdated records from the log and replace it on flash.
+//!
+//! ubi_leb_change() swaps in the new log atomically, a power failure leaves
+//! the old one in place. Records not yet saved are saved along.
+//!
+//! \return \c 0 on success, negative errno otherwise
+//!
+//*****************************************************************************
+static int _Ubi_EnvCompact(void)
+{
+    uint32_t len;
+    int err;
+
+    _Ubi_EnvPack();
+
+    len = ALIGN(ulEnvEnd, ulEnvMinIo);
+    if(len == 0) {
+        err = ubi_leb_unmap(pxEnvVol, 0);
+    } else {
+        err = ubi_leb_change(pxEnvVol, 0, ucEnvLog, len);
+    }
+    if(err) {
+        return err;
+    }
+
+    ulEnvSaved = len;
+    ulEnvEnd = len;
+    bEnvRewrite = false;
+    return 0;
+}
+
+//*****************************************************************************
+//!
+//! \brief Copy the value of a key, see \ref subsect_ubi_zpl_env.
+//!
+//! \param  key     key, not terminated
+//! \param  klen    key length
+//! \param  buf     filled in with the value and a terminating NUL
+//! \param  bufsz   size of buf
+//!
+//! \return \c 0 on success, -ENOENT if the key is not set, negative errno
+//!         otherwise
+//!
+//*****************************************************************************
+static int _Ubi_EnvGet(const char * key, uint32_t klen, char * buf, uint32_t bufsz)
+{
+    const ubi_zpl_env_rec_t * rec;
+    uint32_t idx;
+
+    if(pxEnvVol == NULL) {
+        return -ENODEV;
+    }
+    if((klen == 0) || (klen > CONFIG_UBI_ZPL_ENV_KEY_LEN)) {
+        return -EINVAL;
+    }
+
+    idx = _Ubi_EnvSlot(key, klen);
+    if(ulEnvIndex[idx] == UBI_ZPL_ENV_FREE) {
+        return -ENOENT;
+    }
+    rec = (const ubi_zpl_env_rec_t *)&ucEnvLog[ulEnvIndex[idx]];
+    if(rec->vlen == 0) {
+        return -ENOENT;
+    }
+    if(rec->vlen >= bufsz) {
+        return -EOVERFLOW;
+    }
+
+    memcpy(buf, (const char *)(rec + 1) + klen, rec->vlen);
+    buf[rec->vlen] = '\0';
+    return 0;
+}
+
+//*****************************************************************************
+//!
+//! \brief Set a key in RAM, see \ref subsect_ubi_zpl_env.
+//!
+//! A record is added to the log only if the value changes. When it does not
+//! fit, the log is packed in RAM and rewritten by the next save, so this
+//! never writes to flash.
+//!
+//! \param  key     key, not terminated
+//! \param  klen    key length
+//! \param  val     value, not terminated
+//! \param  vlen    value length, 0 to delete the key
+//!
+//! \return \c 0 on success, negative errno otherwise
+//!
+//*****************************************************************************
+static int _Ubi_EnvSet(const char * key, uint32_t klen, const char * val, uint32_t vlen)
+{
+    ubi_zpl_env_rec_t * rec;
+    uint32_t idx;
+    uint32_t len;
+
+    if(pxEnvVol == NULL) {
+        return -ENODEV;
+    }
+    if((klen == 0) || (klen > CONFIG_UBI_ZPL_ENV_KEY_LEN) ||
+       (vlen > CONFIG_UBI_ZPL_ENV_VAL_LEN) || ((val == NULL) && (vlen != 0))) {
+        return -EINVAL;
+    }
+
+    idx = _Ubi_EnvSlot(key, klen);
+    if(ulEnvIndex[idx] == UBI_ZPL_ENV_FREE) {
+        if(vlen == 0) {
+            return 0;
+        }
+    } else {
+        rec = (ubi_zpl_env_rec_t *)&ucEnvLog[ulEnvIndex[idx]];
+        if((rec->vlen == vlen) && (memcmp((char *)(rec + 1) + klen, val, vlen) == 0)) {
+            return 0;
+        }
+    }
+
+    len = UBI_ZPL_ENV_REC_SZ(klen, vlen);
+    if(((ulEnvEnd + len) > CONFIG_UBI_ZPL_ENV_LOG_BYTES) ||
+       ((ulEnvIndex[idx] == UBI_ZPL_ENV_FREE) && (ulEnvKeys >= CONFIG_UBI_ZPL_ENV_MAX_KEYS))) {
+        _Ubi_EnvPack();
+        idx = _Ubi_EnvSlot(key, klen);
+        if(((ulEnvEnd + len) > CONFIG_UBI_ZPL_ENV_LOG_BYTES) ||
+           ((ulEnvIndex[idx] == UBI_ZPL_ENV_FREE) && (ulEnvKeys >= CONFIG_UBI_ZPL_ENV_MAX_KEYS))) {
+            return -ENOSPC;
+        }
+    }
+
+    rec = (ubi_zpl_env_rec_t *)&ucEnvLog[ulEnvEnd];
+    rec->magic = UBI_ZPL_ENV_MAGIC;
+    rec->klen = klen;
+    rec->vlen = vlen;
+    memcpy(rec + 1, key, klen);
+    memcpy((char *)(rec + 1) + klen, val, vlen);
+    rec->crc = crc32(UBI_CRC32_INIT, &rec->klen, 4 + klen + vlen);
+
+    if(ulEnvIndex[idx] == UBI_ZPL_ENV_FREE) {
+        ulEnvKeys++;
+    }
+    ulEnvIndex[idx] = ulEnvEnd;
+    ulEnvEnd += len;
+    return 0;
+}
+
+//*****************************************************************************
+//!
+//! \brief Write the records set since the last save, see
+//! \ref subsect_ubi_zpl_env.
+//!
+//! They are appended with one ubi_leb_write() of whole write units, the last
+//! one padded with erased bytes.
+//!
+//! \return \c 0 on success, negative errno otherwise
+//!
+//*****************************************************************************
+static int _Ubi_EnvSave(void)
+{
+    uint32_t len;
+    int err;
+
+    if(pxEnvVol == NULL) {
+        return -ENODEV;
+    }
+    if(bEnvRewrite) {
+        return _Ubi_EnvCompact();
+    }
+    if(ulEnvEnd == ulEnvSaved) {
+        return 0;
+    }
+
+    len = ALIGN(ulEnvEnd, ulEnvMinIo);
+    err = ubi_leb_write(pxEnvVol, 0, &ucEnvLog[ulEnvSaved], ulEnvSaved, len - ulEnvSaved);
+    if(err) {
+        /* The write units concerned may hold anything now */
+        bEnvRewrite = true;
+        return err;
+    }
+
+    ulEnvSaved = len;
+    ulEnvEnd = len;
+    return 0;
+}
+
+//*****************************************************************************
+//!
+//! \brief Drop the changes not saved and read the environment back from
+//! flash, see \ref subsect_ubi_zpl_env.
+//!
+//! \return \c 0 on success, negative errno otherwise
+//!
+//*****************************************************************************
+static int _Ubi_EnvLoad(void)
+{
+    if(pxEnvVol != NULL) {
+        ubi_close_volume(pxEnvVol);
+        pxEnvVol = NULL;
+    }
+    bEnvRewrite = false;
+
+    return _Ubi_EnvAttach();
+}
+#endif /* CONFIG_UBI_ZPL_ENV_VOLUME */
+
+//*****************************************************************************
+//!
+//! \brief Queue an asynchronous request without blocking.
+//!
+//! \param  req     request to be copied into the transaction queue
+//!
+//! \return \c UBI_ZPL_NOERROR or UBI_ZPL_QUEUE_FULL
+//!
+//*****************************************************************************
+static UBI_ZPL_RET_T _Ubi_Submit(ubi_zpl_req_t * req)
+{
+    req->notify = NULL;
+    req->result = NULL;
+
+    /* Send Request to Queue without Blocking*/
+    if(pdTRUE != xQueueSend(xQueueHandleUbi, req, (TickType_t)0)) {
+        return UBI_ZPL_QUEUE_FULL;
+    }
+
+    return UBI_ZPL_NOERROR;
+}
+
+//*****************************************************************************
+//!
+//! \brief Queue a request and block the calling task until it is done.
+//!
+//! The gatekeeper signals completion with xTaskNotifyGive(), so the calling
+//! task must not use its own notification value for anything else while a
+//! synchronous call is in progress.
+//!
+//! \param  req     request to be copied into the transaction queue
+//!
+//! \return \c 0 on success, negative errno otherwise
+//!
+//*****************************************************************************
+static int _Ubi_SubmitSync(ubi_zpl_req_t * req)
+{
+    int result = -EIO;
+
+    if(bInitDone != true) {
+        return -ENODEV;
+    }
+
+    req->cb = NULL;
+    req->notify = xTaskGetCurrentTaskHandle();
+    req->result = &result;
+
+    if(req->notify == xTaskHandleUbiFs) {
+        /* The gatekeeper would wait for itself */
+        return -EDEADLK;
+    }
+
+    /* Drop a stale notification so the wait below is for this request */
+    (void)ulTaskNotifyTake(pdTRUE, (TickType_t)0);
+
+    if(pdTRUE != xQueueSend(xQueueHandleUbi, req, portMAX_DELAY)) {
+        return -EBUSY;
+    }
+    (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    return result;
+}
+
+UBI_ZPL_RET_T UBI_ZPL_FileWrite(char * filename, void *buf, uint32_t offset, uint32_t size, uint32_t *actwritten, ubi_zpl_cb_fcn cb)
+{
+    UBI_ZPL_RET_T retval = UBI_ZPL_NOERROR;
+    ubi_zpl_req_t req = {0};
+
+    if(bInitDone != true) {
+        return UBI_ZPL_NOT_INITED;
+    }
+
+    if((filename == NULL) || (buf == NULL) || (actwritten == NULL)) {
+        retval = UBI_ZPL_INVALID_ARG;
+    } else {
+        req.op = UBI_ZPL_FILE_WRITE;
+        req.param1 = (void *)filename;
+        req.param2 = buf;
+        req.param4 = offset;
+        req.param5 = size;
+        req.param3 = (void *)actwritten;
+        req.cb = cb;
+        retval = _Ubi_Submit(&req);
+    }
+
+    return(retval);
+}
+
+//*****************************************************************************
+//!
+//! \brief Append data at the end of a file.
+//!
+//! The gatekeeper writes the data at the current file size, so no size
+//! lookup and no offset alignment is needed. The file is created if it does
+//! not exist. Appends to the same file that are queued back to back are
+//! written together, with a single inode update.
+//!
+//! \return \c UBI_ZPL_RET_T
+//!
+//*****************************************************************************
+UBI_ZPL_RET_T UBI_ZPL_FileAppend(
+        char * filename,
+        void *buf,
+        uint32_t size,
+        uint32_t *actwritten,
+        ubi_zpl_cb_fcn cb)
+{
+    UBI_ZPL_RET_T retval = UBI_ZPL_NOERROR;
+    ubi_zpl_req_t req = {0};
+
+    if(bInitDone != true) {
+        return UBI_ZPL_NOT_INITED;
+    }
+
+    if((filename == NULL) || (buf == NULL) || (actwritten == NULL)) {
+        retval = UBI_ZPL_INVALID_ARG;
+    } else {
+        req.op = UBI_ZPL_FILE_APPEND;
+        req.param1 = (void *)filename;
+        req.param2 = buf;
+        req.param3 = (void *)actwritten;
+        req.param5 = size;
+        req.cb = cb;
+        retval = _Ubi_Submit(&req);
+    }
+
+    return(retval);
+}
+
+UBI_ZPL_RET_T UBI_ZPL_FileRead(char * filename, void *buf, uint32_t offset, uint32_t size, uint32_t *actread, ubi_zpl_cb_fcn cb)
+{
+    UBI_ZPL_RET_T retval = UBI_ZPL_NOERROR;
+    ubi_zpl_req_t req = {0};
+
+    if(bInitDone != true) {
+        return UBI_ZPL_NOT_INITED;
+    }
+
+    if((filename == NULL) || (buf == NULL) || (actread == NULL)) {
+        retval = UBI_ZPL_INVALID_ARG;
+    } else {
+        req.op = UBI_ZPL_FILE_READ;
+        req.param1 = (void *)filename;
+        req.param2 = buf;
+        req.param4 = offset;
+        req.param5 = size;
+        req.param3 = (void *)actread;
+        req.cb = cb;
+        retval = _Ubi_Submit(&req);
+    }
+
+    return(retval);
+}
+
+
+UBI_ZPL_RET_T UBI_ZPL_FileGetSize(const char * filename, uint32_t *size, ubi_zpl_cb_fcn cb)
+{
+    UBI_ZPL_RET_T retval = UBI_ZPL_NOERROR;
+    ubi_zpl_req_t req = {0};
+
+    if(bInitDone != true) {
+        return UBI_ZPL_NOT_INITED;
+    }
+
+    if(filename == NULL) {
+        retval = UBI_ZPL_INVALID_ARG;
+    } else {
+        req.op = UBI_ZPL_FILE_GET_SIZE;
+        req.param1 = (void *)filename;
+        req.param2 = (void *)size;
+        req.cb = cb;
+        retval = _Ubi_Submit(&req);
+    }
+
+    return(retval);
+}
+
+UBI_ZPL_RET_T UBI_ZPL_FileExist(
+        const char * filename,
+        int * bExist,
+        ubi_zpl_cb_fcn cb)
+{
+    UBI_ZPL_RET_T retval = UBI_ZPL_NOERROR;
+    ubi_zpl_req_t req = {0};
+
+    if(bInitDone != true) {
+        return UBI_ZPL_NOT_INITED;
+    }
+
+    if((filename == NULL) || (bExist == NULL)) {
+        retval = UBI_ZPL_INVALID_ARG;
+    } else {
+        req.op = UBI_ZPL_FILE_EXIST;
+        req.param1 = (void *)filename;
+        req.param2 = (void *)bExist;
+        req.cb = cb;
+        retval = _Ubi_Submit(&req);
+    }
+
+    return(retval);
+}
+
+UBI_ZPL_RET_T UBI_ZPL_RmFile(
+        const char * filename,
+        ubi_zpl_cb_fcn cb)
+{
+    UBI_ZPL_RET_T retval = UBI_ZPL_NOERROR;
+    ubi_zpl_req_t req = {0};
+
+    if(bInitDone != true) {
+        return UBI_ZPL_NOT_INITED;
+    }
+
+    if(filename == NULL) {
+        retval = UBI_ZPL_INVALID_ARG;
+    } else {
+        req.op = UBI_ZPL_FILE_REMOVE;
+        req.param1 = (void *)filename;
+        req.cb = cb;
+        retval = _Ubi_Submit(&req);
+    }
+
+    return(retval);
+}
+
+//*****************************************************************************
+//!
+//! \brief Shrink or grow a file, see \ref subsect_ubi_zpl_trunc.
+//!
+//*****************************************************************************
+UBI_ZPL_RET_T UBI_ZPL_FileTruncate(
+        const char * filename,
+        uint32_t size,
+        ubi_zpl_cb_fcn cb)
+{
+    UBI_ZPL_RET_T retval = UBI_ZPL_NOERROR;
+    ubi_zpl_req_t req = {0};
+
+    if(bInitDone != true) {
+        return UBI_ZPL_NOT_INITED;
+    }
+
+    if(filename == NULL) {
+        retval = UBI_ZPL_INVALID_ARG;
+    } else {
+        req.op = UBI_ZPL_FILE_TRUNCATE;
+        req.param1 = (void *)filename;
+        req.param5 = size;
+        req.cb = cb;
+        retval = _Ubi_Submit(&req);
+    }
+
+    return(retval);
+}
+
+//*****************************************************************************
+//!
+//! \brief Discard a byte range of a file, see \ref subsect_ubi_zpl_trunc.
+//!
+//*****************************************************************************
+UBI_ZPL_RET_T UBI_ZPL_FilePunchHole(
+        const char * filename,
+        uint32_t offset,
+        uint32_t size,
+        ubi_zpl_cb_fcn cb)
+{
+    UBI_ZPL_RET_T retval = UBI_ZPL_NOERROR;
+    ubi_zpl_req_t req = {0};
+
+    if(bInitDone != true) {
+        return UBI_ZPL_NOT_INITED;
+    }
+
+    if(filename == NULL) {
+        retval = UBI_ZPL_INVALID_ARG;
+    } else {
+        req.op = UBI_ZPL_FILE_PUNCH_HOLE;
+        req.param1 = (void *)filename;
+        req.param4 = offset;
+        req.param5 = size;
+        req.cb = cb;
+        retval = _Ubi_Submit(&req);
+    }
+
+    return(retval);
+}
+
+//*****************************************************************************
+//!
+//! \brief Rename a file, replacing any file of the new name, see
+//! \ref subsect_ubi_zpl_rename.
+//!
+//*****************************************************************************
+UBI_ZPL_RET_T UBI_ZPL_FileRename(
+        const char * oldname,
+        const char * newname,
+        ubi_zpl_cb_fcn cb)
+{
+    UBI_ZPL_RET_T retval = UBI_ZPL_NOERROR;
+    ubi_zpl_req_t req = {0};
+
+    if(bInitDone != true) {
+        return UBI_ZPL_NOT_INITED;
+    }
+
+    if((oldname == NULL) || (newname == NULL)) {
+        retval = UBI_ZPL_INVALID_ARG;
+    } else {
+        req.op = UBI_ZPL_FILE_RENAME;
+        req.param1 = (void *)oldname;
+        req.param2 = (void *)newname;
+        req.cb = cb;
+        retval = _Ubi_Submit(&req);
+    }
+
+    return(retval);
+}
+
+//*****************************************************************************
+//!
+//! \brief Get an environment variable, see \ref subsect_ubi_zpl_env.
+//!
+//! The value is stored NUL terminated, so valbuf must have room for one
+//! more byte than the value. The callback status is false if the key is not
+//! set.
+//!
+//*****************************************************************************
+UBI_ZPL_RET_T UBI_ZPL_EnvGet(
+        const char * key,
+        uint32_t keylen,
+        char * valbuf,
+        uint32_t bufsz,
+        ubi_zpl_cb_fcn cb)
+{
+    UBI_ZPL_RET_T retval = UBI_ZPL_NOERROR;
+    ubi_zpl_req_t req = {0};
+
+    if(bInitDone != true) {
+        return UBI_ZPL_NOT_INITED;
+    }
+
+    if((key == NULL) || (valbuf == NULL)) {
+        retval = UBI_ZPL_INVALID_ARG;
+    } else {
+        req.op = UBI_ZPL_ENV_GET;
+        req.param1 = (void *)key;
+        req.param2 = (void *)valbuf;
+        req.param4 = keylen;
+        req.param5 = bufsz;
+        req.cb = cb;
+        retval = _Ubi_Submit(&req);
+    }
+
+    return(retval);
+}
+
+//*****************************************************************************
+//!
+//! \brief Set an environment variable in RAM, see \ref subsect_ubi_zpl_env.
+//!
+//! An empty value deletes the variable.
+//!
+//*****************************************************************************
+UBI_ZPL_RET_T UBI_ZPL_EnvSet(
+        const char * key,
+        uint32_t keylen,
+        const char * val,
+        uint32_t vallen,
+        ubi_zpl_cb_fcn cb)
+{
+    UBI_ZPL_RET_T retval = UBI_ZPL_NOERROR;
+    ubi_zpl_req_t req = {0};
+
+    if(bInitDone != true) {
+        return UBI_ZPL_NOT_INITED;
+    }
+
+    if((key == NULL) || ((val == NULL) && (vallen != 0))) {
+        retval = UBI_ZPL_INVALID_ARG;
+    } else {
+        req.op = UBI_ZPL_ENV_SET;
+        req.param1 = (void *)key;
+        req.param2 = (void *)val;
+        req.param4 = keylen;
+        req.param5 = vallen;
+        req.cb = cb;
+        retval = _Ubi_Submit(&req);
+    }
+
+    return(retval);
+}
+
+//*****************************************************************************
+//!
+//! \brief Write the environment variables set since the last save to flash,
+//! see \ref subsect_ubi_zpl_env.
+//!
+//*****************************************************************************
+UBI_ZPL_RET_T UBI_ZPL_EnvSave(ubi_zpl_cb_fcn cb)
+{
+    ubi_zpl_req_t req = {0};
+
+    if(bInitDone != true) {
+        return UBI_ZPL_NOT_INITED;
+    }
+
+    req.op = UBI_ZPL_ENV_SAVE;
+    req.cb = cb;
+
+    return _Ubi_Submit(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Drop the environment variables set since the last save and read
+//! them back from flash, see \ref subsect_ubi_zpl_env.
+//!
+//*****************************************************************************
+UBI_ZPL_RET_T UBI_ZPL_EnvLoad(ubi_zpl_cb_fcn cb)
+{
+    ubi_zpl_req_t req = {0};
+
+    if(bInitDone != true) {
+        return UBI_ZPL_NOT_INITED;
+    }
+
+    req.op = UBI_ZPL_ENV_LOAD;
+    req.cb = cb;
+
+    return _Ubi_Submit(&req);
+}
+
+UBI_ZPL_RET_T UBI_ZPL_MkDir(
+        const char * dirname,
+        ubi_zpl_cb_fcn cb)
+{
+    UBI_ZPL_RET_T retval = UBI_ZPL_NOERROR;
+    ubi_zpl_req_t req = {0};
+
+    if(bInitDone != true) {
+        return UBI_ZPL_NOT_INITED;
+    }
+
+    if(dirname == NULL) {
+        retval = UBI_ZPL_INVALID_ARG;
+    } else {
+        req.op = UBI_ZPL_DIR_MAKE;
+        req.param1 = (void *)dirname;
+        req.cb = cb;
+        retval = _Ubi_Submit(&req);
+    }
+
+    return(retval);
+}
+
+UBI_ZPL_RET_T UBI_ZPL_RmDir(
+        const char * dirname,
+        ubi_zpl_cb_fcn cb)
+{
+    UBI_ZPL_RET_T retval = UBI_ZPL_NOERROR;
+    ubi_zpl_req_t req = {0};
+
+    if(bInitDone != true) {
+        return UBI_ZPL_NOT_INITED;
+    }
+
+    if(dirname == NULL) {
+        retval = UBI_ZPL_INVALID_ARG;
+    } else {
+        req.op = UBI_ZPL_DIR_REMOVE;
+        req.param1 = (void *)dirname;
+        req.cb = cb;
+        retval = _Ubi_Submit(&req);
+    }
+
+    return(retval);
+}
+
+//*****************************************************************************
+//!
+//! \brief Synchronous variant of UBI_ZPL_FileWrite().
+//!
+//! Blocks the calling task until the gatekeeper has written the data.
+//!
+//! \return \c 0 on success, negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_FileWriteSync(
+        char * filename,
+        void *buf,
+        uint32_t offset,
+        uint32_t size,
+        uint32_t *actwritten)
+{
+    ubi_zpl_req_t req = {0};
+
+    if((filename == NULL) || (buf == NULL) || (actwritten == NULL)) {
+        return -EINVAL;
+    }
+
+    req.op = UBI_ZPL_FILE_WRITE;
+    req.param1 = (void *)filename;
+    req.param2 = buf;
+    req.param3 = (void *)actwritten;
+    req.param4 = offset;
+    req.param5 = size;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Synchronous variant of UBI_ZPL_FileAppend().
+//!
+//! \return \c 0 on success, negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_FileAppendSync(
+        char * filename,
+        void *buf,
+        uint32_t size,
+        uint32_t *actwritten)
+{
+    ubi_zpl_req_t req = {0};
+
+    if((filename == NULL) || (buf == NULL) || (actwritten == NULL)) {
+        return -EINVAL;
+    }
+
+    req.op = UBI_ZPL_FILE_APPEND;
+    req.param1 = (void *)filename;
+    req.param2 = buf;
+    req.param3 = (void *)actwritten;
+    req.param5 = size;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Synchronous variant of UBI_ZPL_FileRead().
+//!
+//! \return \c 0 on success, negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_FileReadSync(
+        char * filename,
+        void *buf,
+        uint32_t offset,
+        uint32_t size,
+        uint32_t *actread)
+{
+    ubi_zpl_req_t req = {0};
+
+    if((filename == NULL) || (buf == NULL) || (actread == NULL)) {
+        return -EINVAL;
+    }
+
+    req.op = UBI_ZPL_FILE_READ;
+    req.param1 = (void *)filename;
+    req.param2 = buf;
+    req.param3 = (void *)actread;
+    req.param4 = offset;
+    req.param5 = size;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Pass a byte range of a file to a consumer, piece by piece.
+//!
+//! See \ref subsect_ubi_zpl_read_stream.
+//!
+//! \param  filename    absolute path of the file
+//! \param  offset      byte offset of the range
+//! \param  size        length of the range, 0 for up to the end of the file
+//! \param  consume     called in the gatekeeper with each piece
+//! \param  priv        passed to \a consume
+//! \param  actread     number of bytes consumed
+//!
+//! \return \c 0 on success, the error returned by \a consume if it stopped
+//!         the read, negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_FileReadStreamSync(
+        const char * filename,
+        uint32_t offset,
+        uint32_t size,
+        ubi_zpl_consume_fcn consume,
+        void * priv,
+        uint32_t *actread)
+{
+    ubi_zpl_req_t req = {0};
+    ubi_zpl_consumer_t consumer;
+
+    if((filename == NULL) || (consume == NULL) || (actread == NULL)) {
+        return -EINVAL;
+    }
+
+    consumer.consume = consume;
+    consumer.priv = priv;
+    req.op = UBI_ZPL_FILE_READ_STREAM;
+    req.param1 = (void *)filename;
+    req.param2 = (void *)&consumer;
+    req.param3 = (void *)actread;
+    req.param4 = offset;
+    req.param5 = size;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Synchronous variant of UBI_ZPL_FileGetSize().
+//!
+//! \return \c 0 on success, negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_FileGetSizeSync(
+        const char * filename,
+        uint32_t *size)
+{
+    ubi_zpl_req_t req = {0};
+
+    if((filename == NULL) || (size == NULL)) {
+        return -EINVAL;
+    }
+
+    req.op = UBI_ZPL_FILE_GET_SIZE;
+    req.param1 = (void *)filename;
+    req.param2 = (void *)size;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Synchronous variant of UBI_ZPL_FileExist().
+//!
+//! \return \c 0 on success (result in bExist), negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_FileExistSync(
+        const char * filename,
+        int * bExist)
+{
+    ubi_zpl_req_t req = {0};
+
+    if((filename == NULL) || (bExist == NULL)) {
+        return -EINVAL;
+    }
+
+    req.op = UBI_ZPL_FILE_EXIST;
+    req.param1 = (void *)filename;
+    req.param2 = (void *)bExist;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Synchronous variant of UBI_ZPL_RmFile().
+//!
+//! \return \c 0 on success, negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_RmFileSync(const char * filename)
+{
+    ubi_zpl_req_t req = {0};
+
+    if(filename == NULL) {
+        return -EINVAL;
+    }
+
+    req.op = UBI_ZPL_FILE_REMOVE;
+    req.param1 = (void *)filename;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Synchronous variant of UBI_ZPL_FileTruncate().
+//!
+//! \return \c 0 on success, negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_FileTruncateSync(const char * filename, uint32_t size)
+{
+    ubi_zpl_req_t req = {0};
+
+    if(filename == NULL) {
+        return -EINVAL;
+    }
+
+    req.op = UBI_ZPL_FILE_TRUNCATE;
+    req.param1 = (void *)filename;
+    req.param5 = size;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Synchronous variant of UBI_ZPL_FilePunchHole().
+//!
+//! \return \c 0 on success, negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_FilePunchHoleSync(
+        const char * filename,
+        uint32_t offset,
+        uint32_t size)
+{
+    ubi_zpl_req_t req = {0};
+
+    if(filename == NULL) {
+        return -EINVAL;
+    }
+
+    req.op = UBI_ZPL_FILE_PUNCH_HOLE;
+    req.param1 = (void *)filename;
+    req.param4 = offset;
+    req.param5 = size;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Synchronous variant of UBI_ZPL_FileRename().
+//!
+//! \return \c 0 on success, negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_FileRenameSync(const char * oldname, const char * newname)
+{
+    ubi_zpl_req_t req = {0};
+
+    if((oldname == NULL) || (newname == NULL)) {
+        return -EINVAL;
+    }
+
+    req.op = UBI_ZPL_FILE_RENAME;
+    req.param1 = (void *)oldname;
+    req.param2 = (void *)newname;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Synchronous variant of UBI_ZPL_EnvGet().
+//!
+//! \return \c 0 on success, -ENOENT if the key is not set, -EOVERFLOW if
+//!         the value does not fit, -EOPNOTSUPP without
+//!         CONFIG_UBI_ZPL_ENV_VOLUME, negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_EnvGetSync(
+        const char * key,
+        uint32_t keylen,
+        char * valbuf,
+        uint32_t bufsz)
+{
+    ubi_zpl_req_t req = {0};
+
+    if((key == NULL) || (valbuf == NULL)) {
+        return -EINVAL;
+    }
+
+    req.op = UBI_ZPL_ENV_GET;
+    req.param1 = (void *)key;
+    req.param2 = (void *)valbuf;
+    req.param4 = keylen;
+    req.param5 = bufsz;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Synchronous variant of UBI_ZPL_EnvSet().
+//!
+//! \return \c 0 on success, -ENOSPC if the log is full of current values,
+//!         -EOPNOTSUPP without CONFIG_UBI_ZPL_ENV_VOLUME, negative errno
+//!         otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_EnvSetSync(
+        const char * key,
+        uint32_t keylen,
+        const char * val,
+        uint32_t vallen)
+{
+    ubi_zpl_req_t req = {0};
+
+    if((key == NULL) || ((val == NULL) && (vallen != 0))) {
+        return -EINVAL;
+    }
+
+    req.op = UBI_ZPL_ENV_SET;
+    req.param1 = (void *)key;
+    req.param2 = (void *)val;
+    req.param4 = keylen;
+    req.param5 = vallen;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Synchronous variant of UBI_ZPL_EnvSave().
+//!
+//! \return \c 0 on success, -EOPNOTSUPP without CONFIG_UBI_ZPL_ENV_VOLUME,
+//!         negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_EnvSaveSync(void)
+{
+    ubi_zpl_req_t req = {0};
+
+    req.op = UBI_ZPL_ENV_SAVE;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Synchronous variant of UBI_ZPL_EnvLoad().
+//!
+//! \return \c 0 on success, -EOPNOTSUPP without CONFIG_UBI_ZPL_ENV_VOLUME,
+//!         negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_EnvLoadSync(void)
+{
+    ubi_zpl_req_t req = {0};
+
+    req.op = UBI_ZPL_ENV_LOAD;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Synchronous variant of UBI_ZPL_MkDir().
+//!
+//! \return \c 0 on success, negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_MkDirSync(const char * dirname)
+{
+    ubi_zpl_req_t req = {0};
+
+    if(dirname == NULL) {
+        return -EINVAL;
+    }
+
+    req.op = UBI_ZPL_DIR_MAKE;
+    req.param1 = (void *)dirname;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Synchronous variant of UBI_ZPL_RmDir().
+//!
+//! \return \c 0 on success, negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_RmDirSync(const char * dirname)
+{
+    ubi_zpl_req_t req = {0};
+
+    if(dirname == NULL) {
+        return -EINVAL;
+    }
+
+    req.op = UBI_ZPL_DIR_REMOVE;
+    req.param1 = (void *)dirname;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Start writing a file in chunks.
+//!
+//! See \ref subsect_ubi_zpl_stream. An existing file is replaced.
+//!
+//! \param  filename    absolute path of the file
+//!
+//! \return \c 0 on success, -EBUSY if another stream is open,
+//!         negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_FileStreamBeginSync(const char * filename)
+{
+    ubi_zpl_req_t req = {0};
+
+    if(filename == NULL) {
+        return -EINVAL;
+    }
+
+    req.op = UBI_ZPL_STREAM_BEGIN;
+    req.param1 = (void *)filename;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Write the next chunk of a file started with
+//!        UBI_ZPL_FileStreamBeginSync().
+//!
+//! \param  filename    absolute path of the streamed file
+//! \param  buf         data, only used until this returns
+//! \param  size        number of bytes, any size
+//!
+//! \return \c 0 on success, -EBADF if \a filename is not being streamed,
+//!         negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_FileStreamWriteSync(
         const char * filename,
-        ubi_zpl_cb_fcn cb)
+        const void * buf,
+        uint32_t size)
 {
-    UBI_ZPL_RET_T retval = UBI_ZPL_NOERROR;
     ubi_zpl_req_t req = {0};
 
-    if(bInitDone != true) {
-        return UBI_ZPL_NOT_INITED;
+    if((filename == NULL) || ((buf == NULL) && (size != 0))) {
+        return -EINVAL;
     }
 
+    req.op = UBI_ZPL_STREAM_WRITE;
+    req.param1 = (void *)filename;
+    req.param2 = (void *)buf;
+    req.param5 = size;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Complete a streamed file and commit it to flash.
+//!
+//! The stream is closed even if this fails.
+//!
+//! \param  filename    absolute path of the streamed file
+//!
+//! \return \c 0 on success, -EBADF if \a filename is not being streamed,
+//!         negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_FileStreamFinishSync(const char * filename)
+{
+    ubi_zpl_req_t req = {0};
+
     if(filename == NULL) {
-        retval = UBI_ZPL_INVALID_ARG;
-    } else {
-        req.op = UBI_ZPL_FILE_REMOVE;
-        req.param1 = (void *)filename;
-        req.cb = cb;
+        return -EINVAL;
+    }
 
-        /* Send Request to Queue without Blocking*/
-        if(pdTRUE != xQueueSend(xQueueHandleUbi, &req, (TickType_t)0)) {
-            retval = UBI_ZPL_QUEUE_FULL;
-        }
+    req.op = UBI_ZPL_STREAM_FINISH;
+    req.param1 = (void *)filename;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Drop a streamed file and everything written to it.
+//!
+//! \param  filename    absolute path of the streamed file
+//!
+//! \return \c 0 on success, -EBADF if \a filename is not being streamed,
+//!         negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_FileStreamAbortSync(const char * filename)
+{
+    ubi_zpl_req_t req = {0};
+
+    if(filename == NULL) {
+        return -EINVAL;
     }
 
-    return(retval);
+    req.op = UBI_ZPL_STREAM_ABORT;
+    req.param1 = (void *)filename;
+
+    return _Ubi_SubmitSync(&req);
 }
 
-UBI_ZPL_RET_T UBI_ZPL_MkDir(
-        const char * dirname,
+//*****************************************************************************
+//!
+//! \brief Mark a file or directory as holding often rewritten data.
+//!
+//! Data of hot files goes to a journal head of its own, see
+//! \ref subsect_ubi_zpl_hot.
+//!
+//! \param  path    absolute path of an existing file or directory
+//! \param  hot     non-zero to set the hint, zero to clear it
+//!
+//! \return \c 0 on success, -EOPNOTSUPP without CONFIG_UBIFS_HOT_JHEAD,
+//!         negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_SetHotSync(const char * path, int hot)
+{
+    ubi_zpl_req_t req = {0};
+
+    if(path == NULL) {
+        return -EINVAL;
+    }
+
+    req.op = UBI_ZPL_SET_HOT;
+    req.param1 = (void *)path;
+    req.param4 = hot ? 1 : 0;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Queue a batch of operations without blocking.
+//!
+//! The ops array must stay valid until the callback is invoked. The callback
+//! status is true only if every operation succeeded; per operation results
+//! are found in the err field of each entry.
+//!
+//! \param  ops     array of operations
+//! \param  nOps    number of entries in ops
+//! \param  cb      completion callback, may be NULL
+//!
+//! \return \c UBI_ZPL_RET_T
+//!
+//*****************************************************************************
+UBI_ZPL_RET_T UBI_ZPL_Batch(
+        UBI_ZPL_BATCH_ENTRY_T * ops,
+        uint32_t nOps,
         ubi_zpl_cb_fcn cb)
 {
     UBI_ZPL_RET_T retval = UBI_ZPL_NOERROR;
@@ -592,25 +2915,96 @@ UBI_ZPL_RET_T UBI_ZPL_MkDir(
         return UBI_ZPL_NOT_INITED;
     }
 
-    if(dirname == NULL) {
+    if(!_Ubi_BatchValid(ops, nOps)) {
         retval = UBI_ZPL_INVALID_ARG;
     } else {
-        req.op = UBI_ZPL_DIR_MAKE;
-        req.param1 = (void *)dirname;
+        req.op = UBI_ZPL_BATCH;
+        req.param1 = (void *)ops;
+        req.param4 = nOps;
         req.cb = cb;
-
-        /* Send Request to Queue without Blocking*/
-        if(pdTRUE != xQueueSend(xQueueHandleUbi, &req, (TickType_t)0)) {
-            retval = UBI_ZPL_QUEUE_FULL;
-        }
+        retval = _Ubi_Submit(&req);
     }
 
     return(retval);
 }
 
-UBI_ZPL_RET_T UBI_ZPL_RmDir(
-        const char * dirname,
-        ubi_zpl_cb_fcn cb)
+//*****************************************************************************
+//!
+//! \brief Synchronous variant of UBI_ZPL_Batch().
+//!
+//! \return \c 0 if all operations succeeded, otherwise the errno of the
+//!         first one that failed
+//!
+//*****************************************************************************
+int UBI_ZPL_BatchSync(
+        UBI_ZPL_BATCH_ENTRY_T * ops,
+        uint32_t nOps)
+{
+    ubi_zpl_req_t req = {0};
+
+    if(!_Ubi_BatchValid(ops, nOps)) {
+        return -EINVAL;
+    }
+
+    req.op = UBI_ZPL_BATCH;
+    req.param1 = (void *)ops;
+    req.param4 = nOps;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Queue a write-back of everything held in the page cache.
+//!
+//! \param  cb      completion callback, may be NULL
+//!
+//! \return \c UBI_ZPL_RET_T
+//!
+//*****************************************************************************
+UBI_ZPL_RET_T UBI_ZPL_Flush(ubi_zpl_cb_fcn cb)
+{
+    ubi_zpl_req_t req = {0};
+
+    if(bInitDone != true) {
+        return UBI_ZPL_NOT_INITED;
+    }
+
+    req.op = UBI_ZPL_FLUSH;
+    req.cb = cb;
+
+    return _Ubi_Submit(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Synchronous variant of UBI_ZPL_Flush().
+//!
+//! Returns once all cached data and file sizes are on flash.
+//!
+//! \return \c 0 on success, negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_FlushSync(void)
+{
+    ubi_zpl_req_t req = {0};
+
+    req.op = UBI_ZPL_FLUSH;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Queue a write-back of the cached data and size of one file.
+//!
+//! \param  name    file name
+//! \param  cb      completion callback, may be NULL
+//!
+//! \return \c UBI_ZPL_RET_T
+//!
+//*****************************************************************************
+UBI_ZPL_RET_T UBI_ZPL_FileSync(const char * name, ubi_zpl_cb_fcn cb)
 {
     UBI_ZPL_RET_T retval = UBI_ZPL_NOERROR;
     ubi_zpl_req_t req = {0};
@@ -619,18 +3013,221 @@ UBI_ZPL_RET_T UBI_ZPL_RmDir(
         return UBI_ZPL_NOT_INITED;
     }
 
-    if(dirname == NULL) {
+    if(name == NULL) {
         retval = UBI_ZPL_INVALID_ARG;
     } else {
-        req.op = UBI_ZPL_DIR_REMOVE;
-        req.param1 = (void *)dirname;
+        req.op = UBI_ZPL_FILE_SYNC;
+        req.param1 = (void *)name;
         req.cb = cb;
-
-        /* Send Request to Queue without Blocking*/
-        if(pdTRUE != xQueueSend(xQueueHandleUbi, &req, (TickType_t)0)) {
-            retval = UBI_ZPL_QUEUE_FULL;
-        }
+        retval = _Ubi_Submit(&req);
     }
 
     return(retval);
 }
+
+//*****************************************************************************
+//!
+//! \brief Synchronous variant of UBI_ZPL_FileSync().
+//!
+//! Returns once the data and size of the file are on flash.
+//!
+//! \return \c 0 on success, negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_FileSyncSync(const char * name)
+{
+    ubi_zpl_req_t req = {0};
+
+    if(name == NULL) {
+        return -EINVAL;
+    }
+
+    req.op = UBI_ZPL_FILE_SYNC;
+    req.param1 = (void *)name;
+
+    return _Ubi_SubmitSync(&req);
+}
+
+//*****************************************************************************
+//!
+//! \brief Get the read-ahead counters.
+//!
+//! The hit rate is hits / (hits + misses). Counters run from power-up.
+//!
+//! \param  stats   filled in with a copy of the counters
+//!
+//! \return \c UBI_ZPL_RET_T
+//!
+//*****************************************************************************
+UBI_ZPL_RET_T UBI_ZPL_GetReadAheadStats(UBI_ZPL_RA_STATS_T * stats)
+{
+    if(stats == NULL) {
+        return UBI_ZPL_INVALID_ARG;
+    }
+
+    taskENTER_CRITICAL();
+    *stats = xReadAheadStats;
+    taskEXIT_CRITICAL();
+
+    return UBI_ZPL_NOERROR;
+}
+
+//*****************************************************************************
+//!
+//! \brief Get the heap usage of one subsystem.
+//!
+//! \param  idx     subsystem index, starting at 0
+//! \param  stats   filled in with a copy of the counters
+//!
+//! \return \c UBI_ZPL_INVALID_ARG once idx is past the last subsystem
+//!
+//*****************************************************************************
+UBI_ZPL_RET_T UBI_ZPL_GetHeapStats(uint32_t idx, UBI_ZPL_HEAP_STATS_T * stats)
+{
+    struct kmem_stats st;
+
+    if((stats == NULL) || (kmem_get_stats((int)idx, &st) != 0)) {
+        return UBI_ZPL_INVALID_ARG;
+    }
+
+    stats->name = kmem_tag_name((int)idx);
+    stats->bytes = st.bytes;
+    stats->peak = st.peak;
+    stats->count = st.count;
+
+    return UBI_ZPL_NOERROR;
+}
+
+//*****************************************************************************
+//!
+//! \brief Print the heap usage of all subsystems and slab caches.
+//!
+//*****************************************************************************
+void UBI_ZPL_PrintHeapStats(void)
+{
+    kmem_print_stats();
+}
+
+//*****************************************************************************
+//!
+//! \brief Get how the UBI partition was attached and how long it took.
+//!
+//! \param  stats   filled in with the attach method and time
+//!
+//! \return \c UBI_ZPL_NOT_INITED if the partition is not attached
+//!
+//*****************************************************************************
+UBI_ZPL_RET_T UBI_ZPL_GetAttachStats(UBI_ZPL_ATTACH_STATS_T * stats)
+{
+    unsigned int ms;
+    int byFm;
+
+    if(stats == NULL) {
+        return UBI_ZPL_INVALID_ARG;
+    }
+    if(!bUbiPartMounted || (ubi_attach_stats(&ms, &byFm) != 0)) {
+        return UBI_ZPL_NOT_INITED;
+    }
+
+    stats->attachMs = ms;
+    stats->byFastmap = (byFm != 0) ? 1 : 0;
+    stats->nandPageLoads = xAttachNandStats.pageLoads;
+    stats->nandReadBytes = xAttachNandStats.readBytes;
+
+    return UBI_ZPL_NOERROR;
+}
+
+//*****************************************************************************
+//!
+//! \brief Get how often a write had to wait for a UBI block erasure.
+//!
+//! \param  stats   filled in with a copy of the counters
+//!
+//! \return \c UBI_ZPL_NOT_INITED if the partition is not attached
+//!
+//*****************************************************************************
+UBI_ZPL_RET_T UBI_ZPL_GetEraseStats(UBI_ZPL_ERASE_STATS_T * stats)
+{
+#ifdef CONFIG_MTD_UBI_ERASED_RESERVE
+    unsigned int gets, waits, syncWorks, bgWorks;
+#endif /* CONFIG_MTD_UBI_ERASED_RESERVE */
+
+    if(stats == NULL) {
+        return UBI_ZPL_INVALID_ARG;
+    }
+#ifdef CONFIG_MTD_UBI_ERASED_RESERVE
+    if(!bUbiPartMounted ||
+       (ubi_erase_stats(&gets, &waits, &syncWorks, &bgWorks) != 0)) {
+        return UBI_ZPL_NOT_INITED;
+    }
+
+    stats->pebGets = gets;
+    stats->eraseWaits = waits;
+    stats->syncWorks = syncWorks;
+    stats->bgWorks = bgWorks;
+
+    return UBI_ZPL_NOERROR;
+#else
+    return UBI_ZPL_NOT_INITED;
+#endif /* CONFIG_MTD_UBI_ERASED_RESERVE */
+}
+
+//*****************************************************************************
+//!
+//! \brief Get the progress of the background scrubber.
+//!
+//! \param  stats   filled in with a copy of the counters
+//!
+//! \return \c UBI_ZPL_NOT_INITED if the partition is not attached
+//!
+//*****************************************************************************
+UBI_ZPL_RET_T UBI_ZPL_GetScrubStats(UBI_ZPL_SCRUB_STATS_T * stats)
+{
+#ifdef CONFIG_MTD_UBI_SCRUB_BITFLIPS
+    unsigned int pages, bitflips, moves, passes;
+#endif /* CONFIG_MTD_UBI_SCRUB_BITFLIPS */
+
+    if(stats == NULL) {
+        return UBI_ZPL_INVALID_ARG;
+    }
+#ifdef CONFIG_MTD_UBI_SCRUB_BITFLIPS
+    if(!bUbiPartMounted ||
+       (ubi_scrub_stats(&pages, &bitflips, &moves, &passes) != 0)) {
+        return UBI_ZPL_NOT_INITED;
+    }
+
+    stats->pages = pages;
+    stats->bitflips = bitflips;
+    stats->moves = moves;
+    stats->passes = passes;
+
+    return UBI_ZPL_NOERROR;
+#else
+    return UBI_ZPL_NOT_INITED;
+#endif /* CONFIG_MTD_UBI_SCRUB_BITFLIPS */
+}
+
+//*****************************************************************************
+//!
+//! \brief Get the erase counter histogram and wear-leveling counters.
+//!
+//! Blocks until the gatekeeper has collected them.
+//!
+//! \param  stats   filled in with the statistics
+//!
+//! \return \c 0 on success, negative errno otherwise
+//!
+//*****************************************************************************
+int UBI_ZPL_GetWearStatsSync(UBI_ZPL_WEAR_STATS_T * stats)
+{
+    ubi_zpl_req_t req = {0};
+
+    if(stats == NULL) {
+        return -EINVAL;
+    }
+
+    req.op = UBI_ZPL_WEAR_STATS;
+    req.param1 = (void *)stats;
+
+    return _Ubi_SubmitSync(&req);
+}
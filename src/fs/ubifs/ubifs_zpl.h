@@ -16,6 +16,7 @@
 // File dependencies.
 //*****************************************************************************
 #define configTASK_PRIORITY_UBI_FS      (tskIDLE_PRIORITY + 1)
+#define UBI_ZPL_EC_HIST_BUCKETS         (16)
 
 //*****************************************************************************
 // Public / Internal definitions.
@@ -46,6 +47,300 @@ typedef enum {
 
 typedef void (*ubi_zpl_cb_fcn)(int sts);
 
+/* Consumer of UBI_ZPL_FileReadStreamSync(), returns 0 to go on or a negative errno to stop */
+typedef int (*ubi_zpl_consume_fcn)(const void * buf, int len, void * priv);
+
+/*!
+ * \subsection subsect_ubi_zpl_batch UBI ZPL Batch Operations
+ * A batch is an array of operations that the gatekeeper executes back to
+ * back under a single volume open, with one completion for the whole array.
+ * All entries are executed even if one of them fails; each entry reports its
+ * own result in \c err. The whole batch is rejected before it is queued if
+ * an entry has an unknown operation, no name, or no buffer for a write,
+ * read or append.
+ *
+ * \enum UBI_ZPL_BATCH_OP_T
+ */
+typedef enum {
+    UBI_ZPL_BATCH_FILE_EXIST = 0,   /*!< actual = 1 if the file exists, 0 otherwise */
+    UBI_ZPL_BATCH_FILE_WRITE,       /*!< actual = number of bytes written */
+    UBI_ZPL_BATCH_FILE_READ,        /*!< actual = number of bytes read */
+    UBI_ZPL_BATCH_FILE_GET_SIZE,    /*!< actual = size of the file */
+    UBI_ZPL_BATCH_FILE_REMOVE,
+    UBI_ZPL_BATCH_DIR_MAKE,
+    UBI_ZPL_BATCH_DIR_REMOVE,
+    UBI_ZPL_BATCH_FILE_APPEND,      /*!< actual = number of bytes appended, offset unused */
+
+    N_UBI_ZPL_BATCH_OP              /*!< Total number of batch operations */
+} UBI_ZPL_BATCH_OP_T;
+
+typedef struct {
+    UBI_ZPL_BATCH_OP_T op;  /*!< Operation to perform */
+    const char * name;      /*!< File or directory name */
+    void * buf;             /*!< Data buffer for read and write */
+    uint32_t offset;        /*!< File offset for read and write */
+    uint32_t size;          /*!< Number of bytes to read or write */
+    uint32_t actual;        /*!< Operation output, see UBI_ZPL_BATCH_OP_T */
+    int err;                /*!< 0 or negative errno of this operation */
+} UBI_ZPL_BATCH_ENTRY_T;
+
+/*!
+ * \subsection subsect_ubi_zpl_ra UBI ZPL Read-Ahead
+ * The gatekeeper keeps a read-ahead buffer for the CONFIG_UBI_ZPL_RA_STREAMS
+ * files read most recently. Once a file is read in consecutive chunks, the
+ * data following the last chunk is prefetched while the request queue is
+ * idle, in a window that doubles on every prefetch up to
+ * CONFIG_UBI_ZPL_RA_MAX_BYTES. Writing, appending to or removing a file drops
+ * its buffer.
+ *
+ * \struct UBI_ZPL_RA_STATS_T
+ */
+typedef struct {
+    uint32_t hits;          /*!< Reads served from a read-ahead buffer */
+    uint32_t misses;        /*!< Reads that went to flash */
+    uint32_t prefetches;    /*!< Prefetches run by the gatekeeper */
+    uint32_t prefetchBytes; /*!< Bytes read by prefetches */
+} UBI_ZPL_RA_STATS_T;
+
+/*!
+ * \subsection subsect_ubi_zpl_heap UBI ZPL Heap Accounting
+ * With CONFIG_KMEM_ACCOUNTING set, every allocation made by MTD, UBI and
+ * UBIFS is charged to a subsystem (TNC, LPT, wear-leveling, ...). The
+ * counters of subsystem idx are read with UBI_ZPL_GetHeapStats(), for idx
+ * from 0 until it returns UBI_ZPL_INVALID_ARG. With CONFIG_KMEM_LEAK_REPORT
+ * set, subsystems holding more memory after an unmount than before the mount
+ * are reported on the debug console.
+ *
+ * \struct UBI_ZPL_HEAP_STATS_T
+ */
+typedef struct {
+    const char * name;      /*!< Subsystem name */
+    uint32_t bytes;         /*!< Bytes currently allocated */
+    uint32_t peak;          /*!< Highest number of bytes allocated */
+    uint32_t count;         /*!< Allocations currently live */
+} UBI_ZPL_HEAP_STATS_T;
+
+/*!
+ * \subsection subsect_ubi_zpl_bbt UBI ZPL Bad Block Table
+ * With CONFIG_SYS_NAND_USE_FLASH_BBT set, nand_bbt keeps the bad block table
+ * and its mirror in the last NAND_BBT_SCAN_MAXBLOCKS (4) blocks of the chip,
+ * so a boot reads one table instead of the OOB of every block. The first boot
+ * without a table erases those blocks and writes it. MTDPARTS_DEFAULT gives
+ * the blocks to a read-only "bbt" partition after rootfs, so they never hold
+ * UBI data.
+ *
+ * Boards flashed with the older "-(rootfs)" layout have UBI data in those
+ * blocks, and rootfs is 4 blocks smaller now. Booting this firmware on such a
+ * board loses the LEBs in those blocks. Migrate them once, from the boot
+ * loader or the flashing tool, before the new firmware first runs:
+ * -# save the files to keep (the environment volume included);
+ * -# erase rootfs and bbt, e.g. "nand erase.part rootfs" and
+ *    "nand erase.part bbt", or "nand scrub" of the last 4 blocks if they
+ *    were marked reserved by an earlier BBT;
+ * -# write the new firmware, then "ubi part rootfs" and re-create the
+ *    volumes, or write a UBI image built for the 123 MiB partition;
+ * -# restore the saved files.
+ *
+ * The first boot then writes the tables into bbt.
+ */
+
+/*!
+ * \subsection subsect_ubi_zpl_attach UBI ZPL Attach Time
+ * With CONFIG_MTD_UBI_FASTMAP set, UBI writes a fastmap (the PEB to LEB
+ * mapping and erase counters) on detach and whenever its pools run dry, and
+ * the next attach reads it instead of scanning every PEB of the partition.
+ * An attach falls back to scanning when the fastmap is missing or was cut
+ * short by a power loss. UBI_ZPL_GetAttachStats() tells how the partition
+ * was attached and how long it took. With CONFIG_MXRT105X_NAND_PARTIAL_READ
+ * set, a scan moves only the ECC steps holding the UBI headers over the
+ * SEMC; the NAND counters of the boot attach show the difference.
+ *
+ * \struct UBI_ZPL_ATTACH_STATS_T
+ */
+typedef struct {
+    uint32_t attachMs;      /*!< Time the last attach took, in ms */
+    uint32_t byFastmap;     /*!< 1 if attached from the fastmap, 0 if by scanning */
+    uint32_t nandPageLoads; /*!< Pages the boot attach loaded from the NAND array */
+    uint32_t nandReadBytes; /*!< Bytes the boot attach moved over the SEMC */
+} UBI_ZPL_ATTACH_STATS_T;
+
+/*!
+ * \subsection subsect_ubi_zpl_erase UBI ZPL Erased Block Reserve
+ * U-Boot has no UBI background thread, so UBI used to erase a block as soon
+ * as it was freed, inside the write that freed it. With
+ * CONFIG_MTD_UBI_ERASED_RESERVE set, freed blocks are queued instead and the
+ * gatekeeper erases them while its queue is empty, or one per request while
+ * fewer than CONFIG_MTD_UBI_ERASED_RESERVE erased blocks are left. A write
+ * waits for an erasure only when the reserve has run dry;
+ * UBI_ZPL_GetEraseStats() tells how often that happened.
+ *
+ * \struct UBI_ZPL_ERASE_STATS_T
+ */
+typedef struct {
+    uint32_t pebGets;       /*!< Erased blocks handed out for writing */
+    uint32_t eraseWaits;    /*!< Block allocations that waited for an erasure */
+    uint32_t syncWorks;     /*!< Erasures and moves done while waiting */
+    uint32_t bgWorks;       /*!< Erasures and moves done in idle time */
+} UBI_ZPL_ERASE_STATS_T;
+
+/*!
+ * \subsection subsect_ubi_zpl_scrub UBI ZPL Background Scrubber
+ * UBI moves a block to a fresh one when a read corrects a bitflip in it, but
+ * rarely read files may gather bitflips until the 1-bit Hamming ECC gives up.
+ * With CONFIG_MTD_UBI_SCRUB_BITFLIPS set, the gatekeeper walks all used blocks
+ * while its queue is empty, CONFIG_UBI_ZPL_SCRUB_PAGES pages at most every
+ * CONFIG_UBI_ZPL_SCRUB_INTERVAL_MS, and has UBI move every block in which
+ * CONFIG_MTD_UBI_SCRUB_BITFLIPS or more bitflips were corrected. Once the
+ * walk has covered the whole partition it rests for
+ * CONFIG_UBI_ZPL_SCRUB_PASS_PAUSE_MS before starting over.
+ *
+ * \struct UBI_ZPL_SCRUB_STATS_T
+ */
+typedef struct {
+    uint32_t pages;         /*!< Pages read by the scrubber */
+    uint32_t bitflips;      /*!< Bitflips corrected in them */
+    uint32_t moves;         /*!< Blocks scheduled for moving */
+    uint32_t passes;        /*!< Walks over the whole partition completed */
+} UBI_ZPL_SCRUB_STATS_T;
+
+/*!
+ * \subsection subsect_ubi_zpl_wear UBI ZPL Wear Statistics
+ * UBI moves data from a little worn block to a more worn one once their
+ * erase counters differ by more than CONFIG_MTD_UBI_WL_THRESHOLD. A lower
+ * threshold spreads wear more evenly at the cost of more moves, i.e. more
+ * write amplification. UBI_ZPL_GetWearStatsSync() returns the erase counter
+ * spread, a histogram of it in UBI_ZPL_EC_HIST_BUCKETS equal ranges starting
+ * at minEc, and what the moves have cost so far. It is served by the
+ * gatekeeper, so it must not be called from the callback of a request, but
+ * without mounting UBIFS or counting towards its periodic remount.
+ *
+ * \struct UBI_ZPL_WEAR_STATS_T
+ */
+typedef struct {
+    uint32_t minEc;         /*!< Lowest erase counter */
+    uint32_t meanEc;        /*!< Mean erase counter */
+    uint32_t maxEc;         /*!< Highest erase counter */
+    uint32_t bucketEc;      /*!< Erase counters covered by one ecHist entry */
+    uint32_t ecHist[UBI_ZPL_EC_HIST_BUCKETS]; /*!< Blocks per erase counter range */
+    uint32_t wlMoves;       /*!< Blocks moved, for wear-leveling or scrubbing */
+    uint32_t scrubMoves;    /*!< Of these, moves done to get rid of bitflips */
+    uint64_t wlBytes;       /*!< Data copied by the moves */
+    uint32_t wlWorkMs;      /*!< Time spent in moves and erasures */
+} UBI_ZPL_WEAR_STATS_T;
+
+/*!
+ * \subsection subsect_ubi_zpl_flush UBI ZPL Write-Back Cache
+ * By default the page cache is write-through: a completed write or append is
+ * on flash. Setting CONFIG_UBIFS_PCACHE_WRITEBACK to 1 keeps written and
+ * appended data in the UBIFS page cache until its pages are evicted, it has
+ * been dirty for CONFIG_UBIFS_PCACHE_DIRTY_AGE_MS, on unmount, or until
+ * UBI_ZPL_FileSync() (one file) or UBI_ZPL_Flush() (all files) is called.
+ * Data not yet written back is lost on power failure, so sync a file after
+ * anything in it that must survive one. An out-of-space error may only show
+ * up at that point.
+ */
+
+/*!
+ * \subsection subsect_ubi_zpl_trunc UBI ZPL Truncate and Punch Hole
+ * UBI_ZPL_FileTruncate() sets the size of a file. Growing it only rewrites
+ * the inode, the new part reads back as zeroes. UBI_ZPL_FilePunchHole()
+ * discards a byte range and keeps the size, the range reads back as zeroes.
+ * Both drop the data of the whole blocks concerned with one truncation
+ * record, and only rewrite a partial block at either end, so dropping the
+ * head of a log costs the same whatever its length. The file offsets of the
+ * remaining data do not change.
+ */
+
+/*!
+ * \subsection subsect_ubi_zpl_rename UBI ZPL Rename
+ * UBI_ZPL_FileRename() gives a regular file a new name, possibly in another
+ * directory, and replaces the file already there, if any. This is one
+ * journal write, so after a power failure the new name refers either to the
+ * complete old file or to the complete renamed one. To update a config file
+ * safely, write the new contents to a temporary file and rename it over the
+ * config file. Data of the renamed file held by the write-back cache is
+ * written first. Directories cannot be renamed, and a file being streamed
+ * can be neither renamed nor replaced.
+ */
+
+/*!
+ * \subsection subsect_ubi_zpl_env UBI ZPL Environment
+ * With CONFIG_UBI_ZPL_ENV_VOLUME set, small settings are kept as key/value
+ * pairs in a UBI volume of that name, made on first boot if the image has
+ * none, instead of in UBIFS files. UBI_ZPL_EnvSet() only changes the value in
+ * RAM. UBI_ZPL_EnvSave() appends the changed values to a log in the first
+ * CONFIG_UBI_ZPL_ENV_LOG_BYTES of the volume, CRC protected, with one write
+ * of whole NAND pages, a single page for a few values. Values not saved are
+ * lost on power failure, a save interrupted by one loses its own values only.
+ * When the log is full, UBI_ZPL_EnvSet() packs it in RAM down to the current
+ * values and the next save rewrites it, atomically. UBI_ZPL_EnvLoad() drops
+ * the values not saved and reads the log back from flash. The whole log is
+ * held in RAM with an index by key, so UBI_ZPL_EnvGet() costs no flash access.
+ * The environment requests do not mount UBIFS, so they do not count towards
+ * its periodic remount.
+ * Keys are up to CONFIG_UBI_ZPL_ENV_KEY_LEN and values up to
+ * CONFIG_UBI_ZPL_ENV_VAL_LEN bytes of any content, with at most
+ * CONFIG_UBI_ZPL_ENV_MAX_KEYS keys. Setting an empty value deletes a key.
+ * A log holding more keys than that, e.g. after a firmware update lowered
+ * the limit, is not touched: the environment requests then fail with
+ * -ENODEV.
+ */
+
+/*!
+ * \subsection subsect_ubi_zpl_stream UBI ZPL Streaming Write
+ * A file too large to be held in RAM, such as a firmware image received
+ * over a serial link, is written in chunks of any size: one call to
+ * UBI_ZPL_FileStreamBeginSync(), any number of UBI_ZPL_FileStreamWriteSync(),
+ * then UBI_ZPL_FileStreamFinishSync(), or UBI_ZPL_FileStreamAbortSync() to
+ * drop the file. The gatekeeper buffers at most one 4 KiB block of it and
+ * commits once, at the finish. The data goes to the file name with ".part"
+ * appended, which the finish renames over the file as UBI_ZPL_FileRename()
+ * does, so the file keeps its old contents until then, through an abort or
+ * a power failure. A ".part" file left by a power failure is removed by the
+ * next begin for the same name. Only one file can be streamed at a time, and
+ * writes, appends, truncation and deletion of the ".part" file fail with
+ * -EBUSY until the stream is finished or aborted.
+ */
+
+/*!
+ * \subsection subsect_ubi_zpl_read_stream UBI ZPL Streaming Read
+ * UBI_ZPL_FileReadStreamSync() hands a byte range of a file to a consumer
+ * function one piece of at most 4 KiB at a time, in file order, so a file of
+ * any size can be checksummed or sent out without a buffer for all of it.
+ * The gatekeeper needs no more than 8 KiB for it. Uncompressed data is passed
+ * straight from the buffer the data node was read into. The consumer runs in
+ * the gatekeeper task and may only use the data until it returns. It may
+ * block, e.g. on a CRC engine, a UART DMA or a FreeRTOS stream buffer, but
+ * must not call the UBI_ZPL API itself.
+ */
+
+/*!
+ * \subsection subsect_ubi_zpl_hot UBI ZPL Hot Data
+ * With CONFIG_UBIFS_HOT_JHEAD set, UBI_ZPL_SetHotSync() marks a file or a
+ * directory as holding data that is rewritten often, such as configuration
+ * files. Their data is then written to LEBs of its own instead of next to
+ * write-once data like logs, which garbage collection would otherwise have
+ * to copy. Files and directories created in a hot directory are hot too.
+ * The hint only affects data written after it is set. The first call that
+ * sets it adds a journal head to the superblock, after which Linux can no
+ * longer mount the volume.
+ */
+
+/*!
+ * \subsection subsect_ubi_zpl_sync UBI ZPL Synchronous Calls
+ * Every request has a *Sync variant that blocks the calling task until the
+ * gatekeeper is done with it and returns the result directly:
+ * <table>
+ * <tr><td>0            <td>Operation completed without error
+ * <tr><td>-EINVAL      <td>Invalid arguments
+ * <tr><td>-ENODEV      <td>Module is not initialized or volume not mounted
+ * <tr><td>-EDEADLK     <td>Called from the gatekeeper task itself
+ * <tr><td>other < 0    <td>Error code returned by UBIFS
+ * </table>
+ * Completion is signalled with a direct-to-task notification, so the caller
+ * must not use its notification value for anything else during the call.
+ */
+
 //*****************************************************************************
 // Public function prototypes.
 //*****************************************************************************
@@ -85,6 +380,40 @@ UBI_ZPL_RET_T UBI_ZPL_RmFile(
         const char * filename,
         ubi_zpl_cb_fcn cb);
 
+UBI_ZPL_RET_T UBI_ZPL_FileTruncate(
+        const char * filename,
+        uint32_t size,
+        ubi_zpl_cb_fcn cb);
+
+UBI_ZPL_RET_T UBI_ZPL_FilePunchHole(
+        const char * filename,
+        uint32_t offset,
+        uint32_t size,
+        ubi_zpl_cb_fcn cb);
+
+UBI_ZPL_RET_T UBI_ZPL_FileRename(
+        const char * oldname,
+        const char * newname,
+        ubi_zpl_cb_fcn cb);
+
+UBI_ZPL_RET_T UBI_ZPL_EnvGet(
+        const char * key,
+        uint32_t keylen,
+        char * valbuf,
+        uint32_t bufsz,
+        ubi_zpl_cb_fcn cb);
+
+UBI_ZPL_RET_T UBI_ZPL_EnvSet(
+        const char * key,
+        uint32_t keylen,
+        const char * val,
+        uint32_t vallen,
+        ubi_zpl_cb_fcn cb);
+
+UBI_ZPL_RET_T UBI_ZPL_EnvSave(ubi_zpl_cb_fcn cb);
+
+UBI_ZPL_RET_T UBI_ZPL_EnvLoad(ubi_zpl_cb_fcn cb);
+
 UBI_ZPL_RET_T UBI_ZPL_MkDir(
         const char * dirname,
         ubi_zpl_cb_fcn cb);
@@ -93,6 +422,124 @@ UBI_ZPL_RET_T UBI_ZPL_RmDir(
         const char * dirname,
         ubi_zpl_cb_fcn cb);
 
+int UBI_ZPL_FileWriteSync(
+        char * filename,
+        void *buf,
+        uint32_t offset,
+        uint32_t size,
+        uint32_t *actwritten);
+
+UBI_ZPL_RET_T UBI_ZPL_FileAppend(
+        char * filename,
+        void *buf,
+        uint32_t size,
+        uint32_t *actwritten,
+        ubi_zpl_cb_fcn cb);
+
+int UBI_ZPL_FileAppendSync(
+        char * filename,
+        void *buf,
+        uint32_t size,
+        uint32_t *actwritten);
+
+int UBI_ZPL_FileReadSync(
+        char * filename,
+        void *buf,
+        uint32_t offset,
+        uint32_t size,
+        uint32_t *actread);
+
+int UBI_ZPL_FileReadStreamSync(
+        const char * filename,
+        uint32_t offset,
+        uint32_t size,
+        ubi_zpl_consume_fcn consume,
+        void * priv,
+        uint32_t *actread);
+
+int UBI_ZPL_FileGetSizeSync(
+        const char * filename,
+        uint32_t *size);
+
+int UBI_ZPL_FileExistSync(
+        const char * filename,
+        int * bExist);
+
+int UBI_ZPL_RmFileSync(const char * filename);
+
+int UBI_ZPL_FileTruncateSync(const char * filename, uint32_t size);
+
+int UBI_ZPL_FilePunchHoleSync(
+        const char * filename,
+        uint32_t offset,
+        uint32_t size);
+
+int UBI_ZPL_FileRenameSync(const char * oldname, const char * newname);
+
+int UBI_ZPL_EnvGetSync(
+        const char * key,
+        uint32_t keylen,
+        char * valbuf,
+        uint32_t bufsz);
+
+int UBI_ZPL_EnvSetSync(
+        const char * key,
+        uint32_t keylen,
+        const char * val,
+        uint32_t vallen);
+
+int UBI_ZPL_EnvSaveSync(void);
+
+int UBI_ZPL_EnvLoadSync(void);
+
+int UBI_ZPL_MkDirSync(const char * dirname);
+
+int UBI_ZPL_RmDirSync(const char * dirname);
+
+int UBI_ZPL_FileStreamBeginSync(const char * filename);
+
+int UBI_ZPL_FileStreamWriteSync(
+        const char * filename,
+        const void * buf,
+        uint32_t size);
+
+int UBI_ZPL_FileStreamFinishSync(const char * filename);
+
+int UBI_ZPL_FileStreamAbortSync(const char * filename);
+
+int UBI_ZPL_SetHotSync(const char * path, int hot);
+
+UBI_ZPL_RET_T UBI_ZPL_Batch(
+        UBI_ZPL_BATCH_ENTRY_T * ops,
+        uint32_t nOps,
+        ubi_zpl_cb_fcn cb);
+
+int UBI_ZPL_BatchSync(
+        UBI_ZPL_BATCH_ENTRY_T * ops,
+        uint32_t nOps);
+
+UBI_ZPL_RET_T UBI_ZPL_Flush(ubi_zpl_cb_fcn cb);
+
+int UBI_ZPL_FlushSync(void);
+
+UBI_ZPL_RET_T UBI_ZPL_FileSync(const char * name, ubi_zpl_cb_fcn cb);
+
+int UBI_ZPL_FileSyncSync(const char * name);
+
+UBI_ZPL_RET_T UBI_ZPL_GetReadAheadStats(UBI_ZPL_RA_STATS_T * stats);
+
+UBI_ZPL_RET_T UBI_ZPL_GetHeapStats(uint32_t idx, UBI_ZPL_HEAP_STATS_T * stats);
+
+void UBI_ZPL_PrintHeapStats(void);
+
+UBI_ZPL_RET_T UBI_ZPL_GetAttachStats(UBI_ZPL_ATTACH_STATS_T * stats);
+
+UBI_ZPL_RET_T UBI_ZPL_GetEraseStats(UBI_ZPL_ERASE_STATS_T * stats);
+
+UBI_ZPL_RET_T UBI_ZPL_GetScrubStats(UBI_ZPL_SCRUB_STATS_T * stats);
+
+int UBI_ZPL_GetWearStatsSync(UBI_ZPL_WEAR_STATS_T * stats);
+
 #if defined(__cplusplus)
 }
 #endif /* __cplusplus*/
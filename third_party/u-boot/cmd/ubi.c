@@ -484,6 +484,11 @@ int ubi_detach(void)
 	 * Call ubi_exit() before re-initializing the UBI subsystem
 	 */
 	if (ubi_initialized) {
+#ifdef CONFIG_MTD_UBI_ERASED_RESERVE
+		/* Do not leave freed PEBs unerased behind a clean detach */
+		if (ubi_dev.selected && ubi)
+			ubi_wl_flush(ubi, UBI_ALL, UBI_ALL);
+#endif
 		ubi_exit();
 		del_mtd_partitions(ubi_dev.mtd_info);
 		ubi_initialized = 0;
@@ -534,6 +539,175 @@ int ubi_part(char *part_name, const char *vid_header_offset)
 	return 0;
 }
 
+#ifdef __ZPL_BUILD__
+/**
+ * ubi_attach_stats - report how the selected UBI device was attached.
+ * @ms: returns the time the attach took, in milliseconds
+ * @by_fm: returns non-zero if the device was attached from its fastmap
+ *
+ * Returns zero on success or -ENODEV if no UBI device is attached.
+ */
+int ubi_attach_stats(unsigned int *ms, int *by_fm)
+{
+	if (!ubi_dev.selected || !ubi)
+		return -ENODEV;
+
+	*ms = ubi->attach_ms;
+	*by_fm = ubi->attach_by_fm;
+	return 0;
+}
+
+/**
+ * ubi_wear_stats - report erase counter spread and wear-leveling activity.
+ * @st: filled in with the erase counter summary and the WL counters
+ * @hist: filled in with the erase counter histogram, may be %NULL
+ * @buckets: number of entries in @hist
+ *
+ * Returns zero on success or -ENODEV if no UBI device is attached.
+ */
+int ubi_wear_stats(struct ubi_wear_stats *st, unsigned int *hist, int buckets)
+{
+	if (!ubi_dev.selected || !ubi)
+		return -ENODEV;
+
+	ubi_wl_wear_stats(ubi, st, hist, buckets);
+	return 0;
+}
+
+#ifdef CONFIG_MTD_UBI_FASTMAP
+/**
+ * ubi_fastmap_power_cut - emulate a power cut in the middle of a fastmap update.
+ * @writes: number of EC/VID header writes to let through before the cut
+ *
+ * Writes a new fastmap with power cut emulation armed, so that the update is
+ * abandoned after @writes header writes and the device is left read-only the
+ * way a real brown-out would leave the flash. The caller is expected to
+ * re-attach with ubi_part() to check that the device still comes up.
+ *
+ * Returns 1 if the power cut hit during the update, 0 if the update completed
+ * first, or a negative error code.
+ */
+int ubi_fastmap_power_cut(unsigned int writes)
+{
+	int err;
+
+	if (!ubi_dev.selected || !ubi)
+		return -ENODEV;
+	if (writes == 0)
+		return -EINVAL;
+
+	ubi->dbg.emulate_power_cut = POWER_CUT_EC_WRITE | POWER_CUT_VID_WRITE;
+	ubi->dbg.power_cut_min = ubi->dbg.power_cut_max = writes;
+	ubi->dbg.power_cut_counter = writes;
+
+	err = ubi_update_fastmap(ubi);
+
+	ubi->dbg.emulate_power_cut = 0;
+	ubi->dbg.power_cut_counter = 0;
+
+	if (ubi->ro_mode)
+		return 1;
+	return err;
+}
+#endif /* CONFIG_MTD_UBI_FASTMAP */
+
+#ifdef CONFIG_MTD_UBI_ERASED_RESERVE
+/**
+ * ubi_background_pending - check for queued erase and wear-leveling work.
+ *
+ * Returns non-zero if the selected UBI device has work queued for
+ * ubi_background_work().
+ */
+int ubi_background_pending(void)
+{
+	if (!ubi_dev.selected || !ubi)
+		return 0;
+
+	return ubi_wl_bg_pending(ubi, 0);
+}
+
+/**
+ * ubi_background_work - do one queued erase or wear-leveling work.
+ * @urgent: only work if fewer than %CONFIG_MTD_UBI_ERASED_RESERVE erased
+ *          PEBs are left
+ *
+ * Meant to be called from the idle time of the task owning the device, in
+ * place of the background thread of Linux.
+ *
+ * Returns 1 if a work was done, 0 if there was nothing to do or a negative
+ * error code.
+ */
+int ubi_background_work(int urgent)
+{
+	if (!ubi_dev.selected || !ubi)
+		return 0;
+
+	return ubi_wl_bg_work(ubi, urgent);
+}
+
+/**
+ * ubi_erase_stats - report how the erased PEB reserve served allocations.
+ * @gets: returns the number of PEBs handed out for writing
+ * @waits: returns how many of them had to wait for an erasure
+ * @sync_works: returns the number of works done while waiting
+ * @bg_works: returns the number of works done in the background
+ *
+ * Returns zero on success or -ENODEV if no UBI device is attached.
+ */
+int ubi_erase_stats(unsigned int *gets, unsigned int *waits,
+		    unsigned int *sync_works, unsigned int *bg_works)
+{
+	if (!ubi_dev.selected || !ubi)
+		return -ENODEV;
+
+	*gets = ubi->wl_stats.gets;
+	*waits = ubi->wl_stats.waits;
+	*sync_works = ubi->wl_stats.sync_works;
+	*bg_works = ubi->wl_stats.bg_works;
+	return 0;
+}
+#endif /* CONFIG_MTD_UBI_ERASED_RESERVE */
+
+#ifdef CONFIG_MTD_UBI_SCRUB_BITFLIPS
+/**
+ * ubi_scrub_step - advance the background scrub walk.
+ * @pages: how many pages to read at most
+ *
+ * Returns the number of pages read, 0 if there was nothing to read or a
+ * negative error code.
+ */
+int ubi_scrub_step(int pages)
+{
+	if (!ubi_dev.selected || !ubi || ubi->ro_mode)
+		return 0;
+
+	return ubi_wl_scrub_step(ubi, pages);
+}
+
+/**
+ * ubi_scrub_stats - report the progress of the background scrub walk.
+ * @pages: returns the number of pages read
+ * @bitflips: returns the number of bitflips corrected in them
+ * @moves: returns the number of PEBs scheduled for scrubbing
+ * @passes: returns the number of walks over the whole device completed
+ *
+ * Returns zero on success or -ENODEV if no UBI device is attached.
+ */
+int ubi_scrub_stats(unsigned int *pages, unsigned int *bitflips,
+		    unsigned int *moves, unsigned int *passes)
+{
+	if (!ubi_dev.selected || !ubi)
+		return -ENODEV;
+
+	*pages = ubi->scrubber.pages;
+	*bitflips = ubi->scrubber.bitflips;
+	*moves = ubi->scrubber.moves;
+	*passes = ubi->scrubber.passes;
+	return 0;
+}
+#endif /* CONFIG_MTD_UBI_SCRUB_BITFLIPS */
+#endif /* __ZPL_BUILD__ */
+
 #ifndef __ZPL_BUILD__
 static int do_ubi(cmd_tbl_t *cmdtp, int flag, int argc, char * const argv[])
 {
@@ -24,6 +24,12 @@
 
 #define MXRT105X_NAND_DEBUG                     0
 
+#if defined(CONFIG_MXRT105X_NAND_PARTIAL_READ)
+/* Pages are transferred in ECC steps, the OOB being the last "step" */
+#define MXRT105X_NAND_CHUNK_SIZE                CONFIG_SYS_NAND_ECCSIZE
+#define MXRT105X_NAND_OOB_CHUNK                 (CONFIG_SYS_NAND_PAGE_SIZE / MXRT105X_NAND_CHUNK_SIZE)
+#endif
+
 struct mxrt105x_nand_info {
     uint8_t *data_buf;
     uint8_t *oob_buf;
@@ -33,16 +39,104 @@ struct mxrt105x_nand_info {
     uint16_t col_addr;
     uint32_t page_addr;
     uint8_t status;
+#if defined(CONFIG_MXRT105X_NAND_PARTIAL_READ)
+    bool page_loaded;       /* page_addr sits in the chip's page register */
+    uint32_t chunk_valid;   /* chunks of buf_main_oob holding the loaded page */
+#endif
 };
 
 static struct mxrt105x_nand_info _nand_info;
-static uint8_t buf_main_oob[CONFIG_SYS_NAND_PAGE_SIZE + CONFIG_SYS_NAND_OOBSIZE];
+static uint8_t buf_main_oob[CONFIG_SYS_NAND_PAGE_SIZE + CONFIG_SYS_NAND_OOBSIZE] __attribute__((aligned(4)));
 
 static void mxrt105x_nand_init(void)
 {
     BSP_NAND_Init();
 }
 
+#if defined(CONFIG_MXRT105X_NAND_PARTIAL_READ)
+/*
+ * Read commands only load the page into the chip's page register. The ECC
+ * steps read_buf()/read_byte() ask for are transferred when first needed, so
+ * reading a 64-byte UBI header moves one ECC step and the OOB instead of the
+ * whole page.
+ */
+static void mxrt105x_nand_load(struct mxrt105x_nand_info *nand_info, uint32_t page_addr)
+{
+	BSP_NAND_LoadPage(page_addr);
+	nand_info->page_loaded = true;
+	nand_info->chunk_valid = 0;
+}
+
+static void mxrt105x_nand_unload(struct mxrt105x_nand_info *nand_info)
+{
+	nand_info->page_loaded = false;
+}
+
+/*
+ * Transfer the chunks covering columns [col, col + len) of the loaded page,
+ * OOB columns counting from the page size. Runs of missing chunks go in one
+ * transfer, and a transfer reaching the end of the main area takes the OOB
+ * along, since the ECC bytes are read next.
+ */
+static void mxrt105x_nand_fetch(struct mxrt105x_nand_info *nand_info, uint32_t col, uint32_t len)
+{
+	uint32_t first, last, end;
+	uint32_t start_col, end_col;
+
+	if (!nand_info->page_loaded || (len == 0))
+		return;
+
+	first = col / MXRT105X_NAND_CHUNK_SIZE;
+	last = (col + len - 1) / MXRT105X_NAND_CHUNK_SIZE;
+	if (last > MXRT105X_NAND_OOB_CHUNK)
+		last = MXRT105X_NAND_OOB_CHUNK;
+
+	while (first <= last) {
+		if (nand_info->chunk_valid & (1U << first)) {
+			first++;
+			continue;
+		}
+
+		end = first;
+		while ((end < last) && !(nand_info->chunk_valid & (1U << (end + 1))))
+			end++;
+		if ((end == MXRT105X_NAND_OOB_CHUNK - 1) &&
+		    !(nand_info->chunk_valid & (1U << MXRT105X_NAND_OOB_CHUNK)))
+			end = MXRT105X_NAND_OOB_CHUNK;
+
+		start_col = first * MXRT105X_NAND_CHUNK_SIZE;
+		if (end == MXRT105X_NAND_OOB_CHUNK)
+			end_col = CONFIG_SYS_NAND_PAGE_SIZE + CONFIG_SYS_NAND_OOBSIZE;
+		else
+			end_col = (end + 1) * MXRT105X_NAND_CHUNK_SIZE;
+		/*
+		 * The SEMC column address cannot reach the OOB, start on the
+		 * last word of the main area and run into it.
+		 */
+		if (start_col >= CONFIG_SYS_NAND_PAGE_SIZE)
+			start_col = CONFIG_SYS_NAND_PAGE_SIZE - 4;
+
+		BSP_NAND_ReadPageColumn(nand_info->page_addr, start_col,
+					&buf_main_oob[start_col], end_col - start_col);
+		nand_info->chunk_valid |= ((2U << end) - 1) & ~((1U << first) - 1);
+		first = end + 1;
+	}
+}
+#else
+static void mxrt105x_nand_load(struct mxrt105x_nand_info *nand_info, uint32_t page_addr)
+{
+	BSP_NAND_ReadPageDataOOB(page_addr, nand_info->data_buf);
+}
+
+static void mxrt105x_nand_unload(struct mxrt105x_nand_info *nand_info)
+{
+}
+
+static void mxrt105x_nand_fetch(struct mxrt105x_nand_info *nand_info, uint32_t col, uint32_t len)
+{
+}
+#endif /* CONFIG_MXRT105X_NAND_PARTIAL_READ */
+
 static void mxrt105x_nand_command(struct mtd_info *mtd, unsigned command,
 				int column, int page_addr)
 {
@@ -59,6 +153,7 @@ static void mxrt105x_nand_command(struct mtd_info *mtd, unsigned command,
 
 	switch (command) {
 	case NAND_CMD_RESET:
+		mxrt105x_nand_unload(nand_info);
 		BSP_NAND_Reset();
 		break;
 
@@ -72,14 +167,14 @@ static void mxrt105x_nand_command(struct mtd_info *mtd, unsigned command,
 		nand_info->page_addr = page_addr;
 		nand_info->col_addr = column;
 		nand_info->spare_only = false;
-		BSP_NAND_ReadPageDataOOB(page_addr, nand_info->data_buf);
+		mxrt105x_nand_load(nand_info, page_addr);
 		break;
 
 	case NAND_CMD_READOOB:
 		nand_info->page_addr = page_addr;
 		nand_info->col_addr = column;
 		nand_info->spare_only = true;
-		BSP_NAND_ReadPageDataOOB(page_addr, nand_info->data_buf);
+		mxrt105x_nand_load(nand_info, page_addr);
 		break;
 
 	case NAND_CMD_RNDOUT:
@@ -97,6 +192,7 @@ static void mxrt105x_nand_command(struct mtd_info *mtd, unsigned command,
 	case NAND_CMD_SEQIN:
 		// Read Page and OOB
 		nand_info->page_addr = page_addr;
+		mxrt105x_nand_unload(nand_info);
 		BSP_NAND_ReadPageDataOOB(page_addr, nand_info->data_buf);
 		if (column >= mtd->writesize) {
 			/* Page OOB region */
@@ -116,11 +212,13 @@ static void mxrt105x_nand_command(struct mtd_info *mtd, unsigned command,
 
 	case NAND_CMD_READID:
 		nand_info->col_addr = 0;
+		mxrt105x_nand_unload(nand_info);
 		BSP_NAND_ReadID(nand_info->data_buf);
 		break;
 
 	case NAND_CMD_ERASE1:
 	case NAND_CMD_ERASE2:
+		mxrt105x_nand_unload(nand_info);
 	    BSP_NAND_Erase(command, page_addr);
 		break;
 	default:
@@ -212,8 +310,10 @@ static void mxrt105x_read_buf(struct mtd_info *mtd, uint8_t *buf, int len)
 	col = nand_info->col_addr;
 
 	if(nand_info->spare_only) {
+		mxrt105x_nand_fetch(nand_info, mtd->writesize + col, len);
 		p = nand_info->oob_buf;
 	} else {
+		mxrt105x_nand_fetch(nand_info, col, len);
 		p = nand_info->data_buf;
 	}
 
@@ -242,8 +342,10 @@ static uint8_t mxrt105x_read_byte(struct mtd_info *mtd)
 
 	/* If we are accessing the spare region */
 	if (nand_info->spare_only) {
+		mxrt105x_nand_fetch(nand_info, mtd->writesize + nand_info->col_addr, 1);
 		ret = nand_info->oob_buf[nand_info->col_addr];
 	} else {
+		mxrt105x_nand_fetch(nand_info, nand_info->col_addr, 1);
         ret = nand_info->data_buf[nand_info->col_addr];
 	}
 
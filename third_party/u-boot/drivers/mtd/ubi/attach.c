@@ -92,6 +92,7 @@
 #include "linux/crc32.h"
 #include "ubi_uboot.h"
 #include "ubi.h"
+#include "task.h"
 #endif /* __ZPL_BUILD__ */
 
 static int self_check_ai(struct ubi_device *ubi, struct ubi_attach_info *ai);
@@ -1418,6 +1419,9 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 {
 	int err;
 	struct ubi_attach_info *ai;
+#ifdef __ZPL_BUILD__
+	TickType_t start = xTaskGetTickCount();
+#endif
 
 	ai = alloc_ai();
 	if (!ai)
@@ -1496,6 +1500,13 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 	}
 #endif
 
+#ifdef __ZPL_BUILD__
+	ubi->attach_by_fm = ubi->fm != NULL;
+	ubi->attach_ms = (xTaskGetTickCount() - start) * portTICK_PERIOD_MS;
+	ubi_msg(ubi, "attached by %s in %u ms",
+		ubi->attach_by_fm ? "fastmap" : "scanning", ubi->attach_ms);
+#endif
+
 	destroy_ai(ai);
 	return 0;
 
@@ -502,6 +502,26 @@ void ubi_debugfs_exit_dev(struct ubi_device *ubi)
 		debugfs_remove_recursive(ubi->dbg.dfs_dir);
 }
 
+#else
+int ubi_debugfs_init(void)
+{
+	return 0;
+}
+
+void ubi_debugfs_exit(void)
+{
+}
+
+int ubi_debugfs_init_dev(struct ubi_device *ubi)
+{
+	return 0;
+}
+
+void ubi_debugfs_exit_dev(struct ubi_device *ubi)
+{
+}
+#endif
+
 /**
  * ubi_dbg_power_cut - emulate a power cut if it is time to do so
  * @ubi: UBI device description object
@@ -534,27 +554,3 @@ int ubi_dbg_power_cut(struct ubi_device *ubi, int caller)
 	ubi_ro_mode(ubi);
 	return 1;
 }
-#else
-int ubi_debugfs_init(void)
-{
-	return 0;
-}
-
-void ubi_debugfs_exit(void)
-{
-}
-
-int ubi_debugfs_init_dev(struct ubi_device *ubi)
-{
-	return 0;
-}
-
-void ubi_debugfs_exit_dev(struct ubi_device *ubi)
-{
-}
-
-int ubi_dbg_power_cut(struct ubi_device *ubi, int caller)
-{
-	return 0;
-}
-#endif
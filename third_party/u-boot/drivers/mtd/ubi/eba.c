@@ -1239,6 +1239,9 @@ int ubi_eba_copy_leb(struct ubi_device *ubi, int from, int to,
 	down_read(&ubi->fm_eba_sem);
 	vol->eba_tbl[lnum] = to;
 	up_read(&ubi->fm_eba_sem);
+#ifdef __ZPL_BUILD__
+	ubi->wl_stats.copied_bytes += aldata_size;
+#endif
 
 out_unlock_buf:
 	mutex_unlock(&ubi->buf_mutex);
@@ -189,6 +189,7 @@ static int produce_free_peb(struct ubi_device *ubi)
 
 		if (err)
 			return err;
+		ubi_wl_stat_inc(ubi, sync_works);
 	}
 
 	return 0;
@@ -236,6 +237,7 @@ again:
 		}
 		retried = 1;
 		up_read(&ubi->fm_eba_sem);
+		ubi_wl_stat_inc(ubi, waits);
 		ret = produce_free_peb(ubi);
 		if (ret < 0) {
 			down_read(&ubi->fm_eba_sem);
@@ -247,6 +249,7 @@ again:
 	ubi_assert(pool->used < pool->size);
 	ret = pool->pebs[pool->used++];
 	prot_queue_add(ubi, ubi->lookuptbl[ret]);
+	ubi_wl_stat_inc(ubi, gets);
 	spin_unlock(&ubi->wl_lock);
 out:
 	return ret;
@@ -7,6 +7,7 @@
  *
  */
 
+#ifndef __ZPL_BUILD__
 #ifndef __UBOOT__
 #include <linux/crc32.h>
 #else
@@ -18,6 +19,15 @@
 #include <linux/compat.h>
 #include <linux/math64.h>
 #include "ubi.h"
+#else /* __ZPL_BUILD__ */
+#include "zplCompat.h"
+#include "linux/err.h"
+#include "linux/crc32.h"
+#include "linux/compat.h"
+#include "linux/math64.h"
+#include "ubi_uboot.h"
+#include "ubi.h"
+#endif /* __ZPL_BUILD__ */
 
 /**
  * init_seen - allocate memory for used for debugging.
@@ -422,6 +422,54 @@ struct ubi_debug_info {
 	struct dentry *dfs_power_cut_max;
 };
 
+/**
+ * struct ubi_wl_stats - counters of the wear-leveling sub-system.
+ *
+ * @gets: PEBs handed out for writing
+ * @waits: gets which found no erased PEB and had to run pending works
+ * @sync_works: works run by such gets
+ * @bg_works: works run in the background, by ubi_wl_bg_work()
+ * @moves: LEBs moved by the wear-leveling worker, including scrubbing
+ * @scrubs: of these, moves done to get rid of bitflips
+ * @copied_bytes: data copied by these moves
+ * @work_ticks: time spent running works (moves and erasures), in ticks
+ */
+struct ubi_wl_stats {
+	unsigned int gets;
+	unsigned int waits;
+	unsigned int sync_works;
+	unsigned int bg_works;
+	unsigned int moves;
+	unsigned int scrubs;
+	unsigned long long copied_bytes;
+	unsigned int work_ticks;
+};
+
+/**
+ * struct ubi_scrubber - state of the background scrubber.
+ *
+ * @pnum: PEB being read
+ * @offs: offset within @pnum to read next
+ * @ec: erase counter of @pnum when its read started
+ * @flips: bitflips corrected in @pnum so far
+ * @pebs: PEBs read to the end
+ * @pages: pages read
+ * @bitflips: bitflips corrected in all pages read
+ * @moves: PEBs scheduled for scrubbing
+ * @passes: walks over the whole device completed
+ */
+struct ubi_scrubber {
+	int pnum;
+	int offs;
+	int ec;
+	unsigned int flips;
+	unsigned int pebs;
+	unsigned int pages;
+	unsigned int bitflips;
+	unsigned int moves;
+	unsigned int passes;
+};
+
 /**
  * struct ubi_device - UBI device description structure
  * @dev: UBI device object to use the the Linux device model
@@ -473,6 +521,8 @@ struct ubi_debug_info {
  * @fm_eba_sem: allows ubi_update_fastmap() to block EBA table changes
  * @fm_work: fastmap work queue
  * @fm_work_scheduled: non-zero if fastmap work was scheduled
+ * @attach_ms: time the last attach took, in milliseconds
+ * @attach_by_fm: non-zero if the last attach was done from the fastmap
  *
  * @used: RB-tree of used physical eraseblocks
  * @erroneous: RB-tree of erroneous used physical eraseblocks
@@ -500,6 +550,8 @@ struct ubi_debug_info {
  * @bgt_thread: background thread description object
  * @thread_enabled: if the background thread is enabled
  * @bgt_name: background thread name
+ * @wl_stats: counters of the wear-leveling sub-system
+ * @scrubber: state of the background scrubber
  *
  * @flash_size: underlying MTD device size (in bytes)
  * @peb_count: count of physical eraseblocks on the MTD device
@@ -583,6 +635,10 @@ struct ubi_device {
 	struct work_struct fm_work;
 #endif
 	int fm_work_scheduled;
+#ifdef __ZPL_BUILD__
+	unsigned int attach_ms;
+	int attach_by_fm;
+#endif
 
 	/* Wear-leveling sub-system's stuff */
 	struct rb_root used;
@@ -605,6 +661,12 @@ struct ubi_device {
 	struct task_struct *bgt_thread;
 	int thread_enabled;
 	char bgt_name[sizeof(UBI_BGT_NAME_PATTERN)+2];
+#ifdef __ZPL_BUILD__
+	struct ubi_wl_stats wl_stats;
+#endif
+#ifdef CONFIG_MTD_UBI_SCRUB_BITFLIPS
+	struct ubi_scrubber scrubber;
+#endif
 
 	/* I/O sub-system's stuff */
 	long long flash_size;
@@ -888,6 +950,17 @@ int ubi_wl_put_fm_peb(struct ubi_device *ubi, struct ubi_wl_entry *used_e,
 int ubi_is_erase_work(struct ubi_work *wrk);
 void ubi_refill_pools(struct ubi_device *ubi);
 int ubi_ensure_anchor_pebs(struct ubi_device *ubi);
+#ifdef CONFIG_MTD_UBI_ERASED_RESERVE
+int ubi_wl_bg_pending(struct ubi_device *ubi, int urgent);
+int ubi_wl_bg_work(struct ubi_device *ubi, int urgent);
+#endif
+#ifdef CONFIG_MTD_UBI_SCRUB_BITFLIPS
+int ubi_wl_scrub_step(struct ubi_device *ubi, int pages);
+#endif
+#ifdef __ZPL_BUILD__
+void ubi_wl_wear_stats(struct ubi_device *ubi, struct ubi_wear_stats *st,
+		       unsigned int *hist, int buckets);
+#endif
 
 /* io.c */
 int ubi_io_read(const struct ubi_device *ubi, void *buf, int pnum, int offset,
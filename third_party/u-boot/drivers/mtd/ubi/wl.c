@@ -97,6 +97,10 @@
 
 #include "ubi.h"
 #include "wl.h"
+#ifdef __ZPL_BUILD__
+#include "linux/math64.h"
+#include "task.h"
+#endif
 
 /* Number of physical eraseblocks reserved for wear-leveling purposes */
 #define WL_RESERVED_PEBS 1
@@ -184,6 +188,26 @@ static void wl_entry_destroy(struct ubi_device *ubi, struct ubi_wl_entry *e)
 	kmem_cache_free(ubi_wl_entry_slab, e);
 }
 
+/**
+ * call_work - run a work.
+ * @ubi: UBI device description object
+ * @wrk: the work to run, it is freed or reused by the time this returns
+ *
+ * Returns what the work function returned.
+ */
+static int call_work(struct ubi_device *ubi, struct ubi_work *wrk)
+{
+#ifdef __ZPL_BUILD__
+	TickType_t start = xTaskGetTickCount();
+	int err = wrk->func(ubi, wrk, 0);
+
+	ubi->wl_stats.work_ticks += xTaskGetTickCount() - start;
+	return err;
+#else
+	return wrk->func(ubi, wrk, 0);
+#endif
+}
+
 /**
  * do_work - do one pending work.
  * @ubi: UBI device description object
@@ -227,7 +251,7 @@ int do_work(struct ubi_device *ubi)
 	 * after this call as it will have been freed or reused by that
 	 * time by the worker function.
 	 */
-	err = wrk->func(ubi, wrk, 0);
+	err = call_work(ubi, wrk);
 	if (err)
 		ubi_err(ubi, "work failed with error code %d", err);
 	up_read(&ubi->work_sem);
@@ -545,7 +569,7 @@ static void __schedule_ubi_work(struct ubi_device *ubi, struct ubi_work *wrk)
 #ifndef __UBOOT__
 	if (ubi->thread_enabled && !ubi_dbg_is_bgt_disabled(ubi))
 		wake_up_process(ubi->bgt_thread);
-#else
+#elif !defined(CONFIG_MTD_UBI_ERASED_RESERVE)
 	int err;
 	/*
 	 * U-Boot special: We have no bgt_thread in U-Boot!
@@ -854,6 +878,9 @@ static int wear_leveling_worker(struct ubi_device *ubi, struct ubi_work *wrk,
 	if (scrubbing)
 		ubi_msg(ubi, "scrubbed PEB %d (LEB %d:%d), data moved to PEB %d",
 			e1->pnum, vol_id, lnum, e2->pnum);
+	ubi_wl_stat_inc(ubi, moves);
+	if (scrubbing)
+		ubi_wl_stat_inc(ubi, scrubs);
 	ubi_free_vid_hdr(ubi, vid_hdr);
 
 	spin_lock(&ubi->wl_lock);
@@ -1320,6 +1347,152 @@ retry:
 	return ensure_wear_leveling(ubi, 0);
 }
 
+#ifdef CONFIG_MTD_UBI_SCRUB_BITFLIPS
+/**
+ * ubi_wl_scrub_step - read a few more pages of the background scrub walk.
+ * @ubi: UBI device description object
+ * @pages: how many pages to read at most
+ *
+ * UBI scrubs a PEB only when a read happens to hit a bitflip, so rarely read
+ * data may collect bitflips until the ECC cannot correct them any more. This
+ * function walks the used PEBs one after the other and reads up to @pages
+ * pages of the current one. Once a PEB is read to its end and the reads
+ * corrected at least %CONFIG_MTD_UBI_SCRUB_BITFLIPS bitflips, it is scheduled
+ * for scrubbing. A PEB which is erased, moved or freed between two calls is
+ * dropped and the walk goes on with the next one.
+ *
+ * Returns the number of pages read, %0 if there is no used PEB at all, or a
+ * negative error code.
+ */
+int ubi_wl_scrub_step(struct ubi_device *ubi, int pages)
+{
+	struct ubi_scrubber *s = &ubi->scrubber;
+	struct ubi_wl_entry *e;
+	unsigned int corrected;
+	int err, len, tries = 0;
+
+	/* Find the next used PEB, or check the current one still is */
+	while (1) {
+		spin_lock(&ubi->wl_lock);
+		e = ubi->lookuptbl[s->pnum];
+		if (e && in_wl_tree(e, &ubi->used) &&
+		    (s->offs == 0 || e->ec == s->ec)) {
+			s->ec = e->ec;
+			spin_unlock(&ubi->wl_lock);
+			break;
+		}
+		spin_unlock(&ubi->wl_lock);
+
+		s->offs = 0;
+		s->flips = 0;
+		if (++s->pnum == ubi->peb_count) {
+			s->pnum = 0;
+			s->passes += 1;
+		}
+		if (++tries > ubi->peb_count)
+			return 0;
+	}
+
+	len = min_t(int, pages * ubi->min_io_size, ubi->peb_size - s->offs);
+
+	mutex_lock(&ubi->buf_mutex);
+	corrected = ubi->mtd->ecc_stats.corrected;
+	err = ubi_io_read(ubi, ubi->peb_buf, s->pnum, s->offs, len);
+	corrected = ubi->mtd->ecc_stats.corrected - corrected;
+	mutex_unlock(&ubi->buf_mutex);
+
+	if (err == UBI_IO_BITFLIPS && corrected == 0)
+		corrected = 1;
+	if (err < 0 && !mtd_is_eccerr(err))
+		return err;
+
+	s->flips += corrected;
+	s->bitflips += corrected;
+	s->pages += len / ubi->min_io_size;
+	s->offs += len;
+
+	/* Data the ECC could not correct is better moved now than never */
+	if (mtd_is_eccerr(err))
+		s->flips = CONFIG_MTD_UBI_SCRUB_BITFLIPS;
+
+	if (s->offs == ubi->peb_size) {
+		s->pebs += 1;
+		if (s->flips >= CONFIG_MTD_UBI_SCRUB_BITFLIPS) {
+			err = ubi_wl_scrub_peb(ubi, s->pnum);
+			if (err)
+				return err;
+			s->moves += 1;
+		}
+		s->offs = 0;
+		s->flips = 0;
+		if (++s->pnum == ubi->peb_count) {
+			s->pnum = 0;
+			s->passes += 1;
+		}
+	}
+
+	return len / ubi->min_io_size;
+}
+#endif
+
+#ifdef __ZPL_BUILD__
+/**
+ * ubi_wl_wear_stats - get the erase counter spread and WL activity.
+ * @ubi: UBI device description object
+ * @st: filled in with the erase counter summary and the WL counters
+ * @hist: filled in with the erase counter histogram, may be %NULL
+ * @buckets: number of entries in @hist
+ *
+ * The histogram counts the PEBs with a known erase counter, i.e. all but the
+ * bad ones, in @buckets equal ranges starting at the lowest erase counter.
+ * The width of a range is returned in @st->bucket_ec.
+ */
+void ubi_wl_wear_stats(struct ubi_device *ubi, struct ubi_wear_stats *st,
+		       unsigned int *hist, int buckets)
+{
+	struct ubi_wl_entry *e;
+	unsigned long long sum = 0;
+	int pnum, min_ec = INT_MAX, max_ec = 0, pebs = 0;
+
+	memset(st, 0, sizeof(*st));
+	if (hist)
+		memset(hist, 0, buckets * sizeof(*hist));
+
+	spin_lock(&ubi->wl_lock);
+	for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+		e = ubi->lookuptbl[pnum];
+		if (!e)
+			continue;
+		min_ec = min(min_ec, e->ec);
+		max_ec = max(max_ec, e->ec);
+		sum += e->ec;
+		pebs += 1;
+	}
+
+	if (pebs) {
+		st->min_ec = min_ec;
+		st->max_ec = max_ec;
+		st->mean_ec = div_u64(sum, pebs);
+		st->pebs = pebs;
+		if (hist && buckets > 0) {
+			st->bucket_ec = DIV_ROUND_UP(max_ec - min_ec + 1,
+						     buckets);
+			for (pnum = 0; pnum < ubi->peb_count; pnum++) {
+				e = ubi->lookuptbl[pnum];
+				if (e)
+					hist[(e->ec - min_ec) / st->bucket_ec]++;
+			}
+		}
+	}
+
+	st->moves = ubi->wl_stats.moves;
+	st->scrubs = ubi->wl_stats.scrubs;
+	st->copied_bytes = ubi->wl_stats.copied_bytes;
+	st->work_ms = ubi->wl_stats.work_ticks * portTICK_PERIOD_MS;
+	spin_unlock(&ubi->wl_lock);
+}
+#endif
+
 /**
  * ubi_wl_flush - flush all pending works.
  * @ubi: UBI device description object
@@ -1358,7 +1531,7 @@ int ubi_wl_flush(struct ubi_device *ubi, int vol_id, int lnum)
 				ubi_assert(ubi->works_count >= 0);
 				spin_unlock(&ubi->wl_lock);
 
-				err = wrk->func(ubi, wrk, 0);
+				err = call_work(ubi, wrk);
 				if (err) {
 					up_read(&ubi->work_sem);
 					return err;
@@ -1383,6 +1556,75 @@ int ubi_wl_flush(struct ubi_device *ubi, int vol_id, int lnum)
 	return err;
 }
 
+#ifdef CONFIG_MTD_UBI_ERASED_RESERVE
+/**
+ * erased_peb_count - count erased PEBs ready to be handed out.
+ * @ubi: UBI device description object
+ *
+ * Counts the PEBs in the free tree and, with fastmap, the not yet used PEBs
+ * of the user pool. Must be called with @ubi->wl_lock held.
+ */
+static int erased_peb_count(struct ubi_device *ubi)
+{
+	int count = ubi->free_count;
+
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	count += ubi->fm_pool.size - ubi->fm_pool.used;
+#endif
+	return count;
+}
+
+/**
+ * ubi_wl_bg_pending - check whether background work is pending.
+ * @ubi: UBI device description object
+ * @urgent: only report works needed to refill the erased PEB reserve
+ *
+ * In U-Boot there is no background thread, so erasures and wear-leveling
+ * moves are queued and run by the caller of ubi_wl_bg_work() in its idle
+ * time. This function returns non-zero if such a work is pending and, if
+ * @urgent is set, fewer than %CONFIG_MTD_UBI_ERASED_RESERVE erased PEBs are
+ * left.
+ */
+int ubi_wl_bg_pending(struct ubi_device *ubi, int urgent)
+{
+	int pending;
+
+	spin_lock(&ubi->wl_lock);
+	pending = ubi->works_count &&
+		  (!urgent ||
+		   erased_peb_count(ubi) < CONFIG_MTD_UBI_ERASED_RESERVE);
+	spin_unlock(&ubi->wl_lock);
+
+	return pending;
+}
+
+/**
+ * ubi_wl_bg_work - do one pending work in the background.
+ * @ubi: UBI device description object
+ * @urgent: only work if the erased PEB reserve is short
+ *
+ * This function returns %1 if a work was done, %0 if there was nothing to do
+ * and a negative error code in case of failure.
+ */
+int ubi_wl_bg_work(struct ubi_device *ubi, int urgent)
+{
+	int err;
+
+	if (!ubi_wl_bg_pending(ubi, urgent))
+		return 0;
+
+	err = do_work(ubi);
+	if (err) {
+		ubi_err(ubi, "%s: work failed with error code %d",
+			ubi->bgt_name, err);
+		return err;
+	}
+	ubi_wl_stat_inc(ubi, bg_works);
+
+	return 1;
+}
+#endif
+
 /**
  * tree_destroy - destroy an RB-tree.
  * @ubi: UBI device description object
@@ -1803,6 +2045,7 @@ static int produce_free_peb(struct ubi_device *ubi)
 		spin_lock(&ubi->wl_lock);
 		if (err)
 			return err;
+		ubi_wl_stat_inc(ubi, sync_works);
 	}
 
 	return 0;
@@ -1832,6 +2075,7 @@ retry:
 			return -ENOSPC;
 		}
 
+		ubi_wl_stat_inc(ubi, waits);
 		err = produce_free_peb(ubi);
 		if (err < 0) {
 			spin_unlock(&ubi->wl_lock);
@@ -1844,6 +2088,7 @@ retry:
 	}
 	e = wl_get_wle(ubi);
 	prot_queue_add(ubi, e);
+	ubi_wl_stat_inc(ubi, gets);
 	spin_unlock(&ubi->wl_lock);
 
 	err = ubi_self_check_all_ff(ubi, e->pnum, ubi->vid_hdr_aloffset,
@@ -31,4 +31,10 @@ static struct ubi_wl_entry *may_reserve_for_fm(struct ubi_device *ubi,
 	return e;
 }
 #endif /* CONFIG_MTD_UBI_FASTMAP */
+
+#ifdef __ZPL_BUILD__
+#define ubi_wl_stat_inc(ubi, field)	((ubi)->wl_stats.field++)
+#else
+#define ubi_wl_stat_inc(ubi, field)	do { } while (0)
+#endif
 #endif /* UBI_WL_H */
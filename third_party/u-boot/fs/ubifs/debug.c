@@ -215,6 +215,8 @@ const char *dbg_jhead(int jhead)
 		return "1 (base)";
 	case DATAHD:
 		return "2 (data)";
+	case HOTHD:
+		return "3 (hot data)";
 	default:
 		return "unknown journal head";
 	}
@@ -29,6 +29,116 @@
 #include <linux/sort.h>
 #include "ubifs.h"
 
+#ifdef CONFIG_UBIFS_GC_COST_BENEFIT
+/* Pick GC victims by cost-benefit rather than by free + dirty space only */
+static int gc_cost_benefit = 1;
+
+/* Bytes read at the end of an LEB to find its last nodes */
+#define LEB_STAMP_BUF_SZ(c) (UBIFS_MAX_NODE_SZ + (c)->min_io_size)
+
+/**
+ * leb_stamp - get the age stamp of an LEB.
+ * @c: the UBIFS file-system description object
+ * @lp: LEB properties
+ * @buf: buffer of %LEB_STAMP_BUF_SZ bytes, allocated on first use
+ *
+ * Stamps live in RAM only, so after a mount they are unknown until the LEB
+ * is written to. An unknown stamp is then taken from the newest node among
+ * those ending in the last %UBIFS_MAX_NODE_SZ bytes written to the LEB,
+ * i.e. the age of the data appended to it last. That costs one read of a
+ * few pages per LEB and mount. An LEB whose last nodes cannot be read is
+ * taken as just written.
+ */
+static unsigned long long leb_stamp(struct ubifs_info *c,
+				    const struct ubifs_lprops *lp, void **buf)
+{
+	unsigned long long sqnum = 0;
+	const struct ubifs_ch *ch;
+	int end, offs, len, pos, node_len;
+
+	if (c->leb_stamp[lp->lnum])
+		return c->leb_stamp[lp->lnum];
+
+	end = c->leb_size - lp->free;
+	offs = max_t(int, end - UBIFS_MAX_NODE_SZ, 0) & ~(c->min_io_size - 1);
+	len = end - offs;
+	if (!*buf)
+		*buf = kmalloc(LEB_STAMP_BUF_SZ(c), GFP_NOFS);
+	if (len > 0 && *buf && !ubifs_leb_read(c, lp->lnum, *buf, offs, len, 0)) {
+		/* Nodes are 8-byte aligned, the first one may start anywhere */
+		for (pos = 0; pos + UBIFS_CH_SZ <= len; pos += 8) {
+			ch = *buf + pos;
+			if (le32_to_cpu(ch->magic) != UBIFS_NODE_MAGIC)
+				continue;
+			node_len = le32_to_cpu(ch->len);
+			if (node_len < UBIFS_CH_SZ || pos + node_len > len ||
+			    ubifs_check_node(c, ch, lp->lnum, offs + pos, 1, 1))
+				continue;
+			if (le64_to_cpu(ch->sqnum) > sqnum)
+				sqnum = le64_to_cpu(ch->sqnum);
+			pos += ALIGN(node_len, 8) - 8;
+		}
+	}
+	if (!sqnum)
+		sqnum = c->max_sqnum;
+
+	c->leb_stamp[lp->lnum] = sqnum;
+	return sqnum;
+}
+
+/**
+ * ubifs_gc_set_cost_benefit - select the GC victim selection policy.
+ * @on: non-zero for cost-benefit, zero for the greedy policy
+ */
+void ubifs_gc_set_cost_benefit(int on)
+{
+	gc_cost_benefit = on;
+}
+
+/**
+ * pick_cost_benefit - pick the dirty LEB it pays most to garbage-collect.
+ * @c: the UBIFS file-system description object
+ * @heap: the dirty LEB heap
+ * @min_space: minimum amount free plus dirty space the LEB has to have
+ *
+ * The greedy policy takes the LEB with the most free + dirty space, even if
+ * its remaining data is hot and would become dirty by itself soon. This
+ * function scores the LEBs of @heap as in the log-structured file-system,
+ * benefit / cost = (1 - u) * age / (1 + u), where u is the used fraction of
+ * the LEB and age is how many sequence numbers ago its newest node was
+ * written, see 'leb_stamp()' for LEBs not written since the mount. Cold LEBs
+ * are thus collected at a higher utilization than hot ones. Returns the LEB
+ * with the best score or %NULL if none has @min_space.
+ */
+static const struct ubifs_lprops *pick_cost_benefit(struct ubifs_info *c,
+						    struct ubifs_lpt_heap *heap,
+						    int min_space)
+{
+	const struct ubifs_lprops *lp, *best = NULL;
+	unsigned long long score, best_score = 0;
+	unsigned long long now = c->max_sqnum;
+	void *buf = NULL;
+	int i, space;
+
+	for (i = 0; i < heap->cnt; i++) {
+		lp = heap->arr[i];
+		space = lp->free + lp->dirty;
+		if (space < min_space)
+			continue;
+
+		score = div_u64((u64)space * (now - leb_stamp(c, lp, &buf)),
+				2 * c->leb_size - space);
+		if (!best || score > best_score) {
+			best = lp;
+			best_score = score;
+		}
+	}
+
+	kfree(buf);
+	return best;
+}
+#endif
+
 /**
  * struct scan_data - data provided to scan callback functions
  * @min_space: minimum number of bytes for which to scan
@@ -305,6 +415,10 @@ int ubifs_find_dirty_leb(struct ubifs_info *c, struct ubifs_lprops *ret_lp,
 		lp = heap->arr[0];
 		if (lp->dirty + lp->free < min_space)
 			lp = NULL;
+#ifdef CONFIG_UBIFS_GC_COST_BENEFIT
+		else if (gc_cost_benefit)
+			lp = pick_cost_benefit(c, heap, min_space);
+#endif
 	}
 
 	/* Pick the LEB with most space */
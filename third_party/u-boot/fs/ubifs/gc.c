@@ -63,6 +63,38 @@
 #define SOFT_LEBS_LIMIT 4
 #define HARD_LEBS_LIMIT 32
 
+#ifdef __ZPL_BUILD__
+/* Bytes of nodes moved by GC since boot */
+static unsigned long long gc_moved_bytes;
+
+/**
+ * ubifs_gc_moved_bytes - return how many bytes of nodes GC has moved so far.
+ */
+unsigned long long ubifs_gc_moved_bytes(void)
+{
+	return gc_moved_bytes;
+}
+#endif
+
+#ifdef CONFIG_UBIFS_BG_GC_LEBS
+/* Set while background GC runs, tells it to give way to foreground work */
+static int (*gc_yield)(void);
+
+/**
+ * gc_should_yield - check whether background GC has to stop moving nodes.
+ * @c: UBIFS file-system description object
+ *
+ * Background GC may stop between two nodes as long as the GC head has not
+ * been switched to @c->gc_lnum, so that an LEB stays reserved for GC.
+ */
+static int gc_should_yield(struct ubifs_info *c)
+{
+	return gc_yield && c->gc_lnum != -1 && gc_yield();
+}
+#else
+#define gc_should_yield(c) 0
+#endif
+
 /**
  * switch_gc_head - switch the garbage collection journal head.
  * @c: UBIFS file-system description object
@@ -325,6 +357,9 @@ static int move_node(struct ubifs_info *c, struct ubifs_scan_leb *sleb,
 	err = ubifs_wbuf_write_nolock(wbuf, snod->node, snod->len);
 	if (err)
 		return err;
+#ifdef __ZPL_BUILD__
+	gc_moved_bytes += snod->len;
+#endif
 
 	err = ubifs_tnc_replace(c, &snod->key, sleb->lnum,
 				snod->offs, new_lnum, new_offs,
@@ -379,6 +414,10 @@ static int move_nodes(struct ubifs_info *c, struct ubifs_scan_leb *sleb)
 				 */
 				break;
 
+			if (gc_should_yield(c)) {
+				err = -EINTR;
+				goto out;
+			}
 			err = move_node(c, sleb, snod, wbuf);
 			if (err)
 				goto out;
@@ -404,6 +443,10 @@ static int move_nodes(struct ubifs_info *c, struct ubifs_scan_leb *sleb)
 				continue;
 			}
 
+			if (gc_should_yield(c)) {
+				err = -EINTR;
+				goto out;
+			}
 			err = move_node(c, sleb, snod, wbuf);
 			if (err)
 				goto out;
@@ -511,7 +554,13 @@ int ubifs_garbage_collect_leb(struct ubifs_info *c, struct ubifs_lprops *lp)
 	 * We scan the entire LEB even though we only really need to scan up to
 	 * (c->leb_size - lp->free).
 	 */
-	sleb = ubifs_scan(c, lnum, 0, c->sbuf, 0);
+#ifdef CONFIG_UBIFS_BG_GC_LEBS
+	/* Reading the LEB takes long, background GC may give way meanwhile */
+	if (gc_yield && c->gc_lnum != -1)
+		sleb = ubifs_scan_yield(c, lnum, c->sbuf, 0, gc_yield);
+	else
+#endif
+		sleb = ubifs_scan(c, lnum, 0, c->sbuf, 0);
 	if (IS_ERR(sleb))
 		return PTR_ERR(sleb);
 
@@ -823,6 +872,95 @@ out:
 	return ret;
 }
 
+#ifdef CONFIG_UBIFS_BG_GC_LEBS
+/**
+ * ubifs_bg_garbage_collect - garbage-collect one LEB while the system is idle.
+ * @c: UBIFS file-system description object
+ * @target: do nothing once this many LEBs are empty
+ * @yield: returns non-zero when foreground work is waiting, may be %NULL
+ *
+ * Unlike 'ubifs_garbage_collect()', which runs when budgeting runs out of
+ * space, this function is meant to be called in idle time to keep free LEBs
+ * around, so that a write rarely has to wait for GC. Only LEBs with at least
+ * half of their space free or dirty are collected, so it never moves more
+ * data than it frees.
+ *
+ * @yield is checked between the reads of the LEB scan and before every node
+ * move. If it returns non-zero, the nodes moved so far are written out and
+ * the LEB is returned to lprops, with its dirty space grown by what was
+ * moved; the next call picks it up again.
+ *
+ * Returns %1 if an LEB was collected, %0 if there is nothing to do, %-EINTR if
+ * @yield stopped the collection and other negative error codes in case of
+ * failure.
+ */
+int ubifs_bg_garbage_collect(struct ubifs_info *c, int target,
+			     int (*yield)(void))
+{
+	int ret, err, empty;
+	struct ubifs_lprops lp;
+	struct ubifs_wbuf *wbuf = &c->jheads[GCHD].wbuf;
+
+	if (c->ro_media || c->ro_mount || c->ro_error)
+		return 0;
+
+	spin_lock(&c->space_lock);
+	empty = c->lst.empty_lebs - c->lst.taken_empty_lebs;
+	spin_unlock(&c->space_lock);
+	if (empty >= target)
+		return 0;
+
+	/* Leave it to the foreground GC, which can run the commit */
+	if (ubifs_gc_should_commit(c))
+		return 0;
+
+	mutex_lock_nested(&wbuf->io_mutex, wbuf->jhead);
+	ubifs_assert(!wbuf->used);
+
+	ret = ubifs_find_dirty_leb(c, &lp, c->half_leb_size, 0);
+	if (ret) {
+		mutex_unlock(&wbuf->io_mutex);
+		return ret == -ENOSPC ? 0 : ret;
+	}
+
+	dbg_gc("idle, found LEB %d: free %d, dirty %d", lp.lnum, lp.free,
+	       lp.dirty);
+
+	gc_yield = yield;
+	ret = ubifs_garbage_collect_leb(c, &lp);
+	gc_yield = NULL;
+
+	if (ret == -EINTR || ret == -EAGAIN) {
+		/* Not an error, the LEB goes back to lprops as it is now */
+		err = ubifs_return_leb(c, lp.lnum);
+		if (err)
+			ret = err;
+	} else if (ret < 0)
+		goto out;
+	else
+		ret = 1;
+
+	err = ubifs_wbuf_sync_nolock(wbuf);
+	if (!err)
+		err = ubifs_leb_unmap(c, c->gc_lnum);
+	if (err) {
+		ret = err;
+		goto out;
+	}
+	mutex_unlock(&wbuf->io_mutex);
+
+	/* On -EAGAIN the journal is full, the next write runs the commit */
+	return ret == -EAGAIN ? 0 : ret;
+
+out:
+	ubifs_wbuf_sync_nolock(wbuf);
+	ubifs_ro_mode(c, ret);
+	mutex_unlock(&wbuf->io_mutex);
+	ubifs_return_leb(c, lp.lnum);
+	return ret;
+}
+#endif
+
 /**
  * ubifs_gc_start_commit - garbage collection at start of commit.
  * @c: UBIFS file-system description object
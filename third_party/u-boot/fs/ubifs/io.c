@@ -170,6 +170,9 @@ int ubifs_leb_unmap(struct ubifs_info *c, int lnum)
 #ifndef __UBOOT__
 	else
 		err = dbg_leb_unmap(c, lnum);
+#endif
+#ifdef CONFIG_UBIFS_GC_COST_BENEFIT
+	c->leb_stamp[lnum] = 0;
 #endif
 	if (err) {
 		ubifs_err(c, "unmap LEB %d failed, error %d", lnum, err);
@@ -692,6 +695,9 @@ int ubifs_wbuf_write_nolock(struct ubifs_wbuf *wbuf, void *buf, int len)
 	       dbg_ntype(((struct ubifs_ch *)buf)->node_type),
 	       dbg_jhead(wbuf->jhead), wbuf->lnum, wbuf->offs + wbuf->used);
 	ubifs_assert(len > 0 && wbuf->lnum >= 0 && wbuf->lnum < c->leb_cnt);
+#ifdef CONFIG_UBIFS_GC_COST_BENEFIT
+	ubifs_stamp_leb(c, wbuf->lnum, buf);
+#endif
 	ubifs_assert(wbuf->offs >= 0 && wbuf->offs % c->min_io_size == 0);
 	ubifs_assert(!(wbuf->offs & 7) && wbuf->offs <= c->leb_size);
 	ubifs_assert(wbuf->avail > 0 && wbuf->avail <= wbuf->size);
@@ -711,7 +711,7 @@ int ubifs_jnl_write_data(struct ubifs_info *c, const struct inode *inode,
 {
 	struct ubifs_data_node *data;
 	int err, lnum, offs, compr_type, out_len, compr_len;
-	int dlen = COMPRESSED_DATA_NODE_BUF_SZ, allocated = 1;
+	int dlen = COMPRESSED_DATA_NODE_BUF_SZ, allocated = 1, jhead = DATAHD;
 	struct ubifs_inode *ui = ubifs_inode(inode);
 	bool encrypted = ubifs_crypt_is_encrypted(inode);
 
@@ -763,16 +763,22 @@ int ubifs_jnl_write_data(struct ubifs_info *c, const struct inode *inode,
 	dlen = UBIFS_DATA_NODE_SZ + out_len;
 	data->compr_type = cpu_to_le16(compr_type);
 
+#ifdef CONFIG_UBIFS_HOT_JHEAD
+	/* Keep often rewritten data out of the LEBs holding long-lived data */
+	if ((ui->flags & UBIFS_HOT_FL) && c->jhead_cnt > HOTHD)
+		jhead = HOTHD;
+#endif
+
 	/* Make reservation before allocating sequence numbers */
-	err = make_reservation(c, DATAHD, dlen);
+	err = make_reservation(c, jhead, dlen);
 	if (err)
 		goto out_free;
 
-	err = write_node(c, DATAHD, data, dlen, &lnum, &offs);
+	err = write_node(c, jhead, data, dlen, &lnum, &offs);
 	if (err)
 		goto out_release;
-	ubifs_wbuf_add_ino_nolock(&c->jheads[DATAHD].wbuf, key_inum(c, key));
-	release_head(c, DATAHD);
+	ubifs_wbuf_add_ino_nolock(&c->jheads[jhead].wbuf, key_inum(c, key));
+	release_head(c, jhead);
 
 	err = ubifs_tnc_add(c, key, lnum, offs, dlen);
 	if (err)
@@ -786,7 +792,7 @@ int ubifs_jnl_write_data(struct ubifs_info *c, const struct inode *inode,
 	return 0;
 
 out_release:
-	release_head(c, DATAHD);
+	release_head(c, jhead);
 out_ro:
 	ubifs_ro_mode(c, err);
 	finish_reservation(c);
@@ -169,6 +169,27 @@ static inline int ubifs_add_dirt(struct ubifs_info *c, int lnum, int dirty)
 	return ubifs_update_one_lp(c, lnum, LPROPS_NC, dirty, 0, 0);
 }
 
+#ifdef CONFIG_UBIFS_GC_COST_BENEFIT
+/**
+ * ubifs_stamp_leb - remember the age of the newest data in an LEB.
+ * @c: the UBIFS file-system description object
+ * @lnum: LEB the node is written to
+ * @node: the node
+ *
+ * The stamp is the sequence number of @node rather than the current one, so
+ * that nodes moved by GC keep the age of the data they hold.
+ */
+static inline void ubifs_stamp_leb(struct ubifs_info *c, int lnum,
+				   const void *node)
+{
+	const struct ubifs_ch *ch = node;
+	unsigned long long sqnum = le64_to_cpu(ch->sqnum);
+
+	if (sqnum > c->leb_stamp[lnum])
+		c->leb_stamp[lnum] = sqnum;
+}
+#endif
+
 /**
  * ubifs_return_leb - return LEB to lprops.
  * @c: the UBIFS file-system description object
@@ -0,0 +1,619 @@
+/*
+ * This file is part of UBIFS.
+ *
+ * Page cache for the U-Boot/ZPL port.
+ *
+ * SPDX-License-Identifier:	GPL-2.0
+ */
+
+/*
+ * U-Boot has no VFS page cache, so without this file every read of a data
+ * block decompresses it from flash and every write goes straight to the
+ * journal. This file keeps a bounded set of decompressed data blocks, keyed
+ * by inode number and block index, on an LRU list.
+ *
+ * In write-through mode a written block is journaled at once and the cached
+ * copy only serves later reads. In write-back mode a written block is only
+ * marked dirty, and size changes of the inode are held back as well. Dirty
+ * blocks go to the journal when the inode is flushed: on eviction, when they
+ * get older than CONFIG_UBIFS_PCACHE_DIRTY_AGE_MS, on an explicit sync and at
+ * unmount. A flush writes all dirty blocks of the inode through the normal
+ * journal path first and the inode with its new size last, the same order
+ * Linux write-back uses. After a power cut the file therefore never claims
+ * data that was not written.
+ */
+
+#ifndef __ZPL_BUILD__
+#include <common.h>
+#include "ubifs.h"
+#else /* __ZPL_BUILD__ */
+#include "zplCompat.h"
+#include "ubifs.h"
+#include "task.h"
+#endif /* __ZPL_BUILD__ */
+
+/* Number of inodes that can have a size change held back at once */
+#define PCACHE_MAX_SIZES 8
+
+/**
+ * struct pcache_page - a cached data block.
+ * @list: link in the LRU list, most recently used first
+ * @inum: inode number, zero if the page is unused
+ * @block: block index in the inode
+ * @len: number of valid bytes, as in the data node
+ * @dirty: non-zero if not yet written to the journal
+ * @dirtied: tick count when the page became dirty
+ * @data: block contents
+ */
+struct pcache_page {
+	struct list_head list;
+	ino_t inum;
+	unsigned int block;
+	int len;
+	int dirty;
+	TickType_t dirtied;
+	void *data;
+};
+
+/**
+ * struct pcache_size - inode size not yet written to the journal.
+ * @inum: inode number, zero if the slot is unused
+ * @size: new inode size
+ * @dirtied: tick count when the size was first held back
+ */
+struct pcache_size {
+	ino_t inum;
+	loff_t size;
+	TickType_t dirtied;
+};
+
+static LIST_HEAD(pcache_lru);
+static struct pcache_page *pcache_pages;
+static void *pcache_data;
+static int pcache_cnt;
+static struct pcache_size pcache_sizes[PCACHE_MAX_SIZES];
+
+static struct pcache_page *find_page(ino_t inum, unsigned int block)
+{
+	struct pcache_page *p;
+
+	list_for_each_entry(p, &pcache_lru, list) {
+		if (!p->inum)
+			/* Unused pages sit at the tail */
+			break;
+		if (p->inum == inum && p->block == block)
+			return p;
+	}
+	return NULL;
+}
+
+static struct pcache_size *find_size(ino_t inum)
+{
+	int i;
+
+	for (i = 0; i < PCACHE_MAX_SIZES; i++)
+		if (pcache_sizes[i].inum == inum)
+			return &pcache_sizes[i];
+	return NULL;
+}
+
+static void drop_page(struct pcache_page *p)
+{
+	p->inum = 0;
+	p->dirty = 0;
+	list_move_tail(&p->list, &pcache_lru);
+}
+
+/**
+ * release_new_page_budget - release budget of a new page.
+ * @c: UBIFS file-system description object
+ *
+ * This is a helper function which releases budget corresponding to the budget
+ * of one new page of data.
+ */
+static void release_new_page_budget(struct ubifs_info *c)
+{
+	struct ubifs_budget_req req = { .recalculate = 1, .new_page = 1 };
+
+	ubifs_release_budget(c, &req);
+}
+
+/**
+ * write_block - write one data block of an inode to the journal.
+ * @c: UBIFS file-system description object
+ * @inode: inode the block belongs to
+ * @block: block number
+ * @addr: block data
+ * @len: number of valid bytes in the block
+ *
+ * Returns zero in case of success and a negative error code in case of
+ * failure.
+ */
+static int write_block(struct ubifs_info *c, struct inode *inode,
+		       unsigned int block, const void *addr, int len)
+{
+	int err;
+	union ubifs_key key;
+	struct ubifs_budget_req req = { .recalculate = 1, .new_page = 1 };
+
+	err = ubifs_budget_space(c, &req);
+	if (unlikely(err))
+		return err;
+
+	data_key_init(c, &key, inode->i_ino, block);
+	err = ubifs_jnl_write_data(c, inode, &key, addr, len);
+	if (err) {
+		ubifs_err(c, "cannot write block %u of inode %lu, error %d",
+			  block, inode->i_ino, err);
+		ubifs_ro_mode(c, err);
+	}
+	release_new_page_budget(c);
+	return err;
+}
+
+/**
+ * get_page - get the page of a block, reusing the least recently used one.
+ * @c: UBIFS file-system description object
+ * @inum: inode number
+ * @block: block index
+ * @evict_dirty: whether a dirty page may be flushed to make room
+ *
+ * The page returned is at the head of the LRU list. A page taken over from
+ * another block has @len zero. Returns %NULL if no page can be had, or an
+ * ERR_PTR if flushing the evicted page failed.
+ */
+static struct pcache_page *get_page(struct ubifs_info *c, ino_t inum,
+				    unsigned int block, int evict_dirty)
+{
+	struct pcache_page *p;
+	int err;
+
+	p = find_page(inum, block);
+	if (!p) {
+		p = list_entry(pcache_lru.prev, struct pcache_page, list);
+		if (p->dirty) {
+			if (!evict_dirty)
+				return NULL;
+			err = ubifs_pcache_flush(c, p->inum);
+			if (err)
+				return ERR_PTR(err);
+		}
+		p->inum = inum;
+		p->block = block;
+		p->len = 0;
+		p->dirty = 0;
+	}
+	list_move(&p->list, &pcache_lru);
+	return p;
+}
+
+/**
+ * ubifs_pcache_init - allocate the page cache.
+ * @c: UBIFS file-system description object
+ *
+ * If the memory cannot be had the cache is disabled and every access goes to
+ * flash, like bulk-read does.
+ */
+void ubifs_pcache_init(struct ubifs_info *c)
+{
+	int i;
+
+	ubifs_pcache_destroy(c);
+	if (CONFIG_UBIFS_PCACHE_PAGES <= 0)
+		return;
+
+	pcache_pages = kzalloc(CONFIG_UBIFS_PCACHE_PAGES *
+			       sizeof(struct pcache_page), GFP_KERNEL);
+	pcache_data = malloc_cache_aligned(CONFIG_UBIFS_PCACHE_PAGES *
+					   UBIFS_BLOCK_SIZE);
+	if (!pcache_pages || !pcache_data) {
+		ubifs_warn(c, "cannot allocate %d pages for the page cache, disabling it",
+			   CONFIG_UBIFS_PCACHE_PAGES);
+		ubifs_pcache_destroy(c);
+		return;
+	}
+
+	for (i = 0; i < CONFIG_UBIFS_PCACHE_PAGES; i++) {
+		pcache_pages[i].data = pcache_data + i * UBIFS_BLOCK_SIZE;
+		list_add_tail(&pcache_pages[i].list, &pcache_lru);
+	}
+	pcache_cnt = CONFIG_UBIFS_PCACHE_PAGES;
+}
+
+/**
+ * ubifs_pcache_destroy - free the page cache, dropping anything dirty.
+ * @c: UBIFS file-system description object
+ */
+void ubifs_pcache_destroy(struct ubifs_info *c)
+{
+	INIT_LIST_HEAD(&pcache_lru);
+	memset(pcache_sizes, 0, sizeof(pcache_sizes));
+	kfree(pcache_pages);
+	kfree(pcache_data);
+	pcache_pages = NULL;
+	pcache_data = NULL;
+	pcache_cnt = 0;
+}
+
+/**
+ * ubifs_pcache_writeback - check whether writes are held back.
+ */
+int ubifs_pcache_writeback(void)
+{
+	return pcache_cnt && CONFIG_UBIFS_PCACHE_WRITEBACK;
+}
+
+/**
+ * ubifs_pcache_read - read a block from the page cache.
+ * @inum: inode number
+ * @block: block index
+ * @addr: where to put the block, %UBIFS_BLOCK_SIZE bytes
+ *
+ * Returns zero on a hit and %-ENOENT if the block is not cached.
+ */
+int ubifs_pcache_read(ino_t inum, unsigned int block, void *addr)
+{
+	struct pcache_page *p;
+
+	if (!pcache_cnt)
+		return -ENOENT;
+
+	p = find_page(inum, block);
+	if (!p)
+		return -ENOENT;
+
+	memcpy(addr, p->data, p->len);
+	if (p->len < UBIFS_BLOCK_SIZE)
+		memset(addr + p->len, 0, UBIFS_BLOCK_SIZE - p->len);
+	list_move(&p->list, &pcache_lru);
+	return 0;
+}
+
+/**
+ * ubifs_pcache_fill - add a block just read from flash.
+ * @c: UBIFS file-system description object
+ * @inum: inode number
+ * @block: block index
+ * @addr: block contents
+ * @len: number of valid bytes
+ *
+ * Reads never force dirty pages out, so the block is simply not cached if the
+ * least recently used page is dirty.
+ */
+void ubifs_pcache_fill(struct ubifs_info *c, ino_t inum, unsigned int block,
+		       const void *addr, int len)
+{
+	struct pcache_page *p;
+
+	if (!pcache_cnt)
+		return;
+
+	p = get_page(c, inum, block, 0);
+	if (IS_ERR_OR_NULL(p) || p->dirty)
+		return;
+	memcpy(p->data, addr, len);
+	p->len = len;
+}
+
+/**
+ * ubifs_pcache_write - write a data block through the page cache.
+ * @c: UBIFS file-system description object
+ * @inode: inode the block belongs to
+ * @block: block index
+ * @addr: block contents
+ * @len: number of valid bytes
+ *
+ * In write-back mode the block is only cached and marked dirty, otherwise it
+ * is written to the journal and the cached copy is updated. Returns zero in
+ * case of success and a negative error code in case of failure.
+ */
+int ubifs_pcache_write(struct ubifs_info *c, struct inode *inode,
+		       unsigned int block, const void *addr, int len)
+{
+	struct pcache_page *p;
+	int err;
+
+	if (!pcache_cnt)
+		return write_block(c, inode, block, addr, len);
+
+	if (!CONFIG_UBIFS_PCACHE_WRITEBACK) {
+		err = write_block(c, inode, block, addr, len);
+		p = find_page(inode->i_ino, block);
+		if (err) {
+			if (p)
+				drop_page(p);
+			return err;
+		}
+		ubifs_pcache_fill(c, inode->i_ino, block, addr, len);
+		return 0;
+	}
+
+	p = get_page(c, inode->i_ino, block, 1);
+	if (IS_ERR(p))
+		return PTR_ERR(p);
+	memcpy(p->data, addr, len);
+	p->len = len;
+	if (!p->dirty) {
+		p->dirty = 1;
+		p->dirtied = xTaskGetTickCount();
+	}
+	return 0;
+}
+
+/**
+ * ubifs_pcache_write_uncached - write a block to the journal, bypassing the cache.
+ * @c: UBIFS file-system description object
+ * @inode: inode the block belongs to
+ * @block: block index
+ * @addr: block contents
+ * @len: number of valid bytes
+ *
+ * For data that is streamed to flash once and would otherwise push everything
+ * else out of the cache. A cached copy of the block is dropped. Returns zero
+ * in case of success and a negative error code in case of failure.
+ */
+int ubifs_pcache_write_uncached(struct ubifs_info *c, struct inode *inode,
+				unsigned int block, const void *addr, int len)
+{
+	struct pcache_page *p;
+
+	if (pcache_cnt) {
+		p = find_page(inode->i_ino, block);
+		if (p)
+			drop_page(p);
+	}
+	return write_block(c, inode, block, addr, len);
+}
+
+/**
+ * ubifs_pcache_uncached - count blocks not in the page cache.
+ * @inum: inode number
+ * @block: first block index
+ * @nblk: number of blocks to look at
+ *
+ * Returns how many blocks starting at @block are not cached, so that a
+ * bulk-read of them cannot hide newer data held in the cache.
+ */
+int ubifs_pcache_uncached(ino_t inum, unsigned int block, int nblk)
+{
+	int n;
+
+	if (!pcache_cnt)
+		return nblk;
+
+	for (n = 0; n < nblk; n++)
+		if (find_page(inum, block + n))
+			break;
+	return n;
+}
+
+/**
+ * ubifs_pcache_size - get the size of an inode including held back changes.
+ * @inum: inode number
+ * @size: inode size on flash
+ */
+loff_t ubifs_pcache_size(ino_t inum, loff_t size)
+{
+	struct pcache_size *s = find_size(inum);
+
+	if (s && s->size > size)
+		return s->size;
+	return size;
+}
+
+/**
+ * ubifs_pcache_set_size - record a new inode size.
+ * @c: UBIFS file-system description object
+ * @inode: inode whose @i_size changed
+ *
+ * In write-back mode the size is held back until the inode is flushed,
+ * otherwise the inode is written to the journal at once. Returns zero in case
+ * of success and a negative error code in case of failure.
+ */
+int ubifs_pcache_set_size(struct ubifs_info *c, struct inode *inode)
+{
+	struct pcache_size *s;
+	int err;
+
+	if (!ubifs_pcache_writeback())
+		return ubifs_jnl_write_inode(c, inode);
+
+	s = find_size(inode->i_ino);
+	if (!s) {
+		s = find_size(0);
+		if (!s) {
+			/* All slots taken, flush the first one to free it */
+			s = &pcache_sizes[0];
+			err = ubifs_pcache_flush(c, s->inum);
+			if (err)
+				return err;
+		}
+		s->inum = inode->i_ino;
+		s->dirtied = xTaskGetTickCount();
+	}
+	s->size = inode->i_size;
+	return 0;
+}
+
+/**
+ * ubifs_pcache_forget - drop everything cached for an inode.
+ * @inum: inode number
+ *
+ * Used when the inode is deleted, so dirty data is discarded.
+ */
+void ubifs_pcache_forget(ino_t inum)
+{
+	struct pcache_page *p, *n;
+	struct pcache_size *s;
+
+	if (!pcache_cnt)
+		return;
+
+	list_for_each_entry_safe(p, n, &pcache_lru, list)
+		if (p->inum == inum)
+			drop_page(p);
+	s = find_size(inum);
+	if (s)
+		s->inum = 0;
+}
+
+/**
+ * ubifs_pcache_flush - write the dirty blocks and size of an inode.
+ * @c: UBIFS file-system description object
+ * @inum: inode number
+ *
+ * The volume must be open. Data nodes are written first and the inode last,
+ * then the write-buffers holding them are synchronized. Returns zero in case
+ * of success and a negative error code in case of failure.
+ */
+int ubifs_pcache_flush(struct ubifs_info *c, ino_t inum)
+{
+	struct pcache_page *p;
+	struct pcache_size *s = find_size(inum);
+	struct inode *inode;
+	int dirty = 0, err = 0;
+
+	list_for_each_entry(p, &pcache_lru, list)
+		if (p->inum == inum && p->dirty)
+			dirty = 1;
+	if (!dirty && !s)
+		return 0;
+
+	dbg_gen("ino %lu", inum);
+
+	/* Comes back with any held back size already applied */
+	inode = ubifs_iget(c->vfs_sb, inum);
+	if (IS_ERR(inode)) {
+		ubifs_err(c, "cannot flush inode %lu, error %d",
+			  inum, (int)PTR_ERR(inode));
+		ubifs_pcache_forget(inum);
+		return PTR_ERR(inode);
+	}
+
+	list_for_each_entry(p, &pcache_lru, list) {
+		if (p->inum != inum || !p->dirty)
+			continue;
+		err = write_block(c, inode, p->block, p->data, p->len);
+		if (err)
+			goto out;
+		p->dirty = 0;
+	}
+
+	if (s) {
+		ubifs_inode(inode)->dirty = 1;
+		err = ubifs_jnl_write_inode(c, inode);
+		if (err)
+			goto out;
+		s->inum = 0;
+	}
+
+	err = ubifs_sync_wbufs_by_inode(c, inode);
+out:
+	ubifs_iput(inode);
+	return err;
+}
+
+/**
+ * ubifs_pcache_sync - flush every inode with dirty blocks or size.
+ * @c: UBIFS file-system description object
+ *
+ * The volume must be open. Returns zero in case of success and a negative
+ * error code in case of failure.
+ */
+int ubifs_pcache_sync(struct ubifs_info *c)
+{
+	struct pcache_page *p;
+	int i, err;
+
+	if (!pcache_cnt)
+		return 0;
+
+	list_for_each_entry(p, &pcache_lru, list) {
+		if (p->dirty) {
+			err = ubifs_pcache_flush(c, p->inum);
+			if (err)
+				return err;
+		}
+	}
+	for (i = 0; i < PCACHE_MAX_SIZES; i++) {
+		if (pcache_sizes[i].inum) {
+			err = ubifs_pcache_flush(c, pcache_sizes[i].inum);
+			if (err)
+				return err;
+		}
+	}
+	return 0;
+}
+
+/**
+ * ubifs_pcache_expire - flush inodes holding data older than the maximum age.
+ * @c: UBIFS file-system description object
+ *
+ * The volume must be open. Returns zero in case of success and a negative
+ * error code in case of failure.
+ */
+int ubifs_pcache_expire(struct ubifs_info *c)
+{
+	const TickType_t age = pdMS_TO_TICKS(CONFIG_UBIFS_PCACHE_DIRTY_AGE_MS);
+	TickType_t now = xTaskGetTickCount();
+	struct pcache_page *p;
+	int i, err;
+
+	if (!pcache_cnt)
+		return 0;
+
+	list_for_each_entry(p, &pcache_lru, list) {
+		if (p->dirty && (TickType_t)(now - p->dirtied) >= age) {
+			err = ubifs_pcache_flush(c, p->inum);
+			if (err)
+				return err;
+		}
+	}
+	for (i = 0; i < PCACHE_MAX_SIZES; i++) {
+		if (pcache_sizes[i].inum &&
+		    (TickType_t)(now - pcache_sizes[i].dirtied) >= age) {
+			err = ubifs_pcache_flush(c, pcache_sizes[i].inum);
+			if (err)
+				return err;
+		}
+	}
+	return 0;
+}
+
+/**
+ * ubifs_pcache_next_expiry - time until the oldest held back data expires.
+ *
+ * Returns the number of milliseconds, zero if something has expired already,
+ * or -1 if nothing is held back.
+ */
+long ubifs_pcache_next_expiry(void)
+{
+	const TickType_t age = pdMS_TO_TICKS(CONFIG_UBIFS_PCACHE_DIRTY_AGE_MS);
+	TickType_t now = xTaskGetTickCount();
+	TickType_t oldest = 0;
+	struct pcache_page *p;
+	int i, found = 0;
+
+	if (!pcache_cnt)
+		return -1;
+
+	list_for_each_entry(p, &pcache_lru, list) {
+		if (p->dirty && (!found || (TickType_t)(now - p->dirtied) > oldest)) {
+			oldest = now - p->dirtied;
+			found = 1;
+		}
+	}
+	for (i = 0; i < PCACHE_MAX_SIZES; i++) {
+		if (pcache_sizes[i].inum &&
+		    (!found || (TickType_t)(now - pcache_sizes[i].dirtied) > oldest)) {
+			oldest = now - pcache_sizes[i].dirtied;
+			found = 1;
+		}
+	}
+
+	if (!found)
+		return -1;
+	if (oldest >= age)
+		return 0;
+	return (long)((age - oldest) * portTICK_PERIOD_MS);
+}
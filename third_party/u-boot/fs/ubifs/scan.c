@@ -246,31 +246,22 @@ void ubifs_scanned_corruption(const struct ubifs_info *c, int lnum, int offs,
 }
 
 /**
- * ubifs_scan - scan a logical eraseblock.
+ * scan_nodes - scan the nodes of a logical eraseblock already read.
  * @c: UBIFS file-system description object
+ * @sleb: scanning information, @sleb->buf holds the LEB from @offs on
  * @lnum: logical eraseblock number
- * @offs: offset to start at (usually zero)
- * @sbuf: scan buffer (must be of @c->leb_size bytes in size)
+ * @offs: offset to start at
  * @quiet: print no messages
  *
- * This function scans LEB number @lnum and returns complete information about
- * its contents. Returns the scanned information in case of success and,
- * %-EUCLEAN if the LEB neads recovery, and other negative error codes in case
+ * This is the part of 'ubifs_scan()' after the read. @sleb is freed in case
  * of failure.
- *
- * If @quiet is non-zero, this function does not print large and scary
- * error messages and flash dumps in case of errors.
  */
-struct ubifs_scan_leb *ubifs_scan(const struct ubifs_info *c, int lnum,
-				  int offs, void *sbuf, int quiet)
+static struct ubifs_scan_leb *scan_nodes(const struct ubifs_info *c,
+					 struct ubifs_scan_leb *sleb,
+					 int lnum, int offs, int quiet)
 {
-	void *buf = sbuf + offs;
+	void *buf = sleb->buf + offs;
 	int err, len = c->leb_size - offs;
-	struct ubifs_scan_leb *sleb;
-
-	sleb = ubifs_start_scan(c, lnum, offs, sbuf);
-	if (IS_ERR(sleb))
-		return sleb;
 
 	while (len >= 8) {
 		struct ubifs_ch *ch = buf;
@@ -357,6 +348,86 @@ error:
 	return ERR_PTR(err);
 }
 
+/**
+ * ubifs_scan - scan a logical eraseblock.
+ * @c: UBIFS file-system description object
+ * @lnum: logical eraseblock number
+ * @offs: offset to start at (usually zero)
+ * @sbuf: scan buffer (must be of @c->leb_size bytes in size)
+ * @quiet: print no messages
+ *
+ * This function scans LEB number @lnum and returns complete information about
+ * its contents. Returns the scanned information in case of success and,
+ * %-EUCLEAN if the LEB neads recovery, and other negative error codes in case
+ * of failure.
+ *
+ * If @quiet is non-zero, this function does not print large and scary
+ * error messages and flash dumps in case of errors.
+ */
+struct ubifs_scan_leb *ubifs_scan(const struct ubifs_info *c, int lnum,
+				  int offs, void *sbuf, int quiet)
+{
+	struct ubifs_scan_leb *sleb;
+
+	sleb = ubifs_start_scan(c, lnum, offs, sbuf);
+	if (IS_ERR(sleb))
+		return sleb;
+
+	return scan_nodes(c, sleb, lnum, offs, quiet);
+}
+
+#ifdef CONFIG_UBIFS_BG_GC_LEBS
+/* Min. I/O units read between two checks of the yield callback */
+#define SCAN_YIELD_IOS 8
+
+/**
+ * ubifs_scan_yield - scan a logical eraseblock, giving way to other work.
+ * @c: UBIFS file-system description object
+ * @lnum: logical eraseblock number
+ * @sbuf: scan buffer (must be of @c->leb_size bytes in size)
+ * @quiet: print no messages
+ * @yield: returns non-zero when the scan has to stop
+ *
+ * Same as 'ubifs_scan()' from offset zero, except that the LEB is read
+ * %SCAN_YIELD_IOS min. I/O units at a time and @yield is checked before each
+ * of these reads, so that background work reading a whole LEB does not hold
+ * up a request for longer than one such read. Returns %-EINTR if @yield
+ * stopped the scan.
+ */
+struct ubifs_scan_leb *ubifs_scan_yield(const struct ubifs_info *c, int lnum,
+					void *sbuf, int quiet,
+					int (*yield)(void))
+{
+	struct ubifs_scan_leb *sleb;
+	int err, offs, len;
+
+	for (offs = 0; offs < c->leb_size; offs += len) {
+		if (yield())
+			return ERR_PTR(-EINTR);
+
+		len = min_t(int, c->leb_size - offs,
+			    SCAN_YIELD_IOS * c->min_io_size);
+		err = ubifs_leb_read(c, lnum, sbuf + offs, offs, len, 0);
+		/* Integrity errors are ignored, as in 'ubifs_start_scan()' */
+		if (err && err != -EBADMSG) {
+			ubifs_err(c, "cannot read %d bytes from LEB %d:%d, error %d",
+				  len, lnum, offs, err);
+			return ERR_PTR(err);
+		}
+	}
+
+	sleb = kzalloc(sizeof(struct ubifs_scan_leb), GFP_NOFS);
+	if (!sleb)
+		return ERR_PTR(-ENOMEM);
+
+	sleb->lnum = lnum;
+	INIT_LIST_HEAD(&sleb->nodes);
+	sleb->buf = sbuf;
+
+	return scan_nodes(c, sleb, lnum, 0, quiet);
+}
+#endif
+
 /**
  * ubifs_scan_destroy - destroy LEB scanning information.
  * @sleb: scanning information to free
@@ -323,6 +323,10 @@ struct inode *ubifs_iget(struct super_block *sb, unsigned long inum)
 	ui->xattr_size  = le32_to_cpu(ino->xattr_size);
 	ui->xattr_names = le32_to_cpu(ino->xattr_names);
 	ui->synced_i_size = ui->ui_size = inode->i_size;
+#ifdef __UBOOT__
+	/* Writes held back in the page cache may have grown the file */
+	inode->i_size = ui->ui_size = ubifs_pcache_size(inum, inode->i_size);
+#endif
 
 	ui->xattr = (ui->flags & UBIFS_XATTR_FL) ? 1 : 0;
 
@@ -859,7 +863,13 @@ static int init_constants_sb(struct ubifs_info *c)
 	c->max_idx_node_sz = ALIGN(tmp, 8);
 
 	/* Make sure LEB size is large enough to fit full commit */
+#ifdef CONFIG_UBIFS_HOT_JHEAD
+	/* The hot data head may be added after mount */
+	tmp = UBIFS_CS_NODE_SZ + UBIFS_REF_NODE_SZ *
+	      (NONDATA_JHEADS_CNT + UBIFS_MAX_JHEADS);
+#else
 	tmp = UBIFS_CS_NODE_SZ + UBIFS_REF_NODE_SZ * c->jhead_cnt;
+#endif
 	tmp = ALIGN(tmp, c->min_io_size);
 	if (tmp > c->leb_size) {
 		ubifs_err(c, "too small LEB size %d, at least %d needed",
@@ -912,7 +922,12 @@ static int init_constants_sb(struct ubifs_info *c)
 	 * Consequently, if the journal is too small, UBIFS will treat it as
 	 * always full.
 	 */
+#ifdef CONFIG_UBIFS_HOT_JHEAD
+	tmp64 = (long long)(NONDATA_JHEADS_CNT + UBIFS_MAX_JHEADS + 1) *
+		c->leb_size + 1;
+#else
 	tmp64 = (long long)(c->jhead_cnt + 1) * c->leb_size + 1;
+#endif
 	if (c->bg_bud_bytes < tmp64)
 		c->bg_bud_bytes = tmp64;
 	if (c->max_bud_bytes < tmp64 + c->leb_size)
@@ -983,6 +998,28 @@ static int take_gc_lnum(struct ubifs_info *c)
 	return err;
 }
 
+/**
+ * init_jhead - initialize a journal head and its write-buffer.
+ * @c: UBIFS file-system description object
+ * @i: journal head number
+ *
+ * Returns zero in case of success and %-ENOMEM in case of failure.
+ */
+static int init_jhead(struct ubifs_info *c, int i)
+{
+	int err;
+
+	INIT_LIST_HEAD(&c->jheads[i].buds_list);
+	err = ubifs_wbuf_init(c, &c->jheads[i].wbuf);
+	if (err)
+		return err;
+
+	c->jheads[i].wbuf.sync_callback = &bud_wbuf_callback;
+	c->jheads[i].wbuf.jhead = i;
+	c->jheads[i].grouped = 1;
+	return 0;
+}
+
 /**
  * alloc_wbufs - allocate write-buffers.
  * @c: UBIFS file-system description object
@@ -994,21 +1031,22 @@ static int alloc_wbufs(struct ubifs_info *c)
 {
 	int i, err;
 
+#ifdef CONFIG_UBIFS_HOT_JHEAD
+	/* Leave room for the hot data head, see 'ubifs_add_hot_head()' */
+	c->jheads = kcalloc(NONDATA_JHEADS_CNT + UBIFS_MAX_JHEADS,
+			    sizeof(struct ubifs_jhead), GFP_KERNEL);
+#else
 	c->jheads = kcalloc(c->jhead_cnt, sizeof(struct ubifs_jhead),
 			    GFP_KERNEL);
+#endif
 	if (!c->jheads)
 		return -ENOMEM;
 
 	/* Initialize journal heads */
 	for (i = 0; i < c->jhead_cnt; i++) {
-		INIT_LIST_HEAD(&c->jheads[i].buds_list);
-		err = ubifs_wbuf_init(c, &c->jheads[i].wbuf);
+		err = init_jhead(c, i);
 		if (err)
 			return err;
-
-		c->jheads[i].wbuf.sync_callback = &bud_wbuf_callback;
-		c->jheads[i].wbuf.jhead = i;
-		c->jheads[i].grouped = 1;
 	}
 
 	/*
@@ -1039,6 +1077,53 @@ static void free_wbufs(struct ubifs_info *c)
 	}
 }
 
+#ifdef CONFIG_UBIFS_HOT_JHEAD
+/**
+ * ubifs_add_hot_head - add the hot data journal head to a mounted file-system.
+ * @c: UBIFS file-system description object
+ *
+ * File-systems are made with one data journal head. The hot one is added,
+ * and recorded in the superblock, only when an inode is first marked hot, so
+ * that a volume which never uses the hint stays mountable by Linux. Returns
+ * zero in case of success and a negative error code in case of failure.
+ */
+int ubifs_add_hot_head(struct ubifs_info *c)
+{
+	struct ubifs_sb_node *sup;
+	int err;
+
+	if (c->jhead_cnt > HOTHD)
+		return 0;
+	if (c->ro_mount)
+		return -EROFS;
+
+	err = init_jhead(c, HOTHD);
+	if (err)
+		return err;
+
+	sup = ubifs_read_sb_node(c);
+	if (IS_ERR(sup)) {
+		err = PTR_ERR(sup);
+		goto out_free;
+	}
+
+	dbg_mnt("adding the hot data journal head");
+	sup->jhead_cnt = cpu_to_le32(HOTHD + 1 - NONDATA_JHEADS_CNT);
+	err = ubifs_write_sb_node(c, sup);
+	kfree(sup);
+	if (err)
+		goto out_free;
+
+	c->jhead_cnt = HOTHD + 1;
+	return 0;
+
+out_free:
+	kfree(c->jheads[HOTHD].wbuf.buf);
+	kfree(c->jheads[HOTHD].wbuf.inodes);
+	return err;
+}
+#endif
+
 /**
  * free_orphans - free orphans.
  * @c: UBIFS file-system description object
@@ -1396,6 +1481,14 @@ static int mount_ubifs(struct ubifs_info *c)
 	if (!c->sbuf)
 		goto out_free;
 
+#ifdef CONFIG_UBIFS_GC_COST_BENEFIT
+	/* Sized for the volume, the file-system may grow into it */
+	c->leb_stamp = kcalloc(c->vi.size, sizeof(unsigned long long),
+			       GFP_KERNEL);
+	if (!c->leb_stamp)
+		goto out_free;
+#endif
+
 	if (!c->ro_mount) {
 		c->ileb_buf = vmalloc(c->leb_size);
 		if (!c->ileb_buf)
@@ -1693,6 +1786,9 @@ out_free:
 	kfree(c->bu.buf);
 	vfree(c->ileb_buf);
 	vfree(c->sbuf);
+#ifdef CONFIG_UBIFS_GC_COST_BENEFIT
+	kfree(c->leb_stamp);
+#endif
 	kfree(c->bottom_up_buf);
 	ubifs_debugging_exit(c);
 	return err;
@@ -1745,6 +1841,9 @@ void ubifs_umount(struct ubifs_info *c)
 	kfree(c->bu.buf);
 	vfree(c->ileb_buf);
 	vfree(c->sbuf);
+#ifdef CONFIG_UBIFS_GC_COST_BENEFIT
+	kfree(c->leb_stamp);
+#endif
 	kfree(c->bottom_up_buf);
 	ubifs_debugging_exit(c);
 #ifdef __UBOOT__
@@ -2274,6 +2373,12 @@ static int ubifs_fill_super(struct super_block *sb, void *data, int silent)
 		goto out_bdi;
 
 	sb->s_bdi = &c->bdi;
+#else
+#ifdef CONFIG_UBIFS_BULK_READ
+	/* There are no mount options here, bulk-read is chosen at build time */
+	c->mount_opts.bulk_read = 2;
+	c->bulk_read = 1;
+#endif
 #endif
 	sb->s_fs_info = c;
 	sb->s_magic = UBIFS_SUPER_MAGIC;
@@ -2687,6 +2792,10 @@ int uboot_ubifs_mount(char *vol_name)
 	if (ubifs_sb)
 		ubifs_umount(ubifs_sb->s_fs_info);
 
+#ifdef CONFIG_KMEM_LEAK_REPORT
+	kmem_leak_mark();
+#endif
+
 	/*
 	 * Mount in read-only mode
 	 */
@@ -2697,6 +2806,7 @@ int uboot_ubifs_mount(char *vol_name)
 			"errno=%d!\n", vol_name, (int)PTR_ERR(ret));
 		return -1;
 	}
+	ubifs_pcache_init(ubifs_sb->s_fs_info);
 
 	return 0;
 }
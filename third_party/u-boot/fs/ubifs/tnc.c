@@ -50,6 +50,125 @@ enum {
 	NOT_ON_MEDIA = 3,
 };
 
+#if defined(__UBOOT__) && defined(CONFIG_UBIFS_XCACHE_ENTRIES)
+/*
+ * Extent cache. U-Boot frees an inode on every 'ubifs_iput()', so data node
+ * locations cannot be kept in the inode like Linux keeps pages. Instead the
+ * zbranch of recently looked up data nodes is kept in a small table hashed by
+ * inode and block number, which lets repeated reads of a block skip the
+ * descent from the TNC root. The entry of a block is dropped whenever its TNC
+ * entry changes: journal writes and GC moves go through 'ubifs_tnc_add()' and
+ * 'ubifs_tnc_replace()', truncation and deletion through the remove functions.
+ * Like the TNC itself, the table is protected by @c->tnc_mutex.
+ */
+
+/**
+ * struct tnc_xent - extent cache entry.
+ * @inum: inode number, zero if the entry is unused
+ * @block: data block number
+ * @lnum: LEB number of the data node
+ * @offs: offset of the data node
+ * @len: length of the data node
+ */
+struct tnc_xent {
+	ino_t inum;
+	unsigned int block;
+	int lnum;
+	int offs;
+	int len;
+};
+
+static struct tnc_xent tnc_xcache[CONFIG_UBIFS_XCACHE_ENTRIES];
+
+static struct tnc_xent *xcache_slot(ino_t inum, unsigned int block)
+{
+	return &tnc_xcache[(inum * 31 + block) % CONFIG_UBIFS_XCACHE_ENTRIES];
+}
+
+/**
+ * xcache_lookup - look up the location of a data node in the extent cache.
+ * @c: UBIFS file-system description object
+ * @key: node key
+ * @zbr: zbranch to fill in on a hit
+ *
+ * Returns %1 on a hit and %0 otherwise.
+ */
+static int xcache_lookup(struct ubifs_info *c, const union ubifs_key *key,
+			 struct ubifs_zbranch *zbr)
+{
+	struct tnc_xent *x;
+
+	if (key_type(c, key) != UBIFS_DATA_KEY)
+		return 0;
+
+	x = xcache_slot(key_inum(c, key), key_block(c, key));
+	if (x->inum != key_inum(c, key) || x->block != key_block(c, key))
+		return 0;
+
+	memset(zbr, 0, sizeof(struct ubifs_zbranch));
+	key_copy(c, key, &zbr->key);
+	zbr->lnum = x->lnum;
+	zbr->offs = x->offs;
+	zbr->len = x->len;
+	return 1;
+}
+
+static void xcache_add(struct ubifs_info *c, const struct ubifs_zbranch *zbr)
+{
+	struct tnc_xent *x;
+
+	if (key_type(c, &zbr->key) != UBIFS_DATA_KEY)
+		return;
+
+	x = xcache_slot(key_inum(c, &zbr->key), key_block(c, &zbr->key));
+	x->inum = key_inum(c, &zbr->key);
+	x->block = key_block(c, &zbr->key);
+	x->lnum = zbr->lnum;
+	x->offs = zbr->offs;
+	x->len = zbr->len;
+}
+
+static void xcache_forget(struct ubifs_info *c, const union ubifs_key *key)
+{
+	struct tnc_xent *x;
+
+	if (key_type(c, key) != UBIFS_DATA_KEY)
+		return;
+
+	x = xcache_slot(key_inum(c, key), key_block(c, key));
+	if (x->inum == key_inum(c, key) && x->block == key_block(c, key))
+		x->inum = 0;
+}
+
+/* Drop the entries of all inodes from @inum1 to @inum2 */
+static void xcache_forget_inodes(ino_t inum1, ino_t inum2)
+{
+	int i;
+
+	for (i = 0; i < CONFIG_UBIFS_XCACHE_ENTRIES; i++)
+		if (tnc_xcache[i].inum >= inum1 && tnc_xcache[i].inum <= inum2)
+			tnc_xcache[i].inum = 0;
+}
+
+static void xcache_reset(void)
+{
+	memset(tnc_xcache, 0, sizeof(tnc_xcache));
+}
+#else
+static inline int xcache_lookup(struct ubifs_info *c,
+				const union ubifs_key *key,
+				struct ubifs_zbranch *zbr)
+{
+	return 0;
+}
+static inline void xcache_add(struct ubifs_info *c,
+			      const struct ubifs_zbranch *zbr) {}
+static inline void xcache_forget(struct ubifs_info *c,
+				 const union ubifs_key *key) {}
+static inline void xcache_forget_inodes(ino_t inum1, ino_t inum2) {}
+static inline void xcache_reset(void) {}
+#endif
+
 /**
  * insert_old_idx - record an index node obsoleted since the last commit start.
  * @c: UBIFS file-system description object
@@ -1439,15 +1558,20 @@ int ubifs_tnc_locate(struct ubifs_info *c, const union ubifs_key *key,
 
 again:
 	mutex_lock(&c->tnc_mutex);
-	found = ubifs_lookup_level0(c, key, &znode, &n);
-	if (!found) {
-		err = -ENOENT;
-		goto out;
-	} else if (found < 0) {
-		err = found;
-		goto out;
+	if (!safely && xcache_lookup(c, key, &zbr)) {
+		zt = &zbr;
+	} else {
+		found = ubifs_lookup_level0(c, key, &znode, &n);
+		if (!found) {
+			err = -ENOENT;
+			goto out;
+		} else if (found < 0) {
+			err = found;
+			goto out;
+		}
+		zt = &znode->zbranch[n];
+		xcache_add(c, zt);
 	}
-	zt = &znode->zbranch[n];
 	if (lnum) {
 		*lnum = zt->lnum;
 		*offs = zt->offs;
@@ -1465,7 +1589,8 @@ again:
 		goto out;
 	}
 	/* Drop the TNC mutex prematurely and race with garbage collection */
-	zbr = znode->zbranch[n];
+	if (zt != &zbr)
+		zbr = *zt;
 	gc_seq1 = c->gc_seq;
 	mutex_unlock(&c->tnc_mutex);
 
@@ -2163,6 +2288,7 @@ int ubifs_tnc_add(struct ubifs_info *c, const union ubifs_key *key, int lnum,
 
 	mutex_lock(&c->tnc_mutex);
 	dbg_tnck(key, "%d:%d, len %d, key ", lnum, offs, len);
+	xcache_forget(c, key);
 	found = lookup_level0_dirty(c, key, &znode, &n);
 	if (!found) {
 		struct ubifs_zbranch zbr;
@@ -2213,6 +2339,7 @@ int ubifs_tnc_replace(struct ubifs_info *c, const union ubifs_key *key,
 	mutex_lock(&c->tnc_mutex);
 	dbg_tnck(key, "old LEB %d:%d, new LEB %d:%d, len %d, key ", old_lnum,
 		 old_offs, lnum, offs, len);
+	xcache_forget(c, key);
 	found = lookup_level0_dirty(c, key, &znode, &n);
 	if (found < 0) {
 		err = found;
@@ -2499,6 +2626,7 @@ int ubifs_tnc_remove(struct ubifs_info *c, const union ubifs_key *key)
 
 	mutex_lock(&c->tnc_mutex);
 	dbg_tnck(key, "key ");
+	xcache_forget(c, key);
 	found = lookup_level0_dirty(c, key, &znode, &n);
 	if (found < 0) {
 		err = found;
@@ -2600,6 +2728,7 @@ int ubifs_tnc_remove_range(struct ubifs_info *c, union ubifs_key *from_key,
 	union ubifs_key *key;
 
 	mutex_lock(&c->tnc_mutex);
+	xcache_forget_inodes(key_inum(c, from_key), key_inum(c, to_key));
 	while (1) {
 		/* Find first level 0 znode that contains keys to remove */
 		err = ubifs_lookup_level0(c, from_key, &znode, &n);
@@ -2865,6 +2994,7 @@ static void tnc_destroy_cnext(struct ubifs_info *c)
  */
 void ubifs_tnc_close(struct ubifs_info *c)
 {
+	xcache_reset();
 	tnc_destroy_cnext(c);
 	if (c->zroot.znode) {
 		long n, freed;
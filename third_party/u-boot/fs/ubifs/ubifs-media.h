@@ -82,7 +82,11 @@
 #define UBIFS_MAX_NLEN 255
 
 /* Maximum number of data journal heads */
+#ifdef CONFIG_UBIFS_HOT_JHEAD
+#define UBIFS_MAX_JHEADS 2
+#else
 #define UBIFS_MAX_JHEADS 1
+#endif
 
 /*
  * Size of UBIFS data block. Note, UBIFS is not a block oriented file-system,
@@ -130,6 +134,8 @@
 #define UBIFS_BASE_HEAD 1
 /* Data journal head number */
 #define UBIFS_DATA_HEAD 2
+/* Hot data journal head number */
+#define UBIFS_HOT_HEAD  3
 
 /*
  * LEB Properties Tree node types.
@@ -298,6 +304,8 @@ enum {
  * UBIFS_APPEND_FL: writes to the inode may only append data
  * UBIFS_DIRSYNC_FL: I/O on this directory inode has to be synchronous
  * UBIFS_XATTR_FL: this inode is the inode for an extended attribute value
+ * UBIFS_HOT_FL: data of this inode is rewritten often and goes to the hot
+ *               data journal head (not known to Linux)
  *
  * Note, these are on-flash flags which correspond to ioctl flags
  * (@FS_COMPR_FL, etc). They have the same values now, but generally, do not
@@ -310,6 +318,7 @@ enum {
 	UBIFS_APPEND_FL    = 0x08,
 	UBIFS_DIRSYNC_FL   = 0x10,
 	UBIFS_XATTR_FL     = 0x20,
+	UBIFS_HOT_FL       = 0x80,
 };
 
 /* Inode flag bits used by UBIFS */
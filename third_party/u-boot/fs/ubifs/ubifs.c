@@ -679,6 +679,69 @@ int ubifs_set_blk_dev(struct blk_desc *rbdd, disk_partition_t *info)
 	return 0;
 }
 
+/*
+ * Volume handle used by the file operations below. Each operation normally
+ * opens and closes the UBI volume itself; a caller that runs several
+ * operations back to back can hold the volume open across all of them with
+ * ubifs_hold_volume()/ubifs_release_volume().
+ */
+static int ubifs_vol_held;
+
+static void ubifs_open_vol(struct ubifs_info *c, int mode)
+{
+	if (ubifs_vol_held)
+		return;
+	c->ubi = ubi_open_volume(c->vi.ubi_num, c->vi.vol_id, mode);
+}
+
+static void ubifs_close_vol(struct ubifs_info *c)
+{
+	if (ubifs_vol_held)
+		return;
+	ubi_close_volume(c->ubi);
+}
+
+/**
+ * ubifs_hold_volume - keep the UBI volume open across file operations.
+ *
+ * The volume is opened read-write once, and every file operation up to the
+ * matching ubifs_release_volume() reuses that handle. Returns zero in case of
+ * success and a negative error code in case of failure.
+ */
+int ubifs_hold_volume(void)
+{
+	struct ubifs_info *c;
+
+	if (!ubifs_sb)
+		return -ENODEV;
+	if (ubifs_vol_held)
+		return -EBUSY;
+
+	c = ubifs_sb->s_fs_info;
+	c->ubi = ubi_open_volume(c->vi.ubi_num, c->vi.vol_id, UBI_READWRITE);
+	if (IS_ERR(c->ubi))
+		return PTR_ERR(c->ubi);
+	ubifs_vol_held = 1;
+	return 0;
+}
+
+/**
+ * ubifs_release_volume - close the volume held by ubifs_hold_volume().
+ */
+void ubifs_release_volume(void)
+{
+	struct ubifs_info *c;
+
+	if (!ubifs_vol_held)
+		return;
+
+	ubifs_vol_held = 0;
+	if (ubifs_sb) {
+		c = ubifs_sb->s_fs_info;
+		ubi_close_volume(c->ubi);
+	}
+}
+
 int ubifs_ls(const char *filename)
 {
 	struct ubifs_info *c = ubifs_sb->s_fs_info;
@@ -689,7 +752,7 @@ int ubifs_ls(const char *filename)
 	unsigned long inum;
 	int ret = 0;
 
-	c->ubi = ubi_open_volume(c->vi.ubi_num, c->vi.vol_id, UBI_READONLY);
+	ubifs_open_vol(c, UBI_READONLY);
 	inum = ubifs_findfile(ubifs_sb, (char *)filename, NULL);
 	if (!inum) {
 		ret = -1;
@@ -749,7 +812,7 @@ out_mem:
 
 out:
 
-	ubi_close_volume(c->ubi);
+	ubifs_close_vol(c);
 
 	return ret;
 }
@@ -759,9 +822,9 @@ int ubifs_exists(const char *filename)
 	struct ubifs_info *c = ubifs_sb->s_fs_info;
 	unsigned long inum;
 
-	c->ubi = ubi_open_volume(c->vi.ubi_num, c->vi.vol_id, UBI_READONLY);
+	ubifs_open_vol(c, UBI_READONLY);
 	inum = ubifs_findfile(ubifs_sb, (char *)filename, NULL);
-	ubi_close_volume(c->ubi);
+	ubifs_close_vol(c);
 
 	return inum != 0;
 }
@@ -773,11 +836,11 @@ int ubifs_size(const char *filename, loff_t *size)
 	struct inode *inode;
 	int err = 0;
 
-	c->ubi = ubi_open_volume(c->vi.ubi_num, c->vi.vol_id, UBI_READONLY);
+	ubifs_open_vol(c, UBI_READONLY);
 
 	inum = ubifs_findfile(ubifs_sb, (char *)filename, NULL);
 	if (!inum) {
-		err = -1;
+		err = -ENOENT;
 		goto out;
 	}
 
@@ -792,7 +855,7 @@ int ubifs_size(const char *filename, loff_t *size)
 
 	ubifs_iput(inode);
 out:
-	ubi_close_volume(c->ubi);
+	ubifs_close_vol(c);
 	return err;
 }
 
@@ -802,9 +865,37 @@ out:
 
 /* file.c */
 
-static inline void *kmap(struct page *page)
+/**
+ * lookup_block - look up the data node of a block on flash.
+ * @inode: inode the block belongs to
+ * @block: block number
+ * @dn: the data node is returned here
+ *
+ * Returns the number of data bytes in the block, %-ENOENT if the block is a
+ * hole, or another negative error code in case of failure.
+ */
+static int lookup_block(struct inode *inode, unsigned int block,
+			struct ubifs_data_node *dn)
 {
-	return page->addr;
+	struct ubifs_info *c = inode->i_sb->s_fs_info;
+	union ubifs_key key;
+	int err, len;
+
+	data_key_init(c, &key, inode->i_ino, block);
+	err = ubifs_tnc_lookup(c, &key, dn);
+	if (err)
+		return err;
+
+	ubifs_assert(le64_to_cpu(dn->ch.sqnum) > ubifs_inode(inode)->creat_sqnum);
+
+	len = le32_to_cpu(dn->size);
+	if (len <= 0 || len > UBIFS_BLOCK_SIZE) {
+		ubifs_err(c, "bad data node (block %u, inode %lu)",
+			  block, inode->i_ino);
+		ubifs_dump_node(c, dn);
+		return -EINVAL;
+	}
+	return len;
 }
 
 static int read_block(struct inode *inode, void *addr, unsigned int block,
@@ -812,24 +903,19 @@ static int read_block(struct inode *inode, void *addr, unsigned int block,
 {
 	struct ubifs_info *c = inode->i_sb->s_fs_info;
 	int err, len, out_len;
-	union ubifs_key key;
 	unsigned int dlen;
 
-	data_key_init(c, &key, inode->i_ino, block);
-	err = ubifs_tnc_lookup(c, &key, dn);
-	if (err) {
-		if (err == -ENOENT)
+	if (!ubifs_pcache_read(inode->i_ino, block, addr))
+		return 0;
+
+	len = lookup_block(inode, block, dn);
+	if (len < 0) {
+		if (len == -ENOENT)
 			/* Not found, so it must be a hole */
 			memset(addr, 0, UBIFS_BLOCK_SIZE);
-		return err;
+		return len;
 	}
 
-	ubifs_assert(le64_to_cpu(dn->ch.sqnum) > ubifs_inode(inode)->creat_sqnum);
-
-	len = le32_to_cpu(dn->size);
-	if (len <= 0 || len > UBIFS_BLOCK_SIZE)
-		goto dump;
-
 	dlen = le32_to_cpu(dn->ch.len) - UBIFS_DATA_NODE_SZ;
 	out_len = UBIFS_BLOCK_SIZE;
 	err = ubifs_decompress(c, &dn->data, dlen, addr, &out_len,
@@ -845,6 +931,7 @@ static int read_block(struct inode *inode, void *addr, unsigned int block,
 	if (len < UBIFS_BLOCK_SIZE)
 		memset(addr + len, 0, UBIFS_BLOCK_SIZE - len);
 
+	ubifs_pcache_fill(c, inode->i_ino, block, addr, len);
 	return 0;
 
 dump:
@@ -854,113 +941,173 @@ dump:
 	return -EINVAL;
 }
 
-static int do_readpage(struct ubifs_info *c, struct inode *inode,
-		       struct page *page, int last_block_size)
+/**
+ * do_bulkread - read consecutive full blocks of an inode in one go.
+ * @c: UBIFS file-system description object
+ * @inode: inode to read from
+ * @buf: destination buffer, @nblk blocks long
+ * @block: first block number
+ * @nblk: number of blocks wanted
+ *
+ * Data nodes of consecutive blocks that sit next to each other in one LEB are
+ * fetched with a single LEB read into the bulk-read buffer and decompressed
+ * from there. Returns the number of blocks filled in, zero if bulk-read does
+ * not apply (the caller then reads block by block), or a negative error code.
+ */
+static int do_bulkread(struct ubifs_info *c, struct inode *inode, void *buf,
+		       unsigned int block, int nblk)
 {
-	void *addr;
-	int err = 0, i;
-	unsigned int block, beyond;
+	struct bu_info *bu = &c->bu;
 	struct ubifs_data_node *dn;
-	loff_t i_size = inode->i_size;
+	int err, i, n, len, out_len, offs;
+	unsigned int dlen;
+
+	if (!c->bulk_read || !bu->buf || nblk < 2)
+		return 0;
 
-	dbg_gen("ino %lu, pg %lu, i_size %ld",
-		inode->i_ino, page->index, i_size);
+	mutex_lock(&c->bu_mutex);
+	bu->buf_len = c->max_bu_buf_len;
+	data_key_init(c, &bu->key, inode->i_ino, block);
+	err = ubifs_tnc_get_bu_keys(c, bu);
+	if (err)
+		goto out;
 
-	addr = kmap(page);
+	/* Do not read nodes the caller has no room for */
+	nblk = min_t(int, nblk, bu->blk_cnt);
+	while (bu->cnt &&
+	       key_block(c, &bu->zbranch[bu->cnt - 1].key) >= block + nblk)
+		bu->cnt -= 1;
+	if (bu->cnt < 2) {
+		/* Nothing to gain over a plain lookup */
+		n = 0;
+		goto out_unlock;
+	}
 
-	block = page->index << UBIFS_BLOCKS_PER_PAGE_SHIFT;
-	beyond = (i_size + UBIFS_BLOCK_SIZE - 1) >> UBIFS_BLOCK_SHIFT;
-	if (block >= beyond) {
-		/* Reading beyond inode */
-		memset(addr, 0, PAGE_CACHE_SIZE);
+	err = ubifs_tnc_bulk_read(c, bu);
+	if (err == -EAGAIN) {
+		/* Raced with GC, read block by block instead */
+		n = 0;
+		goto out_unlock;
+	}
+	if (err)
 		goto out;
+
+	offs = bu->zbranch[0].offs;
+	for (i = 0, n = 0; n < nblk; n++, buf += UBIFS_BLOCK_SIZE) {
+		if (i >= bu->cnt ||
+		    key_block(c, &bu->zbranch[i].key) != block + n) {
+			/* Not found, so it must be a hole */
+			memset(buf, 0, UBIFS_BLOCK_SIZE);
+			continue;
+		}
+
+		dn = bu->buf + (bu->zbranch[i++].offs - offs);
+		len = le32_to_cpu(dn->size);
+		if (len <= 0 || len > UBIFS_BLOCK_SIZE)
+			goto dump;
+
+		dlen = le32_to_cpu(dn->ch.len) - UBIFS_DATA_NODE_SZ;
+		out_len = UBIFS_BLOCK_SIZE;
+		err = ubifs_decompress(c, &dn->data, dlen, buf, &out_len,
+				       le16_to_cpu(dn->compr_type));
+		if (err || len != out_len)
+			goto dump;
+
+		if (len < UBIFS_BLOCK_SIZE)
+			memset(buf + len, 0, UBIFS_BLOCK_SIZE - len);
 	}
 
+out_unlock:
+	mutex_unlock(&c->bu_mutex);
+	return n;
+
+dump:
+	ubifs_err(c, "bad data node (block %u, inode %lu)",
+		  block + n, inode->i_ino);
+	ubifs_dump_node(c, dn);
+	err = -EINVAL;
+out:
+	mutex_unlock(&c->bu_mutex);
+	return err;
+}
+
+/**
+ * do_readrange - read a byte range of an inode.
+ * @c: UBIFS file-system description object
+ * @inode: inode to read from
+ * @buf: destination buffer
+ * @offset: byte offset in the file, any alignment
+ * @size: number of bytes to read, must not go beyond the inode size
+ * @done: number of bytes read is returned here
+ *
+ * Blocks that are fully covered by the range are decompressed straight into
+ * @buf, using bulk-read for runs of them when it is enabled. Only a partial
+ * head or tail block goes through a bounce buffer, so the caller's buffer is
+ * never written outside the requested range. Holes read back as zeroes.
+ * Returns zero in case of success and a negative error code in case of
+ * failure.
+ */
+static int do_readrange(struct ubifs_info *c, struct inode *inode, void *buf,
+			loff_t offset, loff_t size, loff_t *done)
+{
+	struct ubifs_data_node *dn;
+	void *bounce = NULL;
+	unsigned int block = offset >> UBIFS_BLOCK_SHIFT;
+	int boffs = offset & (UBIFS_BLOCK_SIZE - 1);
+	int len, nblk, err = 0;
+
+	dbg_gen("ino %lu, offset %lld, size %lld", inode->i_ino, offset, size);
+
+	*done = 0;
 	dn = kmalloc(UBIFS_MAX_DATA_NODE_SZ, GFP_NOFS);
 	if (!dn)
 		return -ENOMEM;
 
-	i = 0;
-	while (1) {
-		int ret;
-
-		if (block >= beyond) {
-			/* Reading beyond inode */
-			err = -ENOENT;
-			memset(addr, 0, UBIFS_BLOCK_SIZE);
+	while (size > 0) {
+		len = min_t(loff_t, size, UBIFS_BLOCK_SIZE - boffs);
+		if (len == UBIFS_BLOCK_SIZE) {
+			/* Cached blocks may be newer than flash */
+			nblk = min_t(loff_t, size >> UBIFS_BLOCK_SHIFT,
+				     UBIFS_MAX_BULK_READ);
+			nblk = ubifs_pcache_uncached(inode->i_ino, block, nblk);
+			nblk = do_bulkread(c, inode, buf, block, nblk);
+			if (nblk > 0)
+				len = nblk << UBIFS_BLOCK_SHIFT;
+			else if (nblk < 0)
+				err = nblk;
+			else
+				err = read_block(inode, buf, block, dn);
 		} else {
-			/*
-			 * Reading last block? Make sure to not write beyond
-			 * the requested size in the destination buffer.
-			 */
-			if (((block + 1) == beyond) || last_block_size) {
-				void *buff;
-				int dlen;
-
-				/*
-				 * We need to buffer the data locally for the
-				 * last block. This is to not pad the
-				 * destination area to a multiple of
-				 * UBIFS_BLOCK_SIZE.
-				 */
-				buff = malloc_cache_aligned(UBIFS_BLOCK_SIZE);
-				if (!buff) {
-					debug("%s: Error, malloc fails!\n",
-					       __func__);
+			if (!bounce) {
+				bounce = malloc_cache_aligned(UBIFS_BLOCK_SIZE);
+				if (!bounce) {
 					err = -ENOMEM;
 					break;
 				}
-
-				/* Read block-size into temp buffer */
-				ret = read_block(inode, buff, block, dn);
-				if (ret) {
-					err = ret;
-					if (err != -ENOENT) {
-						kfree(buff);
-						break;
-					}
-				}
-
-				if (last_block_size)
-					dlen = last_block_size;
-				else
-					dlen = le32_to_cpu(dn->size);
-
-				/* Now copy required size back to dest */
-				memcpy(addr, buff, dlen);
-
-				kfree(buff);
-			} else {
-				ret = read_block(inode, addr, block, dn);
-				if (ret) {
-					err = ret;
-					if (err != -ENOENT)
-						break;
-				}
 			}
+			err = read_block(inode, bounce, block, dn);
+			if (!err || err == -ENOENT)
+				memcpy(buf, bounce + boffs, len);
 		}
-		if (++i >= UBIFS_BLOCKS_PER_PAGE)
-			break;
-		block += 1;
-		addr += UBIFS_BLOCK_SIZE;
-	}
-	if (err) {
 		if (err == -ENOENT) {
 			/* Not found, so it must be a hole */
 			dbg_gen("hole");
-			goto out_free;
+			err = 0;
+		}
+		if (err) {
+			ubifs_err(c, "cannot read block %u of inode %lu, error %d",
+				  block, inode->i_ino, err);
+			break;
 		}
-		ubifs_err(c, "cannot read page %lu of inode %lu, error %d",
-			  page->index, inode->i_ino, err);
-		goto error;
-	}
 
-out_free:
-	kfree(dn);
-out:
-	return 0;
+		buf += len;
+		size -= len;
+		*done += len;
+		block += DIV_ROUND_UP(boffs + len, UBIFS_BLOCK_SIZE);
+		boffs = 0;
+	}
 
-error:
+	kfree(bounce);
 	kfree(dn);
 	return err;
 }
@@ -971,26 +1118,16 @@ int ubifs_read(const char *filename, void *buf, loff_t offset,
 	struct ubifs_info *c = ubifs_sb->s_fs_info;
 	unsigned long inum;
 	struct inode *inode;
-	struct page page;
 	int err = 0;
-	int i;
-	int count;
-	int last_block_size = 0;
 
 	*actread = 0;
 
-	if (offset & (PAGE_SIZE - 1)) {
-		debug("ubifs: Error offset must be a multiple of %d\n",
-		       PAGE_SIZE);
-		return -1;
-	}
-
-	c->ubi = ubi_open_volume(c->vi.ubi_num, c->vi.vol_id, UBI_READONLY);
+	ubifs_open_vol(c, UBI_READONLY);
 	/* ubifs_findfile will resolve symlinks, so we know that we get
 	 * the real file here */
 	inum = ubifs_findfile(ubifs_sb, (char *)filename, NULL);
 	if (!inum) {
-		err = -1;
+		err = -ENOENT;
 		goto out;
 	}
 
@@ -1007,7 +1144,7 @@ int ubifs_read(const char *filename, void *buf, loff_t offset,
 	if (offset > inode->i_size) {
 		debug("ubifs: Error offset (%ld) > file-size (%ld)\n",
 		       offset, size);
-		err = -1;
+		err = -EINVAL;
 		goto put_inode;
 	}
 
@@ -1018,38 +1155,166 @@ int ubifs_read(const char *filename, void *buf, loff_t offset,
 	if ((size == 0) || (size > (inode->i_size - offset)))
 		size = inode->i_size - offset;
 
-	count = (size + UBIFS_BLOCK_SIZE - 1) >> UBIFS_BLOCK_SHIFT;
+	err = do_readrange(c, inode, buf, offset, size, actread);
+	if (err)
+		debug("Error reading file '%s'\n", filename);
 
-	page.addr = buf;
-	page.index = offset / PAGE_SIZE;
-	page.inode = inode;
-	for (i = 0; i < count; i++) {
-		/*
-		 * Make sure to not read beyond the requested size
-		 */
-		if (((i + 1) == count) && (size < inode->i_size))
-			last_block_size = size - (i * PAGE_SIZE);
+put_inode:
+	ubifs_iput(inode);
 
-		err = do_readpage(c, inode, &page, last_block_size);
-		if (err)
-			break;
+out:
+	ubifs_close_vol(c);
+	return err;
+}
+
+/**
+ * read_stream_block - get part of a block of an inode for a stream reader.
+ * @inode: inode to read from
+ * @block: block number
+ * @dn: buffer for the data node
+ * @bounce: buffer of one block
+ * @end: the part of the block wanted ends at this byte offset in it
+ * @data: where the block data is, @dn or @bounce, is returned here
+ *
+ * An uncompressed data node that holds the wanted part is handed out in
+ * place, other blocks are decompressed to @bounce. The page cache is looked
+ * at, as it may be newer than flash, but not filled, as a stream would only
+ * push everything else out of it. Returns zero in case of success and a
+ * negative error code in case of failure.
+ */
+static int read_stream_block(struct inode *inode, unsigned int block,
+			     struct ubifs_data_node *dn, void *bounce, int end,
+			     const void **data)
+{
+	struct ubifs_info *c = inode->i_sb->s_fs_info;
+	int err, len, out_len;
+	unsigned int dlen;
+
+	*data = bounce;
+	if (!ubifs_pcache_read(inode->i_ino, block, bounce))
+		return 0;
 
-		page.addr += PAGE_SIZE;
-		page.index++;
+	len = lookup_block(inode, block, dn);
+	if (len == -ENOENT) {
+		/* Not found, so it must be a hole */
+		memset(bounce, 0, UBIFS_BLOCK_SIZE);
+		return 0;
 	}
+	if (len < 0)
+		return len;
 
-	if (err) {
-		debug("Error reading file '%s'\n", filename);
-		*actread = i * PAGE_SIZE;
-	} else {
-		*actread = size;
+	dlen = le32_to_cpu(dn->ch.len) - UBIFS_DATA_NODE_SZ;
+	if (le16_to_cpu(dn->compr_type) == UBIFS_COMPR_NONE &&
+	    dlen == len && end <= len) {
+		*data = &dn->data;
+		return 0;
+	}
+
+	out_len = UBIFS_BLOCK_SIZE;
+	err = ubifs_decompress(c, &dn->data, dlen, bounce, &out_len,
+			       le16_to_cpu(dn->compr_type));
+	if (err || len != out_len) {
+		ubifs_err(c, "bad data node (block %u, inode %lu)",
+			  block, inode->i_ino);
+		ubifs_dump_node(c, dn);
+		return -EINVAL;
+	}
+
+	if (len < UBIFS_BLOCK_SIZE)
+		memset(bounce + len, 0, UBIFS_BLOCK_SIZE - len);
+	return 0;
+}
+
+/**
+ * ubifs_read_stream - pass a byte range of a file to a consumer block by block.
+ * @filename: absolute path of the file
+ * @offset: byte offset in the file, any alignment
+ * @size: number of bytes, zero or more than the file has for all of it
+ * @consume: called with each successive piece of the range, at most a block
+ *           long, in file order; returns zero to go on or a negative error
+ *           code to stop the read with
+ * @priv: passed to @consume
+ * @actread: number of bytes consumed is returned here
+ *
+ * Unlike ubifs_read(), no buffer for the whole range is needed. At most two
+ * blocks of memory are used, whatever the size of the range, so a file of
+ * any size can be checksummed or sent out. The data passed to @consume is
+ * only valid until it returns. Returns zero in case of success and a
+ * negative error code in case of failure.
+ */
+int ubifs_read_stream(const char *filename, loff_t offset, loff_t size,
+		      int (*consume)(const void *buf, int len, void *priv),
+		      void *priv, loff_t *actread)
+{
+	struct ubifs_info *c = ubifs_sb->s_fs_info;
+	struct ubifs_data_node *dn = NULL;
+	void *bounce = NULL;
+	const void *data;
+	unsigned long inum;
+	struct inode *inode;
+	unsigned int block;
+	int boffs, len, err = 0;
+
+	*actread = 0;
+
+	ubifs_open_vol(c, UBI_READONLY);
+	inum = ubifs_findfile(ubifs_sb, (char *)filename, NULL);
+	if (!inum) {
+		err = -ENOENT;
+		goto out;
+	}
+
+	inode = ubifs_iget(ubifs_sb, inum);
+	if (IS_ERR(inode)) {
+		debug("%s: Error reading inode %ld!\n", __func__, inum);
+		err = PTR_ERR(inode);
+		goto out;
+	}
+
+	if (offset > inode->i_size) {
+		err = -EINVAL;
+		goto put_inode;
+	}
+	if ((size == 0) || (size > (inode->i_size - offset)))
+		size = inode->i_size - offset;
+
+	dn = kmalloc(UBIFS_MAX_DATA_NODE_SZ, GFP_NOFS);
+	bounce = malloc_cache_aligned(UBIFS_BLOCK_SIZE);
+	if (!dn || !bounce) {
+		err = -ENOMEM;
+		goto put_inode;
+	}
+
+	dbg_gen("ino %lu, offset %lld, size %lld", inode->i_ino, offset, size);
+
+	block = offset >> UBIFS_BLOCK_SHIFT;
+	boffs = offset & (UBIFS_BLOCK_SIZE - 1);
+	while (size > 0) {
+		len = min_t(loff_t, size, UBIFS_BLOCK_SIZE - boffs);
+		err = read_stream_block(inode, block, dn, bounce, boffs + len,
+					&data);
+		if (err) {
+			ubifs_err(c, "cannot read block %u of inode %lu, error %d",
+				  block, inode->i_ino, err);
+			break;
+		}
+
+		err = consume(data + boffs, len, priv);
+		if (err)
+			break;
+
+		size -= len;
+		*actread += len;
+		block += 1;
+		boffs = 0;
 	}
 
 put_inode:
+	kfree(bounce);
+	kfree(dn);
 	ubifs_iput(inode);
-
 out:
-	ubi_close_volume(c->ubi);
+	ubifs_close_vol(c);
 	return err;
 }
 
@@ -1063,7 +1328,9 @@ out:
  * o %UBIFS_COMPR_FL, which is useful to switch compression on/of on
  *   sub-directory basis;
  * o %UBIFS_SYNC_FL - useful for the same reasons;
- * o %UBIFS_DIRSYNC_FL - similar, but relevant only to directories.
+ * o %UBIFS_DIRSYNC_FL - similar, but relevant only to directories;
+ * o %UBIFS_HOT_FL - so that a directory of often rewritten files can be
+ *   marked once.
  *
  * This function returns the inherited flags.
  */
@@ -1079,7 +1346,8 @@ static int inherit_flags(const struct inode *dir, umode_t mode)
 		 */
 		return 0;
 
-	flags = ui->flags & (UBIFS_COMPR_FL | UBIFS_SYNC_FL | UBIFS_DIRSYNC_FL);
+	flags = ui->flags & (UBIFS_COMPR_FL | UBIFS_SYNC_FL | UBIFS_DIRSYNC_FL |
+			     UBIFS_HOT_FL);
 	if (!S_ISDIR(mode))
 		/* The "DIRSYNC" flag only applies to directories */
 		flags &= ~UBIFS_DIRSYNC_FL;
@@ -1289,72 +1557,181 @@ out_fname:
 
 
 
-/**
-
- * release_new_page_budget - release budget of a new page.
- * @c: UBIFS file-system description object
- *
- * This is a helper function which releases budget corresponding to the budget
- * of one new page of data.
+/*
+ * Copy of the last, partial data block of the file appended to most recently.
+ * A run of small appends to the same file patches this copy instead of
+ * reading the block back from flash each time. @inum is zero when the cache
+ * is empty.
  */
-static void release_new_page_budget(struct ubifs_info *c)
-{
-	struct ubifs_budget_req req = { .recalculate = 1, .new_page = 1 };
+static struct {
+	ino_t inum;
+	unsigned int block;
+	int len;
+	void *data;
+} ubifs_tail;
 
-	ubifs_release_budget(c, &req);
+static void ubifs_tail_forget(ino_t inum)
+{
+	if (ubifs_tail.inum == inum)
+		ubifs_tail.inum = 0;
 }
 
-static int do_writepage(struct ubifs_info *c, struct inode *inode, struct page *page, int len)
+/**
+ * do_writerange - write a byte range of an inode.
+ * @c: UBIFS file-system description object
+ * @inode: inode to write to
+ * @buf: data to write
+ * @offset: byte offset in the file, any alignment
+ * @size: number of bytes to write
+ * @done: number of bytes written is returned here
+ *
+ * Blocks that are fully covered by the range are written straight from @buf.
+ * A partial head or tail block is read, patched and written back, but only
+ * the part of it that lies inside the file is read from flash. The inode size
+ * is not changed here. Returns zero in case of success and a negative error
+ * code in case of failure.
+ */
+static int do_writerange(struct ubifs_info *c, struct inode *inode,
+			 const void *buf, loff_t offset, loff_t size,
+			 loff_t *done)
 {
-	int err = 0, i, blen;
-	unsigned int block;
-
-	void *addr;
-
-	union ubifs_key key;
-
-	struct ubifs_budget_req req = { .recalculate = 1, .new_page = 1 };
-
-	err = ubifs_budget_space(c, &req);
-	if (unlikely(err))
-		return err;
-
+	struct ubifs_data_node *dn = NULL;
+	void *bounce = NULL;
+	unsigned int block = offset >> UBIFS_BLOCK_SHIFT;
+	int boffs = offset & (UBIFS_BLOCK_SIZE - 1);
+	loff_t i_size = inode->i_size;
+	loff_t bstart;
+	int len, old_len, err = 0;
 
-#ifdef UBIFS_DEBUG
+	dbg_gen("ino %lu, offset %lld, size %lld", inode->i_ino, offset, size);
 
-	struct ubifs_inode *ui = ubifs_inode(inode);
+	ubifs_tail_forget(inode->i_ino);
+	*done = 0;
+	while (size > 0) {
+		len = min_t(loff_t, size, UBIFS_BLOCK_SIZE - boffs);
+		if (len == UBIFS_BLOCK_SIZE) {
+			err = ubifs_pcache_write(c, inode, block, buf, len);
+		} else {
+			if (!bounce) {
+				bounce = malloc_cache_aligned(UBIFS_BLOCK_SIZE);
+				dn = kmalloc(UBIFS_MAX_DATA_NODE_SZ, GFP_NOFS);
+				if (!bounce || !dn) {
+					err = -ENOMEM;
+					break;
+				}
+			}
 
-	spin_lock(&ui->ui_lock);
-	ubifs_assert(page->index <= ui->synced_i_size >> PAGE_SHIFT);
-	spin_unlock(&ui->ui_lock);
-#endif
+			/* Bytes of this block that already belong to the file */
+			bstart = (loff_t)block << UBIFS_BLOCK_SHIFT;
+			old_len = 0;
+			if (i_size > bstart)
+				old_len = min_t(loff_t, i_size - bstart,
+						UBIFS_BLOCK_SIZE);
 
-	/* Update radix tree tags */
-	set_page_writeback(page);
+			if (old_len > 0 && (boffs > 0 || boffs + len < old_len)) {
+				err = read_block(inode, bounce, block, dn);
+				if (err && err != -ENOENT)
+					break;
+			} else {
+				memset(bounce, 0, UBIFS_BLOCK_SIZE);
+			}
 
-	addr = kmap(page);
-	block = page->index << UBIFS_BLOCKS_PER_PAGE_SHIFT;
-	i = 0;
-	while (len) {
-		blen = min_t(int, len, UBIFS_BLOCK_SIZE);
-		data_key_init(c, &key, inode->i_ino, block);
-		err = ubifs_jnl_write_data(c, inode, &key, addr, blen);
+			memcpy(bounce + boffs, buf, len);
+			err = ubifs_pcache_write(c, inode, block, bounce,
+						 max_t(int, old_len, boffs + len));
+		}
 		if (err)
 			break;
-		if (++i >= UBIFS_BLOCKS_PER_PAGE)
-			break;
+
+		buf += len;
+		size -= len;
+		*done += len;
 		block += 1;
-		addr += blen;
-		len -= blen;
+		boffs = 0;
 	}
-	if (err) {
-		SetPageError(page);
-		ubifs_err(c, "cannot write page %lu of inode %lu, error %d",
-			  page->index, inode->i_ino, err);
-		ubifs_ro_mode(c, err);
-	}
-	release_new_page_budget(c);
-	atomic_long_dec(&c->dirty_pg_cnt);
+
+	kfree(dn);
+	kfree(bounce);
+	return err;
+}
+
+/**
+ * do_appendrange - append data at the end of an inode.
+ * @c: UBIFS file-system description object
+ * @inode: inode to append to
+ * @buf: data to append
+ * @size: number of bytes to append
+ * @done: number of bytes written is returned here
+ *
+ * The partial last block of the file is taken from the tail cache when it
+ * holds that block, so only the first append of a run reads it from flash.
+ * The inode size is not changed here. Returns zero in case of success and a
+ * negative error code in case of failure.
+ */
+static int do_appendrange(struct ubifs_info *c, struct inode *inode,
+			  const void *buf, loff_t size, loff_t *done)
+{
+	struct ubifs_data_node *dn = NULL;
+	unsigned int block = inode->i_size >> UBIFS_BLOCK_SHIFT;
+	int boffs = inode->i_size & (UBIFS_BLOCK_SIZE - 1);
+	int len, err = 0;
+
+	dbg_gen("ino %lu, i_size %lld, size %lld", inode->i_ino,
+		inode->i_size, size);
+
+	*done = 0;
+	if (!ubifs_tail.data) {
+		ubifs_tail.data = malloc_cache_aligned(UBIFS_BLOCK_SIZE);
+		if (!ubifs_tail.data)
+			return -ENOMEM;
+	}
+
+	while (size > 0) {
+		len = min_t(loff_t, size, UBIFS_BLOCK_SIZE - boffs);
+		if (len == UBIFS_BLOCK_SIZE) {
+			ubifs_tail_forget(inode->i_ino);
+			err = ubifs_pcache_write(c, inode, block, buf, len);
+		} else {
+			if (boffs > 0 && (ubifs_tail.inum != inode->i_ino ||
+			    ubifs_tail.block != block ||
+			    ubifs_tail.len != boffs)) {
+				ubifs_tail.inum = 0;
+				if (!dn) {
+					dn = kmalloc(UBIFS_MAX_DATA_NODE_SZ,
+						     GFP_NOFS);
+					if (!dn) {
+						err = -ENOMEM;
+						break;
+					}
+				}
+				err = read_block(inode, ubifs_tail.data, block,
+						 dn);
+				if (err && err != -ENOENT)
+					break;
+			}
+
+			memcpy(ubifs_tail.data + boffs, buf, len);
+			err = ubifs_pcache_write(c, inode, block,
+						 ubifs_tail.data, boffs + len);
+			if (!err) {
+				ubifs_tail.inum = inode->i_ino;
+				ubifs_tail.block = block;
+				ubifs_tail.len = boffs + len;
+			} else {
+				ubifs_tail.inum = 0;
+			}
+		}
+		if (err)
+			break;
+
+		buf += len;
+		size -= len;
+		*done += len;
+		block += 1;
+		boffs = 0;
+	}
+
+	kfree(dn);
 	return err;
 }
 
@@ -1413,7 +1790,7 @@ int ubifs_rmdir(const char *filename)
 	nm.name = p + 1;
 	nm.len = strlen(p + 1);
 		
-	c->ubi = ubi_open_volume(c->vi.ubi_num, c->vi.vol_id, UBI_READWRITE);
+	ubifs_open_vol(c, UBI_READWRITE);
 
 
 	/*
@@ -1511,7 +1888,7 @@ int ubifs_rmdir(const char *filename)
 	ubifs_iput(dir);
 	ubifs_iput(inode);
 
-	ubi_close_volume(c->ubi);
+	ubifs_close_vol(c);
 	return 0;
 
 out_cancel:
@@ -1526,7 +1903,7 @@ out_inode:
 out_dir:
 	ubifs_iput(dir);
 out:
-	ubi_close_volume(c->ubi);
+	ubifs_close_vol(c);
 	return err;
 }
 
@@ -1550,7 +1927,7 @@ int ubifs_mkdir(const char *filename)
 	fn.name = p + 1;
 	fn.len = strlen(p + 1);
 		
-	c->ubi = ubi_open_volume(c->vi.ubi_num, c->vi.vol_id, UBI_READWRITE);
+	ubifs_open_vol(c, UBI_READWRITE);
 	inum = ubifs_findfile(ubifs_sb, (char *)filename, &parent_dir);
 	if (!inum) {
 		iparent_dir = ubifs_iget(ubifs_sb, parent_dir);
@@ -1583,252 +1960,1227 @@ int ubifs_mkdir(const char *filename)
 out_dir:
 	ubifs_iput(iparent_dir);
 out:
-	ubi_close_volume(c->ubi);
+	ubifs_close_vol(c);
 	return err;
 }
 
-int ubifs_write(const char *filename, void *buf, loff_t offset,
-	       loff_t size, loff_t *actwritten)
+/**
+ * ubifs_iget_create - look up a regular file, creating it if missing.
+ * @filename: absolute path of the file
+ *
+ * Must be called with the volume open. Returns the inode, or an ERR_PTR in
+ * case of failure.
+ */
+static struct inode *ubifs_iget_create(const char *filename)
 {
-	struct ubifs_info *c = ubifs_sb->s_fs_info;
 	unsigned long inum, parent_dir;
 	struct inode *inode, *iparent_dir;
-	struct page page;
-	struct ubifs_inode *ui;
-	int err = 0;
-	int i;
-	int count;
-	int last_block_size = 0;
 	struct qstr fn;
 	char *p;
 
 	p = strrchr(filename, '/');
 	if (!p) {
 		debug("%s: File path is not absolute '%s'!\n", __func__, filename);
-		err = -EINVAL;
-		goto out;
+		return ERR_PTR(-EINVAL);
 	}
-		
+
 	fn.name = p + 1;
 	fn.len = strlen(p + 1);
-		
-	*actwritten = 0;
-
-	if (offset & (PAGE_SIZE - 1)) {
-		debug("ubifs: Error offset must be a multiple of %d\n",
-		       PAGE_SIZE);
-		return -1;
-	}
 
-	c->ubi = ubi_open_volume(c->vi.ubi_num, c->vi.vol_id, UBI_READWRITE);
 	/* ubifs_findfile will resolve symlinks, so we know that we get
 	 * the real file here */
 	inum = ubifs_findfile(ubifs_sb, (char *)filename, &parent_dir);
 
-	iparent_dir = ubifs_iget(ubifs_sb, parent_dir);
-	if (IS_ERR(iparent_dir)) {
-		debug("%s: No parent dir inode for '%s'!\n", __func__, filename);
-		err = PTR_ERR(iparent_dir);
-		goto out;
-	}
-
 	if (!inum) {
+		iparent_dir = ubifs_iget(ubifs_sb, parent_dir);
+		if (IS_ERR(iparent_dir)) {
+			debug("%s: No parent dir inode for '%s'!\n", __func__, filename);
+			return iparent_dir;
+		}
+
 		inode = ubifs_create(iparent_dir, &fn, S_IFREG, 0);
+		ubifs_iput(iparent_dir);
 		if (IS_ERR(inode)) {
 			debug("%s: Can't create inode %d!\n", __func__, (int)inode);
-			err = PTR_ERR(inode);
-			goto out;
+			return inode;
 		}
 		ubifs_iput(inode);
 		inum = ubifs_findfile(ubifs_sb, (char *)filename, &parent_dir);
 		if (!inum) {
 			debug("%s: Can't find created inode!\n", __func__);
-			err = PTR_ERR(inode);
-			goto out_inode;
+			return ERR_PTR(-ENOENT);
 		}
 	}
 
-	ubifs_iput(iparent_dir);
-
 	inode = ubifs_iget(ubifs_sb, inum);
-	if (IS_ERR(inode)) {
+	if (IS_ERR(inode))
 		debug("%s: Error reading inode %ld!\n", __func__, inum);
-		err = PTR_ERR(inode);
-		goto out;
-	}
+	return inode;
+}
 
-	ui = ubifs_inode(inode);
-	count = (size + UBIFS_BLOCK_SIZE - 1) >> UBIFS_BLOCK_SHIFT;
+/* Appended to the name of a streamed file until ubifs_stream_finish() */
+#define UBIFS_STREAM_SUFFIX	".part"
 
-	page.addr = buf;
-	page.index = offset / PAGE_SIZE;
-	page.inode = inode;
-	last_block_size = PAGE_SIZE;
-	for (i = 0; i < count; i++) {
-		/*
-		 * Make sure to not write beyond the requested size
-		 */
-		if (((i + 1) == count))
-			last_block_size = size - (i * PAGE_SIZE);
-		
-		err = do_writepage(c, inode, &page, last_block_size);
-		if (err)
-			break;
+/*
+ * The file being written by ubifs_stream_begin() and friends. Data goes to
+ * the file @tmp, @name is the file it replaces once finished. Data is
+ * collected in @data until a whole block is there, so a stream uses one
+ * block of memory whatever the size of the file. @inum is the inode of @tmp,
+ * zero when no stream is open.
+ */
+static struct {
+	ino_t inum;
+	char *name;
+	char *tmp;
+	loff_t size;
+	int len;
+	void *data;
+} ubifs_stream;
+
+/**
+ * stream_is - check that a file is the one being streamed.
+ * @filename: absolute path of the file, as given to ubifs_stream_begin()
+ */
+static int stream_is(const char *filename)
+{
+	return ubifs_stream.inum && !strcmp(filename, ubifs_stream.name);
+}
+
+/**
+ * stream_busy - check that an inode is being written by the stream.
+ * @inum: inode number
+ *
+ * Writes, truncation and unlinking of the inode are refused until the stream
+ * is finished or aborted.
+ */
+static int stream_busy(unsigned long inum)
+{
+	return ubifs_stream.inum && inum == ubifs_stream.inum;
+}
+
+int ubifs_write(const char *filename, void *buf, loff_t offset,
+	       loff_t size, loff_t *actwritten)
+{
+	struct ubifs_info *c = ubifs_sb->s_fs_info;
+	struct inode *inode;
+	struct ubifs_inode *ui;
+	int err = 0, ret;
 
-		page.addr += PAGE_SIZE;
-		page.index++;
+	*actwritten = 0;
+
+	ubifs_open_vol(c, UBI_READWRITE);
+	inode = ubifs_iget_create(filename);
+	if (IS_ERR(inode)) {
+		err = PTR_ERR(inode);
+		goto out;
+	}
+	if (stream_busy(inode->i_ino)) {
+		err = -EBUSY;
+		goto out_inode;
 	}
 
-	if (err) {
+	ui = ubifs_inode(inode);
+	err = do_writerange(c, inode, buf, offset, size, actwritten);
+	if (err)
 		debug("Error writing file '%s'\n", filename);
-		*actwritten = i * PAGE_SIZE;
-	} else {
-		*actwritten = size;
-	}
 
 	if (inode->i_size < offset + *actwritten) {
 		inode->i_size = offset + *actwritten;
 		ui->ui_size = offset + *actwritten;
 		ui->dirty = 1;
-		err = ubifs_jnl_write_inode(c, inode);
-		if (err)
+		ret = ubifs_pcache_set_size(c, inode);
+		if (ret) {
+			err = ret;
 			goto out_inode;
+		}
 	}
 
-	ubifs_run_commit(c);
+	if (!ubifs_pcache_writeback())
+		ubifs_run_commit(c);
 
 out_inode:
 	ubifs_iput(inode);
 out:
-	ubi_close_volume(c->ubi);
+	ubifs_close_vol(c);
 	return err;
 }
 
-int ubifs_unlink(const char *filename)
+/**
+ * ubifs_append - append data at the end of a file.
+ * @filename: absolute path of the file, created if it does not exist
+ * @buf: data to append
+ * @size: number of bytes to append
+ * @actwritten: number of bytes appended is returned here
+ *
+ * The data goes at the current inode size, so the caller does not need to
+ * look the size up first. Only the bytes that are new produce data nodes,
+ * and the inode is written once per call. Instead of a full commit the
+ * write-buffers holding the file are synchronized, so the data survives a
+ * power cut through journal replay. With a write-back page cache all of this
+ * happens when the file is flushed instead. Returns zero in case of success
+ * and a negative error code in case of failure.
+ */
+int ubifs_append(const char *filename, void *buf, loff_t size,
+		 loff_t *actwritten)
 {
 	struct ubifs_info *c = ubifs_sb->s_fs_info;
-	unsigned long inum, idir;
-	struct inode *inode, *dir;
-	struct ubifs_inode *dir_ui;
-	int err, sz_change, budgeted = 1;
-	struct ubifs_budget_req req = { .mod_dent = 1, .dirtied_ino = 2 };
-	unsigned int saved_nlink;
-	struct qstr nm;
-	char *p;
+	struct inode *inode;
+	struct ubifs_inode *ui;
+	int err, ret;
 
-	p = strrchr(filename, '/');
-	if (!p) {
-		debug("%s: File path is not absolute '%s'!\n", __func__, filename);
-		err = -EINVAL;
+	*actwritten = 0;
+
+	ubifs_open_vol(c, UBI_READWRITE);
+	inode = ubifs_iget_create(filename);
+	if (IS_ERR(inode)) {
+		err = PTR_ERR(inode);
 		goto out;
 	}
-		
-	nm.name = p + 1;
-	nm.len = strlen(p + 1);
-		
-	c->ubi = ubi_open_volume(c->vi.ubi_num, c->vi.vol_id, UBI_READWRITE);
-
-	/*
-	 * Budget request settings: deletion direntry, deletion inode (+1 for
-	 * @dirtied_ino), changing the parent directory inode. If budgeting
-	 * fails, go ahead anyway because we have extra space reserved for
-	 * deletions.
-
-	 */
+	if (stream_busy(inode->i_ino)) {
+		err = -EBUSY;
+		goto out_inode;
+	}
 
+	ui = ubifs_inode(inode);
+	err = do_appendrange(c, inode, buf, size, actwritten);
+	if (err)
+		debug("Error appending to file '%s'\n", filename);
 
+	if (*actwritten) {
+		inode->i_size += *actwritten;
+		ui->ui_size = inode->i_size;
+		ui->dirty = 1;
+		ret = ubifs_pcache_set_size(c, inode);
+		if (!ret && !ubifs_pcache_writeback())
+			ret = ubifs_sync_wbufs_by_inode(c, inode);
+		if (ret)
+			err = ret;
+	}
 
-	inum = ubifs_findfile(ubifs_sb, (char *)filename, &idir);
+out_inode:
+	ubifs_iput(inode);
+out:
+	ubifs_close_vol(c);
+	return err;
+}
 
+/**
+ * ubifs_iget_file - look up a regular file to be changed.
+ * @filename: absolute path of the file
+ *
+ * Must be called with the volume open. Returns the inode, or an ERR_PTR in
+ * case of failure, -EBUSY for a file being streamed.
+ */
+static struct inode *ubifs_iget_file(const char *filename)
+{
+	struct inode *inode;
+	unsigned long inum;
 
+	inum = ubifs_findfile(ubifs_sb, (char *)filename, NULL);
+	if (!inum)
+		return ERR_PTR(-ENOENT);
 
-	if (!inum) {
-		debug("%s: No inode for '%s'!\n", __func__, filename);
-		err = -ENOENT;
-		goto out;
+	inode = ubifs_iget(ubifs_sb, inum);
+	if (IS_ERR(inode)) {
+		debug("%s: Error reading inode %ld!\n", __func__, inum);
+		return inode;
+	}
+	if (!S_ISREG(inode->i_mode)) {
+		ubifs_iput(inode);
+		return ERR_PTR(-EISDIR);
+	}
+	if (stream_busy(inum)) {
+		ubifs_iput(inode);
+		return ERR_PTR(-EBUSY);
 	}
+	return inode;
+}
 
-	dir = ubifs_iget(ubifs_sb, idir);
+/**
+ * drop_cached - get cached data of an inode to flash and forget it.
+ * @c: UBIFS file-system description object
+ * @inode: inode about to have data nodes removed
+ *
+ * The caches would otherwise hand out blocks that are no longer there.
+ */
+static int drop_cached(struct ubifs_info *c, struct inode *inode)
+{
+	int err;
 
-	if (IS_ERR(dir)) {
+	ubifs_tail_forget(inode->i_ino);
+	err = ubifs_pcache_flush(c, inode->i_ino);
+	ubifs_pcache_forget(inode->i_ino);
+	return err;
+}
 
-		debug("%s: No parent dir inode for '%s'!\n", __func__, filename);
+/**
+ * ubifs_truncate - change the size of a file.
+ * @filename: absolute path of the file
+ * @size: new size in bytes
+ *
+ * Shrinking writes one truncation node along with the inode, and drops the
+ * data nodes beyond @size from the index, so it costs the same whatever
+ * amount of data goes. Growing only writes the inode, the new part reads
+ * back as zeroes. Returns zero in case of success and a negative error code
+ * in case of failure.
+ */
+int ubifs_truncate(const char *filename, loff_t size)
+{
+	struct ubifs_info *c = ubifs_sb->s_fs_info;
+	struct ubifs_budget_req req = { .dirtied_ino = 1, .recalculate = 1 };
+	struct ubifs_inode *ui;
+	struct inode *inode;
+	loff_t old_size;
+	int err, budgeted = 1;
 
-		err = PTR_ERR(dir);
-		goto out;
-	}
-	dir_ui = ubifs_inode(dir);
+	if (size < 0 || size > c->max_inode_sz)
+		return -EINVAL;
 
-	if (!inum) {
-		debug("%s: No inode for '%s'!\n", __func__, filename);
+	ubifs_open_vol(c, UBI_READWRITE);
+	inode = ubifs_iget_file(filename);
+	if (IS_ERR(inode)) {
 		err = PTR_ERR(inode);
-		goto out_dir;
+		goto out;
 	}
 
-	inode = ubifs_iget(ubifs_sb, inum);
-	if (IS_ERR(inode)) {
-		debug("%s: Error reading inode %ld!\n", __func__, inum);
-		err = PTR_ERR(inode);
-		goto out_dir;
+	ui = ubifs_inode(inode);
+	old_size = inode->i_size;
+	if (size == old_size) {
+		err = 0;
+		goto out_inode;
 	}
-	
-	sz_change = CALC_DENT_SIZE(fname_len(&nm));
+
+	dbg_gen("ino %lu, size %lld -> %lld", inode->i_ino, old_size, size);
+	err = drop_cached(c, inode);
+	if (err)
+		goto out_inode;
 
 	err = ubifs_budget_space(c, &req);
 	if (err) {
-		if (err != -ENOSPC)
+		/* Shrinking frees space, so it is allowed like unlink */
+		if (size > old_size || err != -ENOSPC)
 			goto out_inode;
 		budgeted = 0;
 	}
 
-	inode->i_ctime = dir->i_ctime;
-	saved_nlink = inode->i_nlink;
-	inode->__i_nlink--;
-	dir->i_size -= sz_change;
-	dir_ui->ui_size = dir->i_size;
-	dir->i_mtime = dir->i_ctime = inode->i_ctime;
-	dir->__i_nlink--;
-	err = ubifs_jnl_update(c, dir, &nm, inode, 1, 0);
-	if (err)
-		goto out_cancel;
-	err = ubifs_jnl_write_inode(c, inode);
-	if (err)
-		goto out_cancel;
+	inode->i_size = size;
+	ui->ui_size = size;
+	ui->dirty = 1;
+	if (size > old_size)
+		err = ubifs_jnl_write_inode(c, inode);
+	else
+		err = ubifs_jnl_truncate(c, inode, old_size, size);
 
 	if (budgeted)
 		ubifs_release_budget(c, &req);
 	else {
-		/* We've deleted something - clean the "no space" flags */
 		c->bi.nospace = c->bi.nospace_rp = 0;
 		smp_wmb();
 	}
+	if (!err && !ubifs_pcache_writeback())
+		err = ubifs_sync_wbufs_by_inode(c, inode);
 
-	ubifs_iput(dir);
-	ubifs_iput(inode);
-
-	ubi_close_volume(c->ubi);
-	return 0;
-
-out_cancel:
-	dir->i_size += sz_change;
-	dir_ui->ui_size = dir->i_size;
-	dir->__i_nlink++;
-	set_nlink(inode, saved_nlink);
-	if (budgeted)
-		ubifs_release_budget(c, &req);
 out_inode:
 	ubifs_iput(inode);
-out_dir:
-	ubifs_iput(dir);
 out:
-	ubi_close_volume(c->ubi);
+	ubifs_close_vol(c);
 	return err;
 }
 
-void ubifs_close(void)
-{
-}
-
+/**
+ * zero_block_range - zero part of a data block of an inode.
+ * @c: UBIFS file-system description object
+ * @inode: inode the block belongs to
+ * @block: block number
+ * @from: first byte in the block to zero
+ * @to: byte in the block after the last one to zero
+ * @bounce: buffer of one block
+ * @dn: buffer for the data node
+ *
+ * When nothing follows the range the block is just cut short. Returns zero
+ * in case of success and a negative error code in case of failure.
+ */
+static int zero_block_range(struct ubifs_info *c, struct inode *inode,
+			    unsigned int block, int from, int to,
+			    void *bounce, struct ubifs_data_node *dn)
+{
+	loff_t bstart = (loff_t)block << UBIFS_BLOCK_SHIFT;
+	int len, err;
+
+	err = read_block(inode, bounce, block, dn);
+	if (err == -ENOENT)
+		/* Already a hole */
+		return 0;
+	if (err)
+		return err;
+
+	len = min_t(loff_t, inode->i_size - bstart, UBIFS_BLOCK_SIZE);
+	if (from >= len)
+		return 0;
+	if (to >= len && from > 0)
+		len = from;
+	else
+		memset(bounce + from, 0, min(to, len) - from);
+	return ubifs_pcache_write_uncached(c, inode, block, bounce, len);
+}
+
+/**
+ * ubifs_punch_hole - discard a byte range of a file.
+ * @filename: absolute path of the file
+ * @offset: first byte of the range
+ * @size: length of the range
+ *
+ * The range reads back as zeroes afterwards and the file size stays the
+ * same. Data nodes of the blocks wholly inside the range are dropped with a
+ * single truncation node covering them, which replay applies the same way,
+ * so dropping the head of a log costs the same whatever its length. Only the
+ * partial blocks at either end of the range are rewritten. Returns zero in
+ * case of success and a negative error code in case of failure.
+ */
+int ubifs_punch_hole(const char *filename, loff_t offset, loff_t size)
+{
+	struct ubifs_info *c = ubifs_sb->s_fs_info;
+	struct ubifs_budget_req req = { .dirtied_ino = 1, .recalculate = 1 };
+	struct ubifs_data_node *dn = NULL;
+	void *bounce = NULL;
+	struct inode *inode;
+	unsigned int sblk, eblk;
+	int soffs, eoffs, err, budgeted = 1;
+	loff_t end;
+
+	if (offset < 0 || size < 0)
+		return -EINVAL;
+
+	ubifs_open_vol(c, UBI_READWRITE);
+	inode = ubifs_iget_file(filename);
+	if (IS_ERR(inode)) {
+		err = PTR_ERR(inode);
+		goto out;
+	}
+
+	end = min_t(loff_t, offset + size, inode->i_size);
+	if (offset >= end) {
+		err = 0;
+		goto out_inode;
+	}
+
+	dbg_gen("ino %lu, offset %lld, size %lld", inode->i_ino, offset, size);
+	err = drop_cached(c, inode);
+	if (err)
+		goto out_inode;
+
+	bounce = malloc_cache_aligned(UBIFS_BLOCK_SIZE);
+	dn = kmalloc(UBIFS_MAX_DATA_NODE_SZ, GFP_NOFS);
+	if (!bounce || !dn) {
+		err = -ENOMEM;
+		goto out_free;
+	}
+
+	sblk = offset >> UBIFS_BLOCK_SHIFT;
+	soffs = offset & (UBIFS_BLOCK_SIZE - 1);
+	eblk = end >> UBIFS_BLOCK_SHIFT;
+	eoffs = end & (UBIFS_BLOCK_SIZE - 1);
+	if (end == inode->i_size && eoffs) {
+		/* The last block goes as a whole */
+		eblk += 1;
+		eoffs = 0;
+	}
+
+	if (sblk == eblk) {
+		err = zero_block_range(c, inode, sblk, soffs, eoffs, bounce,
+				       dn);
+		goto out_sync;
+	}
+	if (soffs) {
+		err = zero_block_range(c, inode, sblk, soffs, UBIFS_BLOCK_SIZE,
+				       bounce, dn);
+		if (err)
+			goto out_free;
+		sblk += 1;
+	}
+	if (eoffs) {
+		err = zero_block_range(c, inode, eblk, 0, eoffs, bounce, dn);
+		if (err)
+			goto out_free;
+	}
+	if (sblk == eblk)
+		goto out_sync;
+
+	err = ubifs_budget_space(c, &req);
+	if (err) {
+		/* Punching frees space, so it is allowed like unlink */
+		if (err != -ENOSPC)
+			goto out_free;
+		budgeted = 0;
+	}
+
+	/* The inode keeps its size, the truncation node only names the blocks */
+	ubifs_inode(inode)->dirty = 1;
+	err = ubifs_jnl_truncate(c, inode, (loff_t)eblk << UBIFS_BLOCK_SHIFT,
+				 (loff_t)sblk << UBIFS_BLOCK_SHIFT);
+
+	if (budgeted)
+		ubifs_release_budget(c, &req);
+	else {
+		c->bi.nospace = c->bi.nospace_rp = 0;
+		smp_wmb();
+	}
+
+out_sync:
+	if (!err && !ubifs_pcache_writeback())
+		err = ubifs_sync_wbufs_by_inode(c, inode);
+out_free:
+	kfree(dn);
+	kfree(bounce);
+out_inode:
+	ubifs_iput(inode);
+out:
+	ubifs_close_vol(c);
+	return err;
+}
+
+#ifdef CONFIG_UBIFS_HOT_JHEAD
+/**
+ * ubifs_set_hot - mark a file or directory as holding often rewritten data.
+ * @filename: absolute path of an existing file or directory
+ * @hot: non-zero to set the hint, zero to clear it
+ *
+ * Data nodes of hot inodes are written to a journal head of their own, so
+ * LEBs do not end up holding both data that is about to be rewritten and
+ * data that is not, which GC would then have to copy. Data already on flash
+ * stays where it is. Files and directories created in a hot directory are
+ * hot as well. The first inode marked hot adds the hot journal head, see
+ * 'ubifs_add_hot_head()'. The inode is on flash when this function returns.
+ * Returns zero in case of success and a negative error code in case of
+ * failure.
+ */
+int ubifs_set_hot(const char *filename, int hot)
+{
+	struct ubifs_info *c = ubifs_sb->s_fs_info;
+	struct ubifs_budget_req req = { .dirtied_ino = 1 };
+	struct ubifs_inode *ui;
+	struct inode *inode;
+	unsigned long inum;
+	int err, flags;
+
+	ubifs_open_vol(c, UBI_READWRITE);
+	inum = ubifs_findfile(ubifs_sb, (char *)filename, NULL);
+	if (!inum) {
+		err = -ENOENT;
+		goto out;
+	}
+
+	inode = ubifs_iget(ubifs_sb, inum);
+	if (IS_ERR(inode)) {
+		debug("%s: Error reading inode %ld!\n", __func__, inum);
+		err = PTR_ERR(inode);
+		goto out;
+	}
+
+	ui = ubifs_inode(inode);
+	flags = hot ? ui->flags | UBIFS_HOT_FL : ui->flags & ~UBIFS_HOT_FL;
+	if (flags == ui->flags) {
+		err = 0;
+		goto out_inode;
+	}
+
+	if (hot) {
+		err = ubifs_add_hot_head(c);
+		if (err)
+			goto out_inode;
+	}
+
+	err = ubifs_budget_space(c, &req);
+	if (err)
+		goto out_inode;
+
+	ui->flags = flags;
+	ui->dirty = 1;
+	err = ubifs_jnl_write_inode(c, inode);
+	ubifs_release_budget(c, &req);
+	if (!err)
+		err = ubifs_sync_wbufs_by_inode(c, inode);
+
+out_inode:
+	ubifs_iput(inode);
+out:
+	ubifs_close_vol(c);
+	return err;
+}
+#endif
+
+int ubifs_unlink(const char *filename)
+{
+	struct ubifs_info *c = ubifs_sb->s_fs_info;
+	unsigned long inum, idir;
+	struct inode *inode, *dir;
+	struct ubifs_inode *dir_ui;
+	int err, sz_change, budgeted = 1;
+	struct ubifs_budget_req req = { .mod_dent = 1, .dirtied_ino = 2 };
+	unsigned int saved_nlink;
+	struct qstr nm;
+	char *p;
+
+	p = strrchr(filename, '/');
+	if (!p) {
+		debug("%s: File path is not absolute '%s'!\n", __func__, filename);
+		err = -EINVAL;
+		goto out;
+	}
+		
+	nm.name = p + 1;
+	nm.len = strlen(p + 1);
+		
+	ubifs_open_vol(c, UBI_READWRITE);
+
+	/*
+	 * Budget request settings: deletion direntry, deletion inode (+1 for
+	 * @dirtied_ino), changing the parent directory inode. If budgeting
+	 * fails, go ahead anyway because we have extra space reserved for
+	 * deletions.
+
+	 */
+
+
+
+	inum = ubifs_findfile(ubifs_sb, (char *)filename, &idir);
+
+
+
+	if (!inum) {
+		debug("%s: No inode for '%s'!\n", __func__, filename);
+		err = -ENOENT;
+		goto out;
+	}
+	if (stream_busy(inum)) {
+		err = -EBUSY;
+		goto out;
+	}
+
+	dir = ubifs_iget(ubifs_sb, idir);
+
+	if (IS_ERR(dir)) {
+
+		debug("%s: No parent dir inode for '%s'!\n", __func__, filename);
+
+		err = PTR_ERR(dir);
+		goto out;
+	}
+	dir_ui = ubifs_inode(dir);
+
+	if (!inum) {
+		debug("%s: No inode for '%s'!\n", __func__, filename);
+		err = PTR_ERR(inode);
+		goto out_dir;
+	}
+
+	inode = ubifs_iget(ubifs_sb, inum);
+	if (IS_ERR(inode)) {
+		debug("%s: Error reading inode %ld!\n", __func__, inum);
+		err = PTR_ERR(inode);
+		goto out_dir;
+	}
+	ubifs_tail_forget(inode->i_ino);
+	ubifs_pcache_forget(inode->i_ino);
+	
+	sz_change = CALC_DENT_SIZE(fname_len(&nm));
+
+	err = ubifs_budget_space(c, &req);
+	if (err) {
+		if (err != -ENOSPC)
+			goto out_inode;
+		budgeted = 0;
+	}
+
+	inode->i_ctime = dir->i_ctime;
+	saved_nlink = inode->i_nlink;
+	inode->__i_nlink--;
+	dir->i_size -= sz_change;
+	dir_ui->ui_size = dir->i_size;
+	dir->i_mtime = dir->i_ctime = inode->i_ctime;
+	dir->__i_nlink--;
+	err = ubifs_jnl_update(c, dir, &nm, inode, 1, 0);
+	if (err)
+		goto out_cancel;
+	err = ubifs_jnl_write_inode(c, inode);
+	if (err)
+		goto out_cancel;
+
+	if (budgeted)
+		ubifs_release_budget(c, &req);
+	else {
+		/* We've deleted something - clean the "no space" flags */
+		c->bi.nospace = c->bi.nospace_rp = 0;
+		smp_wmb();
+	}
+
+	ubifs_iput(dir);
+	ubifs_iput(inode);
+
+	ubifs_close_vol(c);
+	return 0;
+
+out_cancel:
+	dir->i_size += sz_change;
+	dir_ui->ui_size = dir->i_size;
+	dir->__i_nlink++;
+	set_nlink(inode, saved_nlink);
+	if (budgeted)
+		ubifs_release_budget(c, &req);
+out_inode:
+	ubifs_iput(inode);
+out_dir:
+	ubifs_iput(dir);
+out:
+	ubifs_close_vol(c);
+	return err;
+}
+
+/**
+ * stream_write_block - write a block of the streamed file.
+ * @c: UBIFS file-system description object
+ * @inode: the streamed file
+ * @addr: block contents
+ * @len: number of valid bytes, less than a block only for the last one
+ */
+static int stream_write_block(struct ubifs_info *c, struct inode *inode,
+			      const void *addr, int len)
+{
+	unsigned int block = ubifs_stream.size >> UBIFS_BLOCK_SHIFT;
+
+	return ubifs_pcache_write_uncached(c, inode, block, addr, len);
+}
+
+/**
+ * stream_close - forget the stream.
+ */
+static void stream_close(void)
+{
+	ubifs_stream.inum = 0;
+	kfree(ubifs_stream.name);
+	ubifs_stream.name = NULL;
+	kfree(ubifs_stream.tmp);
+	ubifs_stream.tmp = NULL;
+}
+
+/**
+ * ubifs_stream_begin - start writing a file in chunks.
+ * @filename: absolute path of the file, replaced if it exists
+ *
+ * This is for files too large to be passed to ubifs_write() in one buffer,
+ * like a firmware image coming in over a serial line. The chunks are passed
+ * to ubifs_stream_write() and the file is completed by ubifs_stream_finish()
+ * or dropped by ubifs_stream_abort(), each given the same @filename as
+ * ubifs_stream_begin(). The data goes to @filename with UBIFS_STREAM_SUFFIX
+ * appended, and @filename keeps its old contents until the finish, so a
+ * power cut or an abort never loses them. A temporary file left behind by a
+ * power cut is removed here. The volume may be unmounted and mounted again
+ * in between. Only one stream can be open at a time. Returns zero in case of
+ * success and a negative error code in case of failure.
+ */
+int ubifs_stream_begin(const char *filename)
+{
+	struct ubifs_info *c = ubifs_sb->s_fs_info;
+	struct inode *inode;
+	int err;
+
+	if (ubifs_stream.inum)
+		return -EBUSY;
+
+	if (!ubifs_stream.data) {
+		ubifs_stream.data = malloc_cache_aligned(UBIFS_BLOCK_SIZE);
+		if (!ubifs_stream.data)
+			return -ENOMEM;
+	}
+	ubifs_stream.name = kmalloc(strlen(filename) + 1, GFP_NOFS);
+	ubifs_stream.tmp = kmalloc(strlen(filename) +
+				   sizeof(UBIFS_STREAM_SUFFIX), GFP_NOFS);
+	if (!ubifs_stream.name || !ubifs_stream.tmp) {
+		err = -ENOMEM;
+		goto out_name;
+	}
+	strcpy(ubifs_stream.name, filename);
+	strcpy(ubifs_stream.tmp, filename);
+	strcat(ubifs_stream.tmp, UBIFS_STREAM_SUFFIX);
+
+	if (ubifs_exists(ubifs_stream.tmp)) {
+		err = ubifs_unlink(ubifs_stream.tmp);
+		if (err)
+			goto out_name;
+	}
+
+	ubifs_open_vol(c, UBI_READWRITE);
+	inode = ubifs_iget_create(ubifs_stream.tmp);
+	if (IS_ERR(inode)) {
+		err = PTR_ERR(inode);
+		ubifs_close_vol(c);
+		goto out_name;
+	}
+
+	ubifs_stream.inum = inode->i_ino;
+	ubifs_stream.size = 0;
+	ubifs_stream.len = 0;
+	ubifs_iput(inode);
+	ubifs_close_vol(c);
+	return 0;
+
+out_name:
+	stream_close();
+	return err;
+}
+
+/**
+ * ubifs_stream_write - write the next chunk of the streamed file.
+ * @filename: absolute path of the streamed file
+ * @buf: data
+ * @size: number of bytes, any size
+ *
+ * Whole blocks go to the journal as they fill up, the remainder is kept
+ * until the next chunk. On error the stream stays open and should be
+ * aborted. Returns zero in case of success and a negative error code in case
+ * of failure.
+ */
+int ubifs_stream_write(const char *filename, const void *buf, loff_t size)
+{
+	struct ubifs_info *c = ubifs_sb->s_fs_info;
+	struct inode *inode;
+	int len, err = 0;
+
+	if (!stream_is(filename))
+		return -EBADF;
+
+	ubifs_open_vol(c, UBI_READWRITE);
+	inode = ubifs_iget(ubifs_sb, ubifs_stream.inum);
+	if (IS_ERR(inode)) {
+		err = PTR_ERR(inode);
+		goto out;
+	}
+
+	while (size > 0) {
+		if (!ubifs_stream.len && size >= UBIFS_BLOCK_SIZE) {
+			/* Aligned whole block, no need to copy it */
+			err = stream_write_block(c, inode, buf,
+						 UBIFS_BLOCK_SIZE);
+			if (err)
+				break;
+			ubifs_stream.size += UBIFS_BLOCK_SIZE;
+			buf += UBIFS_BLOCK_SIZE;
+			size -= UBIFS_BLOCK_SIZE;
+			continue;
+		}
+
+		len = min_t(loff_t, size, UBIFS_BLOCK_SIZE - ubifs_stream.len);
+		memcpy(ubifs_stream.data + ubifs_stream.len, buf, len);
+		ubifs_stream.len += len;
+		buf += len;
+		size -= len;
+		if (ubifs_stream.len == UBIFS_BLOCK_SIZE) {
+			err = stream_write_block(c, inode, ubifs_stream.data,
+						 UBIFS_BLOCK_SIZE);
+			if (err)
+				break;
+			ubifs_stream.size += UBIFS_BLOCK_SIZE;
+			ubifs_stream.len = 0;
+		}
+	}
+
+	ubifs_iput(inode);
+out:
+	ubifs_close_vol(c);
+	return err;
+}
+
+/**
+ * ubifs_stream_finish - complete the streamed file.
+ * @filename: absolute path of the streamed file
+ *
+ * Writes the last partial block and the inode with the final size and
+ * commits. Only then the temporary file is renamed over @filename with
+ * 'ubifs_rename()', so after a power cut @filename holds either its old
+ * contents or all of the new ones. The file is complete on flash when this
+ * returns. The stream is closed even if this fails, and the temporary file
+ * is removed. Returns zero in case of success and a negative error code in
+ * case of failure.
+ */
+int ubifs_stream_finish(const char *filename)
+{
+	struct ubifs_info *c = ubifs_sb->s_fs_info;
+	struct inode *inode;
+	int err = 0;
+
+	if (!stream_is(filename))
+		return -EBADF;
+
+	ubifs_open_vol(c, UBI_READWRITE);
+	inode = ubifs_iget(ubifs_sb, ubifs_stream.inum);
+	if (IS_ERR(inode)) {
+		err = PTR_ERR(inode);
+		goto out;
+	}
+
+	if (ubifs_stream.len) {
+		err = stream_write_block(c, inode, ubifs_stream.data,
+					 ubifs_stream.len);
+		if (err)
+			goto out_inode;
+		ubifs_stream.size += ubifs_stream.len;
+	}
+
+	inode->i_size = ubifs_stream.size;
+	ubifs_inode(inode)->ui_size = ubifs_stream.size;
+	ubifs_inode(inode)->dirty = 1;
+	err = ubifs_jnl_write_inode(c, inode);
+	if (!err)
+		/* The new name must not refer to data still in a write-buffer */
+		err = ubifs_run_commit(c);
+
+out_inode:
+	ubifs_iput(inode);
+out:
+	ubifs_close_vol(c);
+	ubifs_stream.inum = 0;
+	if (!err) {
+		err = ubifs_rename(ubifs_stream.tmp, ubifs_stream.name);
+		if (!err && ubifs_pcache_writeback()) {
+			/* ubifs_rename() leaves the rename to the next sync */
+			ubifs_open_vol(c, UBI_READWRITE);
+			err = ubifs_run_commit(c);
+			ubifs_close_vol(c);
+		}
+	} else {
+		ubifs_unlink(ubifs_stream.tmp);
+	}
+	stream_close();
+	return err;
+}
+
+/**
+ * ubifs_stream_abort - drop the streamed file.
+ * @filename: absolute path of the streamed file
+ *
+ * The temporary file is removed along with whatever was written to it,
+ * @filename is left as it was. Returns zero in case of success and a
+ * negative error code in case of failure.
+ */
+int ubifs_stream_abort(const char *filename)
+{
+	int err;
+
+	if (!stream_is(filename))
+		return -EBADF;
+
+	ubifs_stream.inum = 0;
+	err = ubifs_unlink(ubifs_stream.tmp);
+	stream_close();
+	return err;
+}
+
+/**
+ * ubifs_find_parent - look up the directory a path lives in.
+ * @filename: absolute path
+ * @nm: the last component of @filename is returned here
+ *
+ * Unlike ubifs_findfile(), which reports the deepest directory it got to,
+ * this fails when a directory on the way is missing. Must be called with the
+ * volume open. Returns the inode number of the directory, or zero if there
+ * is no such directory.
+ */
+static unsigned long ubifs_find_parent(const char *filename, struct qstr *nm)
+{
+	char dname[128];
+	const char *p;
+	int len;
+
+	p = strrchr(filename, '/');
+	if (!p || !p[1]) {
+		debug("%s: Not an absolute file path '%s'!\n", __func__, filename);
+		return 0;
+	}
+
+	len = p - filename;
+	if (len >= (int)sizeof(dname))
+		return 0;
+	memcpy(dname, filename, len);
+	dname[len] = '\0';
+
+	nm->name = p + 1;
+	nm->len = strlen(p + 1);
+	return ubifs_findfile(ubifs_sb, dname, NULL);
+}
+
+/**
+ * ubifs_rename - rename a file, replacing any file of the new name.
+ * @oldname: absolute path of the file
+ * @newname: absolute path to give it
+ *
+ * Both directory entries, the replaced inode and the parent directories go
+ * to flash as one journal group, so after a power cut @newname refers either
+ * to the complete replaced file or to the complete renamed one. Data still
+ * held in the page cache for the renamed file is written before that. Only
+ * regular files can be renamed or replaced. Returns zero in case of success
+ * and a negative error code in case of failure.
+ */
+int ubifs_rename(const char *oldname, const char *newname)
+{
+	struct ubifs_info *c = ubifs_sb->s_fs_info;
+	struct ubifs_budget_req req = { .new_dent = 1, .mod_dent = 1,
+					.dirtied_ino = 3 };
+	struct inode *old_dir = NULL, *new_dir = NULL;
+	struct inode *inode = NULL, *new_inode = NULL;
+	unsigned long odir, ndir, inum, new_inum;
+	struct qstr old_nm, new_nm;
+	int err, old_sz, new_sz;
+
+	if (stream_is(oldname) || stream_is(newname))
+		return -EBUSY;
+
+	ubifs_open_vol(c, UBI_READWRITE);
+	odir = ubifs_find_parent(oldname, &old_nm);
+	ndir = ubifs_find_parent(newname, &new_nm);
+	if (!odir || !ndir) {
+		err = -ENOENT;
+		goto out;
+	}
+	if (fname_len(&new_nm) > UBIFS_MAX_NLEN) {
+		err = -ENAMETOOLONG;
+		goto out;
+	}
+
+	if (!ubifs_finddir(ubifs_sb, (char *)old_nm.name, odir, &inum)) {
+		debug("%s: No inode for '%s'!\n", __func__, oldname);
+		err = -ENOENT;
+		goto out;
+	}
+	if (!ubifs_finddir(ubifs_sb, (char *)new_nm.name, ndir, &new_inum))
+		new_inum = 0;
+	if (stream_busy(inum) || stream_busy(new_inum)) {
+		err = -EBUSY;
+		goto out;
+	}
+	if (new_inum == inum) {
+		/* Both names already refer to the file */
+		err = 0;
+		goto out;
+	}
+
+	dbg_gen("'%s' ino %lu -> '%s' ino %lu", oldname, inum, newname,
+		new_inum);
+
+	/* The new name must not refer to data which is not on flash yet */
+	err = ubifs_pcache_flush(c, inum);
+	if (err)
+		goto out;
+
+	old_dir = ubifs_iget(ubifs_sb, odir);
+	if (IS_ERR(old_dir)) {
+		err = PTR_ERR(old_dir);
+		old_dir = NULL;
+		goto out_put;
+	}
+	/* ubifs_jnl_rename() tells a move by the directory inode pointers */
+	if (ndir == odir)
+		new_dir = old_dir;
+	else {
+		new_dir = ubifs_iget(ubifs_sb, ndir);
+		if (IS_ERR(new_dir)) {
+			err = PTR_ERR(new_dir);
+			new_dir = NULL;
+			goto out_put;
+		}
+	}
+	if (!S_ISDIR(old_dir->i_mode) || !S_ISDIR(new_dir->i_mode)) {
+		err = -ENOTDIR;
+		goto out_put;
+	}
+
+	inode = ubifs_iget(ubifs_sb, inum);
+	if (IS_ERR(inode)) {
+		err = PTR_ERR(inode);
+		inode = NULL;
+		goto out_put;
+	}
+	if (!S_ISREG(inode->i_mode)) {
+		err = -EISDIR;
+		goto out_put;
+	}
+
+	if (new_inum) {
+		new_inode = ubifs_iget(ubifs_sb, new_inum);
+		if (IS_ERR(new_inode)) {
+			err = PTR_ERR(new_inode);
+			new_inode = NULL;
+			goto out_put;
+		}
+		if (!S_ISREG(new_inode->i_mode)) {
+			err = -EISDIR;
+			goto out_put;
+		}
+	}
+
+	err = ubifs_budget_space(c, &req);
+	if (err)
+		goto out_put;
+
+	old_sz = CALC_DENT_SIZE(fname_len(&old_nm));
+	new_sz = CALC_DENT_SIZE(fname_len(&new_nm));
+	old_dir->i_size -= old_sz;
+	ubifs_inode(old_dir)->ui_size = old_dir->i_size;
+	if (new_inode)
+		new_inode->__i_nlink--;
+	else {
+		new_dir->i_size += new_sz;
+		ubifs_inode(new_dir)->ui_size = new_dir->i_size;
+	}
+
+	err = ubifs_jnl_rename(c, old_dir, inode, &old_nm, new_dir, new_inode,
+			       &new_nm, NULL, !ubifs_pcache_writeback());
+	if (err) {
+		if (new_inode)
+			new_inode->__i_nlink++;
+		else {
+			new_dir->i_size -= new_sz;
+			ubifs_inode(new_dir)->ui_size = new_dir->i_size;
+		}
+		old_dir->i_size += old_sz;
+		ubifs_inode(old_dir)->ui_size = old_dir->i_size;
+	} else if (new_inode) {
+		/* Nothing of the replaced file may be written back any more */
+		ubifs_tail_forget(new_inum);
+		ubifs_pcache_forget(new_inum);
+		if (!new_inode->i_nlink)
+			/* Last link gone, drop its nodes as unlink does */
+			err = ubifs_jnl_write_inode(c, new_inode);
+	}
+	ubifs_release_budget(c, &req);
+
+out_put:
+	if (new_inode)
+		ubifs_iput(new_inode);
+	if (inode)
+		ubifs_iput(inode);
+	if (new_dir && new_dir != old_dir)
+		ubifs_iput(new_dir);
+	if (old_dir)
+		ubifs_iput(old_dir);
+out:
+	ubifs_close_vol(c);
+	return err;
+}
+
+void ubifs_close(void)
+{
+}
+
+/**
+ * ubifs_sync - write everything held in the page cache to flash.
+ *
+ * Returns zero in case of success and a negative error code in case of
+ * failure.
+ */
+int ubifs_sync(void)
+{
+	struct ubifs_info *c;
+	int err;
+
+	if (!ubifs_sb)
+		return -ENODEV;
+
+	c = ubifs_sb->s_fs_info;
+	ubifs_open_vol(c, UBI_READWRITE);
+	err = ubifs_pcache_sync(c);
+	if (!err)
+		err = ubifs_run_commit(c);
+	ubifs_close_vol(c);
+	return err;
+}
+
+/**
+ * ubifs_fsync - write the data and size of one file held in the page cache.
+ * @filename: absolute path of the file
+ *
+ * Only the data nodes and inode of this file are written and their
+ * write-buffers synchronized, no commit is run: the journal replay recovers
+ * them after a power cut. Returns zero in case of success and a negative
+ * error code in case of failure.
+ */
+int ubifs_fsync(const char *filename)
+{
+	struct ubifs_info *c;
+	unsigned long inum;
+	int err;
+
+	if (!ubifs_sb)
+		return -ENODEV;
+
+	c = ubifs_sb->s_fs_info;
+	ubifs_open_vol(c, UBI_READWRITE);
+	inum = ubifs_findfile(ubifs_sb, (char *)filename, NULL);
+	if (!inum)
+		err = -ENOENT;
+	else
+		err = ubifs_pcache_flush(c, inum);
+	ubifs_close_vol(c);
+	return err;
+}
+
+/**
+ * ubifs_sync_expired - write back page cache data older than the max. age.
+ *
+ * Returns zero in case of success and a negative error code in case of
+ * failure.
+ */
+int ubifs_sync_expired(void)
+{
+	struct ubifs_info *c;
+	int err;
+
+	if (!ubifs_sb)
+		return -ENODEV;
+
+	c = ubifs_sb->s_fs_info;
+	ubifs_open_vol(c, UBI_READWRITE);
+	err = ubifs_pcache_expire(c);
+	ubifs_close_vol(c);
+	return err;
+}
+
+/**
+ * ubifs_next_writeback - milliseconds until ubifs_sync_expired() has work.
+ *
+ * Returns zero if it has work already, or -1 if nothing is held back.
+ */
+long ubifs_next_writeback(void)
+{
+	if (!ubifs_sb)
+		return -1;
+	return ubifs_pcache_next_expiry();
+}
+
+#ifdef CONFIG_UBIFS_BG_GC_LEBS
+/**
+ * ubifs_bg_gc - garbage-collect one dirty LEB in idle time.
+ * @yield: returns non-zero when a foreground request is waiting
+ *
+ * Returns %1 if an LEB was collected, %0 if there is nothing to do, %-EINTR if
+ * @yield stopped the collection and other negative error codes in case of
+ * failure. See 'ubifs_bg_garbage_collect()'.
+ */
+int ubifs_bg_gc(int (*yield)(void))
+{
+	struct ubifs_info *c;
+	int err;
+
+	if (!ubifs_sb)
+		return 0;
+
+	c = ubifs_sb->s_fs_info;
+	ubifs_open_vol(c, UBI_READWRITE);
+	err = ubifs_bg_garbage_collect(c, CONFIG_UBIFS_BG_GC_LEBS, yield);
+	ubifs_close_vol(c);
+	return err;
+}
+#endif
+
 /* Compat wrappers for common/cmd_ubifs.c */
 int ubifs_load(char *filename, u32 addr, u32 size)
 {
@@ -1853,7 +3205,16 @@ void uboot_ubifs_umount(void)
 
 		debug("Unmounting UBIFS volume %s!\n",
 		       ((struct ubifs_info *)(ubifs_sb->s_fs_info))->vi.name);
+		ubifs_tail.inum = 0;
+		kfree(ubifs_tail.data);
+		ubifs_tail.data = NULL;
+		if (ubifs_sync())
+			ubifs_err(c, "cannot write back the page cache");
+		ubifs_pcache_destroy(c);
 		ubifs_umount(c);
 		ubifs_sb = NULL;
+#ifdef CONFIG_KMEM_LEAK_REPORT
+		kmem_leak_check("UBIFS unmount");
+#endif
 	}
 }
@@ -768,6 +768,7 @@ static inline ino_t parent_ino(struct dentry *dentry)
 #define GCHD   UBIFS_GC_HEAD
 #define BASEHD UBIFS_BASE_HEAD
 #define DATAHD UBIFS_DATA_HEAD
+#define HOTHD  UBIFS_HOT_HEAD
 
 /* 'No change' value for 'ubifs_change_lp()' */
 #define LPROPS_NC 0x80000001
@@ -1804,6 +1805,9 @@ struct ubifs_debug_info;
  *
  * @gc_lnum: LEB number used for garbage collection
  * @sbuf: a buffer of LEB size used by GC and replay for scanning
+ * @leb_stamp: per LEB, the sequence number of the newest node written to it
+ *             since mount, or of the newest of its last nodes, or 0 if not
+ *             known yet (cost-benefit GC)
  * @idx_gc: list of index LEBs that have been garbage collected
  * @idx_gc_cnt: number of elements on the idx_gc list
  * @gc_seq: incremented for every non-index LEB garbage collected
@@ -2039,6 +2043,9 @@ struct ubifs_info {
 
 	int gc_lnum;
 	void *sbuf;
+#ifdef CONFIG_UBIFS_GC_COST_BENEFIT
+	unsigned long long *leb_stamp;
+#endif
 	struct list_head idx_gc;
 	int idx_gc_cnt;
 	int gc_seq;
@@ -2168,6 +2175,11 @@ int ubifs_sync_wbufs_by_inode(struct ubifs_info *c, struct inode *inode);
 /* scan.c */
 struct ubifs_scan_leb *ubifs_scan(const struct ubifs_info *c, int lnum,
 				  int offs, void *sbuf, int quiet);
+#ifdef CONFIG_UBIFS_BG_GC_LEBS
+struct ubifs_scan_leb *ubifs_scan_yield(const struct ubifs_info *c, int lnum,
+					void *sbuf, int quiet,
+					int (*yield)(void));
+#endif
 void ubifs_scan_destroy(struct ubifs_scan_leb *sleb);
 int ubifs_scan_a_node(const struct ubifs_info *c, void *buf, int len, int lnum,
 		      int offs, int quiet);
@@ -2333,6 +2345,10 @@ int ubifs_gc_end_commit(struct ubifs_info *c);
 void ubifs_destroy_idx_gc(struct ubifs_info *c);
 int ubifs_get_idx_gc_leb(struct ubifs_info *c);
 int ubifs_garbage_collect_leb(struct ubifs_info *c, struct ubifs_lprops *lp);
+#ifdef CONFIG_UBIFS_BG_GC_LEBS
+int ubifs_bg_garbage_collect(struct ubifs_info *c, int target,
+			     int (*yield)(void));
+#endif
 
 /* orphan.c */
 int ubifs_add_orphan(struct ubifs_info *c, ino_t inum);
@@ -2429,6 +2445,9 @@ static inline int ubifs_init_security(struct inode *dentry, struct inode *inode,
 /* super.c */
 struct inode *ubifs_iget(struct super_block *sb, unsigned long inum);
 int ubifs_iput(struct inode *inode);
+#ifdef CONFIG_UBIFS_HOT_JHEAD
+int ubifs_add_hot_head(struct ubifs_info *c);
+#endif
 
 /* recovery.c */
 int ubifs_recover_master_node(struct ubifs_info *c);
@@ -2466,5 +2485,25 @@ int ubifs_decompress(const struct ubifs_info *c, const void *buf, int len,
 
 #ifdef __UBOOT__
 void ubifs_umount(struct ubifs_info *c);
+
+/* pcache.c */
+void ubifs_pcache_init(struct ubifs_info *c);
+void ubifs_pcache_destroy(struct ubifs_info *c);
+int ubifs_pcache_writeback(void);
+int ubifs_pcache_read(ino_t inum, unsigned int block, void *addr);
+void ubifs_pcache_fill(struct ubifs_info *c, ino_t inum, unsigned int block,
+		       const void *addr, int len);
+int ubifs_pcache_write(struct ubifs_info *c, struct inode *inode,
+		       unsigned int block, const void *addr, int len);
+int ubifs_pcache_write_uncached(struct ubifs_info *c, struct inode *inode,
+				unsigned int block, const void *addr, int len);
+int ubifs_pcache_uncached(ino_t inum, unsigned int block, int nblk);
+loff_t ubifs_pcache_size(ino_t inum, loff_t size);
+int ubifs_pcache_set_size(struct ubifs_info *c, struct inode *inode);
+void ubifs_pcache_forget(ino_t inum);
+int ubifs_pcache_flush(struct ubifs_info *c, ino_t inum);
+int ubifs_pcache_sync(struct ubifs_info *c);
+int ubifs_pcache_expire(struct ubifs_info *c);
+long ubifs_pcache_next_expiry(void);
 #endif
 #endif /* !__UBIFS_H__ */
@@ -45,55 +45,132 @@ extern struct p_current *current;
 #define __GFP_NOWARN ((gfp_t) 0)
 #define __GFP_ZERO	((__force gfp_t)0x8000u)	/* Return zeroed page on success */
 
-void *kmalloc(size_t size, int flags);
+/*
+ * Heap accounting. Every allocation is charged to the subsystem of the file
+ * it is made from, see 'kmem_tag_of()'. The tag of a call site is looked up
+ * the first time it allocates.
+ */
+enum kmem_tag {
+	KMEM_TAG_OTHER,
+	KMEM_TAG_KMALLOC_POOLS,
+	KMEM_TAG_MTD,
+	KMEM_TAG_UBI_ATTACH,
+	KMEM_TAG_UBI_EBA,
+	KMEM_TAG_UBI_WL,
+	KMEM_TAG_UBI,
+	KMEM_TAG_UBIFS_TNC,
+	KMEM_TAG_UBIFS_LPT,
+	KMEM_TAG_UBIFS_JOURNAL,
+	KMEM_TAG_UBIFS_CACHE,
+	KMEM_TAG_UBIFS,
+	KMEM_TAG_COMPR,
+	KMEM_TAG_CNT
+};
 
-static inline void *kzalloc(size_t size, gfp_t flags)
-{
-	return kmalloc(size, flags | __GFP_ZERO);
-}
+/**
+ * struct kmem_stats - heap usage of one subsystem.
+ * @bytes: bytes currently allocated
+ * @peak: highest value @bytes has had
+ * @count: allocations currently live
+ * @allocs: allocations made
+ * @frees: allocations freed
+ */
+struct kmem_stats {
+	unsigned long bytes;
+	unsigned long peak;
+	unsigned long count;
+	unsigned long allocs;
+	unsigned long frees;
+};
+
+#ifdef CONFIG_KMEM_ACCOUNTING
+int kmem_tag_of(const char *file);
+#define KMEM_SITE_TAG() ({						\
+	static signed char __kmem_tag = -1;				\
+	if (__kmem_tag < 0)						\
+		__kmem_tag = kmem_tag_of(__FILE__);			\
+	(int)__kmem_tag;						\
+})
+#else
+#define KMEM_SITE_TAG()	KMEM_TAG_OTHER
+#endif
+
+const char *kmem_tag_name(int tag);
+int kmem_get_stats(int tag, struct kmem_stats *stats);
+void kmem_print_stats(void);
+void kmem_leak_mark(void);
+int kmem_leak_check(const char *what);
+
+void *__kmalloc(size_t size, int flags, int tag);
 
-static inline void *kmalloc_array(size_t n, size_t size, gfp_t flags)
+static inline void *__kmalloc_array(size_t n, size_t size, gfp_t flags,
+				    int tag)
 {
 	if (size != 0 && n > SIZE_MAX / size)
 		return NULL;
-	return kmalloc(n * size, flags | __GFP_ZERO);
+	return __kmalloc(n * size, flags | __GFP_ZERO, tag);
 }
 
-static inline void *kcalloc(size_t n, size_t size, gfp_t flags)
-{
-	return kmalloc_array(n, size, flags | __GFP_ZERO);
-}
+#define kmalloc(size, flags)	__kmalloc(size, flags, KMEM_SITE_TAG())
+#define kzalloc(size, flags)	kmalloc(size, (flags) | __GFP_ZERO)
+#define kmalloc_array(n, size, flags)					\
+	__kmalloc_array(n, size, flags, KMEM_SITE_TAG())
+#define kcalloc(n, size, flags)	kmalloc_array(n, size, (flags) | __GFP_ZERO)
 
 void vPortFree( void *pv );
 
 #define vmalloc(size)	kmalloc(size, 0)
 #define __vmalloc(size, flags, pgsz)	kmalloc(size, flags)
-static inline void *vzalloc(unsigned long size)
-{
-	return kzalloc(size, 0);
-}
-static inline void kfree(const void *block)
-{
-	vPortFree((void *)block);
-}
+#define vzalloc(size)	kzalloc(size, 0)
+void kfree(const void *block);
 static inline void vfree(const void *addr)
 {
-	vPortFree((void *)addr);
+	kfree(addr);
 }
 
-struct kmem_cache { int sz; };
+/**
+ * struct kmem_cache - pool of fixed-size objects.
+ * @name: name shown in the statistics
+ * @sz: object size, rounded up to the allocation alignment
+ * @objs_per_slab: number of objects carved out of one heap allocation
+ * @max_slabs: maximum number of slabs, zero for no limit
+ * @nr_slabs: number of slabs allocated
+ * @slabs: list of slabs, freed only when the cache is destroyed
+ * @freelist: free objects, linked through their first word
+ * @next: link in the list of all caches
+ * @tag: subsystem the slabs are charged to
+ * @inuse: objects currently allocated
+ * @peak: highest value @inuse has had
+ * @allocs: successful allocations
+ * @frees: objects given back
+ * @misses: allocations the cache could not serve
+ */
+struct kmem_cache {
+	const char *name;
+	int sz;
+	int objs_per_slab;
+	int max_slabs;
+	int nr_slabs;
+	void *slabs;
+	void *freelist;
+	struct kmem_cache *next;
+	int tag;
+	int inuse;
+	int peak;
+	unsigned long allocs;
+	unsigned long frees;
+	unsigned long misses;
+};
 
-struct kmem_cache *get_mem(int element_sz);
-#define kmem_cache_create(a, sz, c, d, e)	get_mem(sz)
-void *kmem_cache_alloc(struct kmem_cache *obj, int flag);
-static inline void kmem_cache_free(struct kmem_cache *cachep, void *obj)
-{
-	vPortFree(obj);
-}
-static inline void kmem_cache_destroy(struct kmem_cache *cachep)
-{
-	vPortFree(cachep);
-}
+/* Alignment, flags and constructor are not used by U-Boot */
+struct kmem_cache *__kmem_cache_create(const char *name, size_t size,
+				       int tag);
+#define kmem_cache_create(a, sz, c, d, e)				\
+	__kmem_cache_create(a, sz, KMEM_SITE_TAG())
+void *kmem_cache_alloc(struct kmem_cache *cachep, int flag);
+void kmem_cache_free(struct kmem_cache *cachep, void *obj);
+void kmem_cache_destroy(struct kmem_cache *cachep);
+void kmem_cache_print_stats(void);
 
 #define DECLARE_WAITQUEUE(...)	do { } while (0)
 #define add_wait_queue(...)	do { } while (0)
@@ -111,10 +111,7 @@
  * @return pointer to new memory region, or NULL if there is no more memory
  * available.
  */
-static inline void *malloc_cache_aligned(size_t size)
-{
-	return kmalloc(size, 0);
-}
+#define malloc_cache_aligned(size)	kmalloc(size, 0)
 #endif
 
 #endif /* __ALIGNMEM_H */
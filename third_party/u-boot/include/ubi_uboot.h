@@ -83,6 +83,49 @@ extern void ubi_exit(void);
 extern int ubi_part(char *part_name, const char *vid_header_offset);
 extern int ubi_volume_write(char *volume, void *buf, size_t size);
 extern int ubi_volume_read(char *volume, char *buf, size_t size);
+#ifdef __ZPL_BUILD__
+/**
+ * struct ubi_wear_stats - erase counter spread and wear-leveling activity.
+ * @min_ec: lowest erase counter
+ * @mean_ec: mean erase counter
+ * @max_ec: highest erase counter
+ * @pebs: PEBs with a known erase counter
+ * @bucket_ec: range of erase counters covered by one histogram bucket
+ * @moves: LEBs moved by the wear-leveling worker, including scrubbing
+ * @scrubs: of these, moves done to get rid of bitflips
+ * @copied_bytes: data copied by these moves
+ * @work_ms: time spent in wear-leveling works (moves and erasures)
+ */
+struct ubi_wear_stats {
+	unsigned int min_ec;
+	unsigned int mean_ec;
+	unsigned int max_ec;
+	unsigned int pebs;
+	unsigned int bucket_ec;
+	unsigned int moves;
+	unsigned int scrubs;
+	unsigned long long copied_bytes;
+	unsigned int work_ms;
+};
+
+extern int ubi_attach_stats(unsigned int *ms, int *by_fm);
+extern int ubi_wear_stats(struct ubi_wear_stats *st, unsigned int *hist,
+			  int buckets);
+#ifdef CONFIG_MTD_UBI_FASTMAP
+extern int ubi_fastmap_power_cut(unsigned int writes);
+#endif
+#ifdef CONFIG_MTD_UBI_ERASED_RESERVE
+extern int ubi_background_pending(void);
+extern int ubi_background_work(int urgent);
+extern int ubi_erase_stats(unsigned int *gets, unsigned int *waits,
+			   unsigned int *sync_works, unsigned int *bg_works);
+#endif
+#ifdef CONFIG_MTD_UBI_SCRUB_BITFLIPS
+extern int ubi_scrub_step(int pages);
+extern int ubi_scrub_stats(unsigned int *pages, unsigned int *bitflips,
+			   unsigned int *moves, unsigned int *passes);
+#endif
+#endif
 
 extern struct ubi_device *ubi_devices[];
 
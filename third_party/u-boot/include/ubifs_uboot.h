@@ -27,8 +27,41 @@ int ubifs_exists(const char *filename);
 int ubifs_size(const char *filename, loff_t *size);
 int ubifs_read(const char *filename, void *buf, loff_t offset,
            loff_t size, loff_t *actread);
+int ubifs_read_stream(const char *filename, loff_t offset, loff_t size,
+           int (*consume)(const void *buf, int len, void *priv),
+           void *priv, loff_t *actread);
 int ubifs_write(const char *filename, void *buf, loff_t offset,
            loff_t size, loff_t *actwritten);
+int ubifs_append(const char *filename, void *buf, loff_t size,
+           loff_t *actwritten);
+int ubifs_truncate(const char *filename, loff_t size);
+int ubifs_punch_hole(const char *filename, loff_t offset, loff_t size);
+int ubifs_unlink(const char *filename);
+int ubifs_rename(const char *oldname, const char *newname);
+int ubifs_mkdir(const char *filename);
+int ubifs_rmdir(const char *filename);
+int ubifs_stream_begin(const char *filename);
+int ubifs_stream_write(const char *filename, const void *buf, loff_t size);
+int ubifs_stream_finish(const char *filename);
+int ubifs_stream_abort(const char *filename);
+#ifdef CONFIG_UBIFS_HOT_JHEAD
+int ubifs_set_hot(const char *filename, int hot);
+#endif
 void ubifs_close(void);
+int ubifs_sync(void);
+int ubifs_fsync(const char *filename);
+int ubifs_sync_expired(void);
+long ubifs_next_writeback(void);
+#ifdef CONFIG_UBIFS_BG_GC_LEBS
+int ubifs_bg_gc(int (*yield)(void));
+#endif
+#ifdef __ZPL_BUILD__
+unsigned long long ubifs_gc_moved_bytes(void);
+#endif
+#ifdef CONFIG_UBIFS_GC_COST_BENEFIT
+void ubifs_gc_set_cost_benefit(int on);
+#endif
+int ubifs_hold_volume(void);
+void ubifs_release_volume(void);
 
 #endif /* __UBIFS_UBOOT_H__ */
@@ -4,6 +4,8 @@
 #else
 #include "string.h"
 #include "zplCompat.h"
+#include "task.h"
+#include "linux/errno.h"
 #include "linux/compat.h"
 #endif /* __ZPL_BUILD__ */
 
@@ -21,29 +23,534 @@ unsigned long copy_from_user(void *dest, const void *src,
 }
 
 void *pvPortMalloc( size_t xWantedSize );
+size_t xPortGetFreeHeapSize( void );
+size_t xPortGetMinimumEverFreeHeapSize( void );
 
-void *kmalloc(size_t size, int flags)
+/*
+ * Slab allocator. A cache hands out objects of one size from slabs, each slab
+ * being a single heap allocation holding a number of objects. Objects go back
+ * to the free list of their cache and slabs are only freed when the cache is
+ * destroyed, so the objects UBI and UBIFS allocate and free all the time do
+ * not fragment the heap.
+ *
+ * The hottest kmalloc() sizes are served the same way, from one slab per size
+ * class that is allocated on the first kmalloc() call. When a class is used
+ * up the request falls back to the heap. kfree() tells the two apart by the
+ * address range of the slabs.
+ *
+ * With CONFIG_KMEM_ACCOUNTING every kmalloc() block starts with a small header
+ * holding its size and the subsystem it is charged to, so kfree() can take the
+ * bytes off again. Slabs of a kmem_cache are charged to the subsystem that
+ * created the cache.
+ */
+
+#define KMEM_ALIGN	portBYTE_ALIGNMENT
+
+/**
+ * struct kmem_slab - header of a slab, the objects follow it.
+ * @next: next slab of the cache
+ * @end: end of the last object
+ */
+struct kmem_slab {
+	struct kmem_slab *next;
+	char *end;
+};
+
+#define KMEM_SLAB_HDR	ALIGN(sizeof(struct kmem_slab), KMEM_ALIGN)
+
+static struct kmem_cache *kmem_caches;
+
+#ifdef CONFIG_KMEM_ACCOUNTING
+/**
+ * struct kmem_hdr - accounting header in front of a kmalloc() block.
+ * @size: requested size
+ * @tag: subsystem charged
+ * @magic: %KMEM_MAGIC while the block is allocated
+ */
+struct kmem_hdr {
+	u32 size;
+	u16 tag;
+	u16 magic;
+};
+
+#define KMEM_MAGIC	0x6b6d
+#define KMEM_HDR	ALIGN(sizeof(struct kmem_hdr), KMEM_ALIGN)
+#else
+#define KMEM_HDR	0
+#endif
+
+static const char * const kmem_tag_names[KMEM_TAG_CNT] = {
+	[KMEM_TAG_OTHER]		= "other",
+	[KMEM_TAG_KMALLOC_POOLS]	= "kmalloc pools",
+	[KMEM_TAG_MTD]			= "mtd/nand",
+	[KMEM_TAG_UBI_ATTACH]		= "ubi attach",
+	[KMEM_TAG_UBI_EBA]		= "ubi eba",
+	[KMEM_TAG_UBI_WL]		= "ubi wl",
+	[KMEM_TAG_UBI]			= "ubi",
+	[KMEM_TAG_UBIFS_TNC]		= "ubifs tnc",
+	[KMEM_TAG_UBIFS_LPT]		= "ubifs lpt",
+	[KMEM_TAG_UBIFS_JOURNAL]	= "ubifs journal",
+	[KMEM_TAG_UBIFS_CACHE]		= "ubifs pcache",
+	[KMEM_TAG_UBIFS]		= "ubifs",
+	[KMEM_TAG_COMPR]		= "compressors",
+};
+
+static struct kmem_stats kmem_stats[KMEM_TAG_CNT];
+static unsigned long kmem_leak_marks[KMEM_TAG_CNT];
+
+#ifdef CONFIG_KMEM_ACCOUNTING
+/* Source paths and the subsystem they belong to, first match wins */
+static const struct {
+	const char *path;
+	int tag;
+} kmem_tag_paths[] = {
+	{ "mtd/ubi/attach.c",	KMEM_TAG_UBI_ATTACH },
+	{ "mtd/ubi/fastmap.c",	KMEM_TAG_UBI_ATTACH },
+	{ "mtd/ubi/eba.c",	KMEM_TAG_UBI_EBA },
+	{ "mtd/ubi/wl.c",	KMEM_TAG_UBI_WL },
+	{ "mtd/ubi/fastmap-wl.c", KMEM_TAG_UBI_WL },
+	{ "mtd/ubi/",		KMEM_TAG_UBI },
+	{ "mtd/",		KMEM_TAG_MTD },
+	{ "ubifs/tnc",		KMEM_TAG_UBIFS_TNC },
+	{ "ubifs/lp",		KMEM_TAG_UBIFS_LPT },
+	{ "ubifs/journal.c",	KMEM_TAG_UBIFS_JOURNAL },
+	{ "ubifs/log.c",	KMEM_TAG_UBIFS_JOURNAL },
+	{ "ubifs/replay.c",	KMEM_TAG_UBIFS_JOURNAL },
+	{ "ubifs/pcache.c",	KMEM_TAG_UBIFS_CACHE },
+	{ "ubifs/",		KMEM_TAG_UBIFS },
+	{ "lzo",		KMEM_TAG_COMPR },
+	{ "zlib",		KMEM_TAG_COMPR },
+	{ "gunzip",		KMEM_TAG_COMPR },
+};
+
+/* Like strstr(), but a backslash in @s also matches '/' in @find */
+static int kmem_path_has(const char *s, const char *find)
+{
+	const char *a, *b;
+
+	for (; *s; s++) {
+		for (a = s, b = find; *a && *b; a++, b++)
+			if (*a != *b && !(*a == '\\' && *b == '/'))
+				break;
+		if (!*b)
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * kmem_tag_of - get the subsystem a source file belongs to.
+ * @file: path of the file, as in __FILE__
+ */
+int kmem_tag_of(const char *file)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(kmem_tag_paths); i++)
+		if (kmem_path_has(file, kmem_tag_paths[i].path))
+			return kmem_tag_paths[i].tag;
+	return KMEM_TAG_OTHER;
+}
+#endif
+
+/* Called with the scheduler suspended */
+static void kmem_charge(int tag, size_t size)
+{
+	struct kmem_stats *st = &kmem_stats[tag];
+
+	st->bytes += size;
+	st->count++;
+	st->allocs++;
+	if (st->bytes > st->peak)
+		st->peak = st->bytes;
+}
+
+/* Called with the scheduler suspended */
+static void kmem_uncharge(int tag, size_t size)
+{
+	struct kmem_stats *st = &kmem_stats[tag];
+
+	st->bytes -= size;
+	st->count--;
+	st->frees++;
+}
+
+#ifdef CONFIG_KMALLOC_POOLS
+static const struct {
+	int size;
+	int count;
+} kmalloc_pool_cfg[] = CONFIG_KMALLOC_POOLS;
+
+static struct kmem_cache kmalloc_caches[ARRAY_SIZE(kmalloc_pool_cfg)];
+static int kmalloc_pools_ready;
+#endif
+
+static void kmem_cache_setup(struct kmem_cache *s, const char *name,
+			     size_t size, int objs_per_slab, int max_slabs)
+{
+	memset(s, 0, sizeof(struct kmem_cache));
+	s->name = name;
+	s->sz = ALIGN(max_t(size_t, size, sizeof(void *)), KMEM_ALIGN);
+	s->objs_per_slab = objs_per_slab;
+	s->max_slabs = max_slabs;
+}
+
+/* Called with the scheduler suspended */
+static int kmem_cache_grow(struct kmem_cache *s)
+{
+	struct kmem_slab *slab;
+	char *obj;
+	int i;
+
+	slab = pvPortMalloc(KMEM_SLAB_HDR + s->objs_per_slab * s->sz);
+	if (!slab)
+		return -ENOMEM;
+
+	obj = (char *)slab + KMEM_SLAB_HDR;
+	slab->end = obj + s->objs_per_slab * s->sz;
+	for (i = 0; i < s->objs_per_slab; i++, obj += s->sz) {
+		*(void **)obj = s->freelist;
+		s->freelist = obj;
+	}
+	slab->next = s->slabs;
+	s->slabs = slab;
+	s->nr_slabs++;
+	kmem_charge(s->tag, KMEM_SLAB_HDR + s->objs_per_slab * s->sz);
+	return 0;
+}
+
+static int kmem_cache_owns(struct kmem_cache *s, const void *obj)
+{
+	struct kmem_slab *slab;
+
+	for (slab = s->slabs; slab; slab = slab->next)
+		if ((const char *)obj >= (const char *)slab + KMEM_SLAB_HDR &&
+		    (const char *)obj < slab->end)
+			return 1;
+	return 0;
+}
+
+struct kmem_cache *__kmem_cache_create(const char *name, size_t size,
+				       int tag)
+{
+	struct kmem_cache *s;
+
+	s = pvPortMalloc(sizeof(struct kmem_cache));
+	if (!s)
+		return NULL;
+
+	kmem_cache_setup(s, name, size, CONFIG_KMEM_CACHE_SLAB_OBJS, 0);
+	s->tag = tag;
+	vTaskSuspendAll();
+	s->next = kmem_caches;
+	kmem_caches = s;
+	xTaskResumeAll();
+
+	return s;
+}
+
+void *kmem_cache_alloc(struct kmem_cache *s, int flag)
 {
-	void *p;
+	void *obj;
 
-	p = pvPortMalloc(size);
+	vTaskSuspendAll();
+	if (!s->freelist && (!s->max_slabs || s->nr_slabs < s->max_slabs))
+		kmem_cache_grow(s);
+	obj = s->freelist;
+	if (obj) {
+		s->freelist = *(void **)obj;
+		s->allocs++;
+		if (++s->inuse > s->peak)
+			s->peak = s->inuse;
+	} else {
+		s->misses++;
+	}
+	xTaskResumeAll();
+
+	if (obj && (flag & __GFP_ZERO))
+		memset(obj, 0, s->sz);
+
+	return obj;
+}
+
+void kmem_cache_free(struct kmem_cache *s, void *obj)
+{
+	if (!obj)
+		return;
+
+	vTaskSuspendAll();
+	*(void **)obj = s->freelist;
+	s->freelist = obj;
+	s->frees++;
+	s->inuse--;
+	xTaskResumeAll();
+}
+
+void kmem_cache_destroy(struct kmem_cache *s)
+{
+	struct kmem_cache **p;
+	struct kmem_slab *slab;
+
+	if (!s)
+		return;
+
+	if (s->inuse)
+		printf("kmem_cache_destroy %s: %d objects still in use\n",
+		       s->name, s->inuse);
+
+	vTaskSuspendAll();
+	for (p = &kmem_caches; *p; p = &(*p)->next) {
+		if (*p == s) {
+			*p = s->next;
+			break;
+		}
+	}
+	xTaskResumeAll();
+
+	while (s->slabs) {
+		slab = s->slabs;
+		s->slabs = slab->next;
+		vPortFree(slab);
+		vTaskSuspendAll();
+		kmem_uncharge(s->tag, KMEM_SLAB_HDR + s->objs_per_slab * s->sz);
+		xTaskResumeAll();
+	}
+	vPortFree(s);
+}
+
+#ifdef CONFIG_KMALLOC_POOLS
+static void kmalloc_pools_init(void)
+{
+	struct kmem_cache *s;
+	int i;
+
+	vTaskSuspendAll();
+	if (!kmalloc_pools_ready) {
+		for (i = 0; i < ARRAY_SIZE(kmalloc_pool_cfg); i++) {
+			s = &kmalloc_caches[i];
+			kmem_cache_setup(s, "kmalloc", kmalloc_pool_cfg[i].size,
+					 kmalloc_pool_cfg[i].count, 1);
+			s->tag = KMEM_TAG_KMALLOC_POOLS;
+			/* A class without memory is left empty and skipped */
+			kmem_cache_grow(s);
+		}
+		kmalloc_pools_ready = 1;
+	}
+	xTaskResumeAll();
+}
+
+static struct kmem_cache *kmalloc_cache(size_t size)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(kmalloc_caches); i++)
+		if (size <= kmalloc_caches[i].sz && kmalloc_caches[i].nr_slabs)
+			return &kmalloc_caches[i];
+	return NULL;
+}
+#endif
+
+void *__kmalloc(size_t size, int flags, int tag)
+{
+	void *p = NULL;
+#ifdef CONFIG_KMALLOC_POOLS
+	struct kmem_cache *s;
+#endif
+#ifdef CONFIG_KMEM_ACCOUNTING
+	struct kmem_hdr *hdr;
+#endif
+
+	if (!size)
+		return NULL;
+
+#ifdef CONFIG_KMALLOC_POOLS
+	if (!kmalloc_pools_ready)
+		kmalloc_pools_init();
+
+	s = kmalloc_cache(KMEM_HDR + size);
+	if (s)
+		p = kmem_cache_alloc(s, 0);
+#endif
+	if (!p)
+		p = pvPortMalloc(KMEM_HDR + size);
+	if (!p)
+		return NULL;
+
+#ifdef CONFIG_KMEM_ACCOUNTING
+	hdr = p;
+	hdr->size = size;
+	hdr->tag = tag;
+	hdr->magic = KMEM_MAGIC;
+	vTaskSuspendAll();
+	kmem_charge(tag, size);
+	xTaskResumeAll();
+	p = (char *)p + KMEM_HDR;
+#endif
 	if (flags & __GFP_ZERO)
 		memset(p, 0, size);
 
 	return p;
 }
 
-struct kmem_cache *get_mem(int element_sz)
+void kfree(const void *block)
+{
+#ifdef CONFIG_KMALLOC_POOLS
+	int i;
+#endif
+#ifdef CONFIG_KMEM_ACCOUNTING
+	struct kmem_hdr *hdr;
+#endif
+
+	if (!block)
+		return;
+
+#ifdef CONFIG_KMEM_ACCOUNTING
+	hdr = (struct kmem_hdr *)((char *)block - KMEM_HDR);
+	if (hdr->magic != KMEM_MAGIC) {
+		printf("kfree: %p is not an allocated kmalloc() block\n",
+		       block);
+		return;
+	}
+	hdr->magic = 0;
+	vTaskSuspendAll();
+	kmem_uncharge(hdr->tag, hdr->size);
+	xTaskResumeAll();
+	block = hdr;
+#endif
+
+#ifdef CONFIG_KMALLOC_POOLS
+	for (i = 0; i < ARRAY_SIZE(kmalloc_caches); i++) {
+		if (kmem_cache_owns(&kmalloc_caches[i], block)) {
+			kmem_cache_free(&kmalloc_caches[i], (void *)block);
+			return;
+		}
+	}
+#endif
+	vPortFree((void *)block);
+}
+
+static void kmem_cache_print(const struct kmem_cache *s)
+{
+	printf("%-20s %6d %6d %6d %6d %10lu %10lu %8lu\n", s->name, s->sz,
+	       s->nr_slabs * s->objs_per_slab, s->inuse, s->peak, s->allocs,
+	       s->frees, s->misses);
+}
+
+/**
+ * kmem_cache_print_stats - print the statistics of all caches.
+ *
+ * For kmalloc size classes the misses are requests that went to the heap.
+ */
+void kmem_cache_print_stats(void)
+{
+	struct kmem_cache *s;
+#ifdef CONFIG_KMALLOC_POOLS
+	int i;
+#endif
+
+	printf("%-20s %6s %6s %6s %6s %10s %10s %8s\n", "cache", "size",
+	       "objs", "inuse", "peak", "allocs", "frees", "misses");
+#ifdef CONFIG_KMALLOC_POOLS
+	for (i = 0; i < ARRAY_SIZE(kmalloc_caches); i++)
+		kmem_cache_print(&kmalloc_caches[i]);
+#endif
+	for (s = kmem_caches; s; s = s->next)
+		kmem_cache_print(s);
+}
+
+/**
+ * kmem_tag_name - get the name of a subsystem.
+ * @tag: subsystem, one of &enum kmem_tag
+ */
+const char *kmem_tag_name(int tag)
 {
-	struct kmem_cache *ret;
+	if (tag < 0 || tag >= KMEM_TAG_CNT)
+		return NULL;
+	return kmem_tag_names[tag];
+}
 
-	ret = pvPortMalloc(sizeof(struct kmem_cache));
-	ret->sz = element_sz;
+/**
+ * kmem_get_stats - get the heap usage of a subsystem.
+ * @tag: subsystem, one of &enum kmem_tag
+ * @stats: filled in with a copy of the counters
+ *
+ * Returns zero in case of success and %-EINVAL if @tag is out of range.
+ * kmalloc() blocks are only counted with CONFIG_KMEM_ACCOUNTING set, slabs
+ * of caches always.
+ */
+int kmem_get_stats(int tag, struct kmem_stats *stats)
+{
+	if (tag < 0 || tag >= KMEM_TAG_CNT)
+		return -EINVAL;
 
-	return ret;
+	vTaskSuspendAll();
+	*stats = kmem_stats[tag];
+	xTaskResumeAll();
+	return 0;
 }
 
-void *kmem_cache_alloc(struct kmem_cache *obj, int flag)
+/**
+ * kmem_print_stats - print the heap usage of all subsystems and caches.
+ *
+ * Allocations served from the kmalloc pools are charged to their subsystem
+ * and also take up part of the "kmalloc pools" line.
+ */
+void kmem_print_stats(void)
 {
-	return pvPortMalloc(obj->sz);
+	struct kmem_stats st;
+	int i;
+
+	printf("%-16s %10s %10s %8s %10s %10s\n", "subsystem", "bytes",
+	       "peak", "count", "allocs", "frees");
+	for (i = 0; i < KMEM_TAG_CNT; i++) {
+		kmem_get_stats(i, &st);
+		printf("%-16s %10lu %10lu %8lu %10lu %10lu\n", kmem_tag_names[i],
+		       st.bytes, st.peak, st.count, st.allocs, st.frees);
+	}
+	printf("heap free %u, min. ever free %u\n",
+	       (unsigned int)xPortGetFreeHeapSize(),
+	       (unsigned int)xPortGetMinimumEverFreeHeapSize());
+	kmem_cache_print_stats();
+}
+
+/**
+ * kmem_leak_mark - remember the heap usage of all subsystems.
+ *
+ * Used with 'kmem_leak_check()' to find memory a piece of work did not give
+ * back, for example between mounting and unmounting a file system.
+ */
+void kmem_leak_mark(void)
+{
+	int i;
+
+	vTaskSuspendAll();
+	for (i = 0; i < KMEM_TAG_CNT; i++)
+		kmem_leak_marks[i] = kmem_stats[i].bytes;
+	xTaskResumeAll();
+}
+
+/**
+ * kmem_leak_check - report subsystems using more than at the last mark.
+ * @what: name of the work, printed with the report
+ *
+ * Returns the number of subsystems that grew.
+ */
+int kmem_leak_check(const char *what)
+{
+	struct kmem_stats st;
+	int i, leaks = 0;
+
+	for (i = 0; i < KMEM_TAG_CNT; i++) {
+		/* Allocated once on first use, never given back */
+		if (i == KMEM_TAG_KMALLOC_POOLS)
+			continue;
+		kmem_get_stats(i, &st);
+		if (st.bytes > kmem_leak_marks[i]) {
+			printf("%s: %s holds %lu bytes more than before\n",
+			       what, kmem_tag_names[i],
+			       st.bytes - kmem_leak_marks[i]);
+			leaks++;
+		}
+	}
+	return leaks;
 }